@@ -0,0 +1,66 @@
+// Replaces the global operator new and delete to count every heap allocation
+// made through new, per thread, for Metrics::threadAllocations().
+// This replaces the allocator of the whole program, so it is only linked into
+// the programs which report allocations, with CYGNUS_COUNT_ALLOCATIONS.
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace cygnus {
+
+// Defined in Metrics.cpp. The count is a thread local, so allocating never
+// contends on a shared cache line.
+extern thread_local uint64_t allocationCount;
+extern bool countingAllocations;
+
+namespace {
+
+struct Registration {
+  Registration() { countingAllocations = true; }
+} registration;
+
+} // namespace
+
+} // namespace cygnus
+
+void *operator new(std::size_t size) {
+  ++cygnus::allocationCount;
+  if (size == 0) {
+    size = 1;
+  }
+  // Give the new_handler a chance to free memory, as the default does.
+  while (true) {
+    if (void *p = std::malloc(size)) {
+      return p;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc{};
+    }
+    handler();
+  }
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return operator new(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  std::free(p);
+}
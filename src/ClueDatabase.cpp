@@ -0,0 +1,309 @@
+#include "ClueDatabase.h"
+
+#include "Metrics.h"
+#include "Puzzle.h"
+#include "Trace.h"
+#include "WorkPool.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace cygnus {
+
+namespace {
+
+const char DATABASE_MAGIC[8] = "CYGCLDB";
+
+/// Increment whenever the layout of the database changes.
+const uint32_t DATABASE_FORMAT = 1;
+
+/// Answers are split into this many shards by hash, which are reduced in
+/// parallel.
+const size_t kShards = 64;
+
+/// Start of a database file, in native byte order like the clue index.
+struct DatabaseHeader {
+  char magic[8];
+  uint32_t format;
+  uint32_t byteOrder;
+  uint32_t answerCount;
+  uint32_t clueCount;
+  /// An AnswerEntry per answer, sorted by text.
+  FileSection answers;
+  /// A ClueEntry per clue, grouped by answer.
+  FileSection clues;
+  /// Text of the answers and clues, in UTF-8.
+  FileSection text;
+};
+
+struct AnswerEntry {
+  uint32_t text;
+  uint32_t length;
+  /// Index of the first clue of the answer, and its number of clues.
+  uint32_t firstClue;
+  uint32_t clueCount;
+};
+
+struct ClueEntry {
+  uint32_t text;
+  uint32_t length;
+  uint32_t count;
+};
+
+/// A clue and its answer, as read from a puzzle.
+struct Pair {
+  QByteArray answer;
+  /// The clue in lower case with simplified spacing, which deduplicates it.
+  QByteArray key;
+  QByteArray clue;
+};
+
+/// Pairs of a single file, in one bucket per shard.
+using FilePairs = std::vector<std::vector<Pair>>;
+
+struct Variant {
+  QByteArray clue;
+  uint32_t count;
+};
+
+struct AnswerClues {
+  QByteArray answer;
+  std::vector<Variant> clues;
+};
+
+/// Map: read the clue and answer pairs of the puzzle at \p path.
+FilePairs extract(const QString &path) {
+  FilePairs pairs(kShards);
+  QFile file{path};
+  if (!file.open(QIODevice::ReadOnly)) {
+    return pairs;
+  }
+  const auto puzzle = Puzzle::loadFromFile(file.readAll());
+  if (!puzzle) {
+    return pairs;
+  }
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    for (const Clue &clue : puzzle->getClues(dir)) {
+      const QString text = puzzle->getClueText(clue).simplified();
+      const QByteArray answer = puzzle->getAnswer(clue).toUpper();
+      if (text.isEmpty() || answer.isEmpty()) {
+        continue;
+      }
+      pairs[qHash(answer) % kShards].push_back(
+          Pair{answer, text.toLower().toUtf8(), text.toUtf8()});
+    }
+  }
+  return pairs;
+}
+
+/// Reduce: count the clues of every answer in \p shard, keeping the first
+/// spelling of each clue.
+std::vector<AnswerClues> reduce(std::vector<FilePairs> &files, size_t shard) {
+  std::vector<AnswerClues> answers{};
+  QHash<QByteArray, size_t> answerIndices{};
+  // Position of each deduplicated clue in the clues of its answer.
+  std::vector<QHash<QByteArray, size_t>> clueIndices{};
+  for (FilePairs &file : files) {
+    for (Pair &pair : file[shard]) {
+      auto answer = answerIndices.find(pair.answer);
+      if (answer == answerIndices.end()) {
+        answer = answerIndices.insert(pair.answer, answers.size());
+        answers.push_back(AnswerClues{pair.answer, {}});
+        clueIndices.emplace_back();
+      }
+      std::vector<Variant> &clues = answers[*answer].clues;
+      QHash<QByteArray, size_t> &indices = clueIndices[*answer];
+      auto clue = indices.find(pair.key);
+      if (clue == indices.end()) {
+        indices.insert(pair.key, clues.size());
+        clues.push_back(Variant{std::move(pair.clue), 1});
+      } else {
+        ++clues[*clue].count;
+      }
+    }
+    std::vector<Pair>{}.swap(file[shard]);
+  }
+
+  for (AnswerClues &answer : answers) {
+    std::stable_sort(answer.clues.begin(), answer.clues.end(),
+                     [](const Variant &a, const Variant &b) {
+                       return a.count > b.count;
+                     });
+  }
+  return answers;
+}
+
+inline const DatabaseHeader &header(const char *data) {
+  return *reinterpret_cast<const DatabaseHeader *>(data);
+}
+
+} // namespace
+
+bool ClueDatabase::build(const QStringList &paths, const QString &path,
+                         unsigned threads) {
+  CYGNUS_TRACE_SPAN("ClueDatabase::build");
+  CYGNUS_METRICS_TIMER("clue_database.build_ns");
+  WorkPool pool{threads};
+
+  std::vector<FilePairs> files(paths.size());
+  pool.run(files.size(), [&](size_t i) { files[i] = extract(paths[i]); });
+
+  // Every answer is in a single shard, so shards are reduced independently.
+  std::vector<std::vector<AnswerClues>> shards(kShards);
+  pool.run(kShards, [&](size_t i) { shards[i] = reduce(files, i); });
+  files.clear();
+
+  std::vector<AnswerClues> answers{};
+  for (auto &shard : shards) {
+    std::move(shard.begin(), shard.end(), std::back_inserter(answers));
+    std::vector<AnswerClues>{}.swap(shard);
+  }
+  std::sort(answers.begin(), answers.end(),
+            [](const AnswerClues &a, const AnswerClues &b) {
+              return a.answer < b.answer;
+            });
+
+  std::vector<AnswerEntry> answerEntries{};
+  std::vector<ClueEntry> clueEntries{};
+  QByteArray text{};
+  answerEntries.reserve(answers.size());
+  for (const AnswerClues &answer : answers) {
+    answerEntries.push_back(AnswerEntry{
+        static_cast<uint32_t>(text.size()),
+        static_cast<uint32_t>(answer.answer.size()),
+        static_cast<uint32_t>(clueEntries.size()),
+        static_cast<uint32_t>(answer.clues.size())});
+    text += answer.answer;
+    for (const Variant &clue : answer.clues) {
+      clueEntries.push_back(ClueEntry{static_cast<uint32_t>(text.size()),
+                                      static_cast<uint32_t>(clue.clue.size()),
+                                      clue.count});
+      text += clue.clue;
+    }
+  }
+
+  DatabaseHeader head{};
+  std::memcpy(head.magic, DATABASE_MAGIC, sizeof(head.magic));
+  head.format = DATABASE_FORMAT;
+  head.byteOrder = 0x01020304;
+  head.answerCount = static_cast<uint32_t>(answerEntries.size());
+  head.clueCount = static_cast<uint32_t>(clueEntries.size());
+  QByteArray out(sizeof(DatabaseHeader), '\0');
+  head.answers = appendSection(out, answerEntries);
+  head.clues = appendSection(out, clueEntries);
+  head.text = appendSection(out, text.constData(), text.size());
+  std::memcpy(out.data(), &head, sizeof(head));
+
+  QDir{}.mkpath(QFileInfo{path}.absolutePath());
+  QSaveFile file{path};
+  if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() ||
+      !file.commit()) {
+    qWarning() << "Unable to write clue database:" << path;
+    return false;
+  }
+  return true;
+}
+
+QString ClueDatabase::defaultPath() {
+  return QStandardPaths::writableLocation(
+             QStandardPaths::GenericDataLocation) +
+         "/cygnus/clues.db";
+}
+
+bool ClueDatabase::open(const QString &path) {
+  CYGNUS_TRACE_SPAN("ClueDatabase::open");
+  if (!file_.open(path)) {
+    return false;
+  }
+  const char *data = file_.data();
+  const qint64 size = file_.size();
+  const DatabaseHeader &head = header(data);
+  bool valid =
+      size >= static_cast<qint64>(sizeof(DatabaseHeader)) &&
+      std::memcmp(head.magic, DATABASE_MAGIC, sizeof(head.magic)) == 0 &&
+      head.format == DATABASE_FORMAT && head.byteOrder == 0x01020304 &&
+      head.answers.fits(size) && head.clues.fits(size) &&
+      head.text.fits(size) &&
+      head.answers.size == uint64_t(head.answerCount) * sizeof(AnswerEntry) &&
+      head.clues.size == uint64_t(head.clueCount) * sizeof(ClueEntry);
+  // Only the sections are checked, since reading every entry would fault in
+  // the whole file. Entries are checked as lookups read them instead.
+  if (!valid) {
+    qWarning() << "Invalid clue database:" << path;
+    file_.close();
+    return false;
+  }
+  return true;
+}
+
+uint32_t ClueDatabase::answerCount() const {
+  return isOpen() ? header(file_.data()).answerCount : 0;
+}
+
+uint32_t ClueDatabase::clueCount() const {
+  return isOpen() ? header(file_.data()).clueCount : 0;
+}
+
+QByteArray ClueDatabase::answer(uint32_t i) const {
+  const DatabaseHeader &head = header(file_.data());
+  const AnswerEntry &entry = head.answers.items<AnswerEntry>(file_.data())[i];
+  if (uint64_t(entry.text) + entry.length > head.text.size) {
+    return QByteArray{};
+  }
+  return QByteArray::fromRawData(file_.data() + head.text.offset + entry.text,
+                                 static_cast<int>(entry.length));
+}
+
+std::vector<ClueDatabase::Entry>
+ClueDatabase::lookup(const QByteArray &answer, size_t limit) const {
+  CYGNUS_METRICS_TIMER("clue_database.lookup_ns");
+  std::vector<Entry> entries{};
+  if (!isOpen()) {
+    return entries;
+  }
+  const QByteArray key = answer.toUpper();
+  const DatabaseHeader &head = header(file_.data());
+  uint32_t lo = 0;
+  uint32_t hi = head.answerCount;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (this->answer(mid) < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == head.answerCount || this->answer(lo) != key) {
+    return entries;
+  }
+
+  const AnswerEntry &found = head.answers.items<AnswerEntry>(file_.data())[lo];
+  if (uint64_t(found.firstClue) + found.clueCount > head.clueCount) {
+    return entries;
+  }
+  const ClueEntry *clues = head.clues.items<ClueEntry>(file_.data());
+  const char *text = file_.data() + head.text.offset;
+  const size_t count = std::min<size_t>(found.clueCount, limit);
+  entries.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const ClueEntry &clue = clues[found.firstClue + i];
+    if (uint64_t(clue.text) + clue.length > head.text.size) {
+      continue;
+    }
+    entries.push_back(Entry{
+        QString::fromUtf8(text + clue.text, static_cast<int>(clue.length)),
+        clue.count});
+  }
+  return entries;
+}
+
+} // namespace cygnus
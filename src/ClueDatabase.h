@@ -0,0 +1,66 @@
+#ifndef CLUEDATABASE_H
+#define CLUEDATABASE_H
+
+#include "MappedFile.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+namespace cygnus {
+
+/// Every clue each answer was given in a collection of puzzle files, so that
+/// a solver who is stuck on an entry can see how it has been clued before.
+/// Clues which only differ in case or spacing are counted as one. Answers
+/// are sorted, and the clues of each answer are sorted from the most to the
+/// least frequent, so a lookup is a binary search followed by a contiguous
+/// read. Like the ClueIndex, the database is a single memory mapped file.
+class ClueDatabase {
+public:
+  /// A clue given to an answer, and how many times it was given.
+  struct Entry {
+    QString clue;
+    uint32_t count;
+  };
+
+  ClueDatabase() = default;
+
+  /// Collect the clues of the puzzles in \p paths on \p threads threads, or
+  /// one per core if it is 0, and write the database to \p path. Files which
+  /// aren't valid puzzles are skipped.
+  /// \return false if the database couldn't be written.
+  static bool build(const QStringList &paths, const QString &path,
+                    unsigned threads = 0);
+
+  /// \return the database file in the user's data directory, which is the
+  /// same for cygnus-cli and the application.
+  static QString defaultPath();
+
+  /// Map the database in the file at \p path. Only its header is read, so
+  /// this is quick, but it may block on a slow disk.
+  /// \return false if it can't be read or isn't a valid database.
+  bool open(const QString &path);
+
+  inline bool isOpen() const { return file_.isOpen(); }
+
+  /// \return the number of distinct answers and clues in the database.
+  uint32_t answerCount() const;
+  uint32_t clueCount() const;
+
+  /// \return the clues of \p answer, most frequent first, at most \p limit.
+  /// Takes O(log n) in the number of answers, and case is ignored.
+  std::vector<Entry> lookup(const QByteArray &answer,
+                            size_t limit = 10) const;
+
+private:
+  /// \return the text of answer \p i.
+  QByteArray answer(uint32_t i) const;
+
+  MappedFile file_{};
+};
+
+} // namespace cygnus
+
+#endif
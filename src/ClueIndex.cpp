@@ -0,0 +1,495 @@
+#include "ClueIndex.h"
+
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "WorkPool.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace cygnus {
+
+namespace {
+
+const char INDEX_MAGIC[8] = "CYGCLUE";
+
+/// Increment whenever the layout of the index changes.
+const uint32_t INDEX_FORMAT = 1;
+
+/// Start of an index file. Like snapshots, indices are only read by the
+/// build that wrote them, so every field is in native byte order.
+struct IndexHeader {
+  char magic[8];
+  uint32_t format;
+  uint32_t byteOrder;
+  uint32_t fileCount;
+  uint32_t docCount;
+  uint32_t termCount[ClueIndex::FIELD_COUNT];
+  /// fileCount + 1 offsets into pathText, one past the end of each path.
+  FileSection paths;
+  /// Absolute paths of the files, in UTF-8.
+  FileSection pathText;
+  /// A Doc per clue.
+  FileSection docs;
+  /// Text and answer of each clue, in UTF-8.
+  FileSection text;
+  /// A TermEntry per term of each field, sorted by text.
+  FileSection terms[ClueIndex::FIELD_COUNT];
+  FileSection termText;
+  FileSection postings;
+};
+
+struct Doc {
+  uint32_t file;
+  /// The clue text is at this offset in the text section, followed by the
+  /// answer.
+  uint32_t text;
+  uint16_t num;
+  uint16_t clueLength;
+  uint8_t dir;
+  uint8_t answerLength;
+  uint8_t padding[2];
+};
+
+struct TermEntry {
+  /// Offset and length of the term in the term text.
+  uint32_t text;
+  uint32_t length;
+  /// Offset of the postings of the term, and the number of documents in
+  /// them.
+  uint32_t postings;
+  uint32_t docCount;
+};
+
+/// Clues of a single file, as they are extracted in parallel.
+struct FileClues {
+  bool valid{false};
+  /// Text offsets are relative to text.
+  std::vector<Doc> docs{};
+  QByteArray text{};
+  /// Terms of each field, as (term, index in docs).
+  std::vector<std::pair<QByteArray, uint32_t>> terms[ClueIndex::FIELD_COUNT];
+};
+
+inline bool isWildcard(QChar c) { return c == '*' || c == '?'; }
+
+/// \return the lower case words of \p text, keeping wildcards in them if
+/// \p wildcards is true.
+QStringList words(const QString &text, bool wildcards) {
+  QStringList result{};
+  QString word{};
+  for (const QChar c : text) {
+    if (c.isLetterOrNumber() || (wildcards && isWildcard(c))) {
+      word += c.toLower();
+    } else if (!word.isEmpty()) {
+      result.push_back(word);
+      word.clear();
+    }
+  }
+  if (!word.isEmpty()) {
+    result.push_back(word);
+  }
+  return result;
+}
+
+/// \return true if \p term matches \p pattern, where '*' matches any number
+/// of bytes and '?' matches one.
+bool matchWildcard(const QByteArray &pattern, const QByteArray &term) {
+  int p = 0;
+  int t = 0;
+  // Position of the last '*' in the pattern and where it started matching.
+  int star = -1;
+  int starTerm = 0;
+  while (t < term.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == term[t])) {
+      ++p;
+      ++t;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      starTerm = t;
+    } else if (star >= 0) {
+      p = star + 1;
+      t = ++starTerm;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+void writeVarint(QByteArray &out, uint32_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+/// Read the clues and answers of the puzzle at \p path.
+FileClues extract(const QString &path) {
+  FileClues result{};
+  QFile file{path};
+  if (!file.open(QIODevice::ReadOnly)) {
+    return result;
+  }
+  const auto puzzle = Puzzle::loadFromFile(file.readAll());
+  if (!puzzle) {
+    return result;
+  }
+  result.valid = true;
+
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    for (const Clue &clue : puzzle->getClues(dir)) {
+      const QByteArray answer = puzzle->getAnswer(clue);
+      const QByteArray text = puzzle->getClueText(clue).toUtf8();
+
+      const uint32_t doc = static_cast<uint32_t>(result.docs.size());
+      Doc entry{};
+      entry.text = static_cast<uint32_t>(result.text.size());
+      entry.num = clue.num;
+      entry.clueLength = static_cast<uint16_t>(
+          std::min(text.size(), int{UINT16_MAX}));
+      entry.dir = static_cast<uint8_t>(dir);
+      entry.answerLength = static_cast<uint8_t>(
+          std::min(answer.size(), int{UINT8_MAX}));
+      result.docs.push_back(entry);
+      result.text += text.left(entry.clueLength);
+      result.text += answer.left(entry.answerLength);
+
+      for (const QString &word : words(QString::fromUtf8(text), false)) {
+        result.terms[ClueIndex::CLUE].emplace_back(word.toUtf8(), doc);
+      }
+      if (!answer.isEmpty()) {
+        result.terms[ClueIndex::ANSWER].emplace_back(answer.toLower(), doc);
+      }
+    }
+  }
+  return result;
+}
+
+inline const IndexHeader &header(const char *data) {
+  return *reinterpret_cast<const IndexHeader *>(data);
+}
+
+} // namespace
+
+bool ClueIndex::build(const QStringList &paths, const QString &indexPath,
+                      unsigned threads) {
+  CYGNUS_TRACE_SPAN("ClueIndex::build");
+  CYGNUS_METRICS_TIMER("clue_index.build_ns");
+
+  // Reading and parsing the files saturates every core.
+  std::vector<FileClues> files(paths.size());
+  WorkPool pool{threads};
+  pool.run(files.size(), [&](size_t i) { files[i] = extract(paths[i]); });
+
+  // Documents are numbered in file order, so each posting list is built
+  // sorted.
+  std::vector<uint32_t> pathOffsets{0};
+  QByteArray pathText{};
+  std::vector<Doc> docs{};
+  QByteArray text{};
+  QHash<QByteArray, std::vector<uint32_t>> postings[FIELD_COUNT];
+  for (size_t i = 0; i < files.size(); ++i) {
+    FileClues &file = files[i];
+    if (!file.valid) {
+      continue;
+    }
+    const uint32_t fileIndex = static_cast<uint32_t>(pathOffsets.size() - 1);
+    const uint32_t firstDoc = static_cast<uint32_t>(docs.size());
+    for (Doc doc : file.docs) {
+      doc.file = fileIndex;
+      doc.text += static_cast<uint32_t>(text.size());
+      docs.push_back(doc);
+    }
+    text += file.text;
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+      for (const auto &term : file.terms[field]) {
+        std::vector<uint32_t> &list = postings[field][term.first];
+        const uint32_t doc = firstDoc + term.second;
+        // A word used twice in a clue is only posted once.
+        if (list.empty() || list.back() != doc) {
+          list.push_back(doc);
+        }
+      }
+    }
+    pathText += QFileInfo{paths[i]}.absoluteFilePath().toUtf8();
+    pathOffsets.push_back(static_cast<uint32_t>(pathText.size()));
+    file = FileClues{};
+  }
+
+  std::vector<TermEntry> terms[FIELD_COUNT];
+  QByteArray termText{};
+  QByteArray encoded{};
+  for (int field = 0; field < FIELD_COUNT; ++field) {
+    QList<QByteArray> keys = postings[field].keys();
+    std::sort(keys.begin(), keys.end());
+    terms[field].reserve(keys.size());
+    for (const QByteArray &key : keys) {
+      const std::vector<uint32_t> &list = postings[field][key];
+      TermEntry entry{};
+      entry.text = static_cast<uint32_t>(termText.size());
+      entry.length = static_cast<uint32_t>(key.size());
+      entry.postings = static_cast<uint32_t>(encoded.size());
+      entry.docCount = static_cast<uint32_t>(list.size());
+      terms[field].push_back(entry);
+      termText += key;
+      uint32_t previous = 0;
+      for (const uint32_t doc : list) {
+        writeVarint(encoded, doc - previous);
+        previous = doc;
+      }
+    }
+    postings[field].clear();
+  }
+
+  IndexHeader head{};
+  std::memcpy(head.magic, INDEX_MAGIC, sizeof(head.magic));
+  head.format = INDEX_FORMAT;
+  head.byteOrder = 0x01020304;
+  head.fileCount = static_cast<uint32_t>(pathOffsets.size() - 1);
+  head.docCount = static_cast<uint32_t>(docs.size());
+  QByteArray out(sizeof(IndexHeader), '\0');
+  head.paths = appendSection(out, pathOffsets);
+  head.pathText = appendSection(out, pathText.constData(), pathText.size());
+  head.docs = appendSection(out, docs);
+  head.text = appendSection(out, text.constData(), text.size());
+  for (int field = 0; field < FIELD_COUNT; ++field) {
+    head.termCount[field] = static_cast<uint32_t>(terms[field].size());
+    head.terms[field] = appendSection(out, terms[field]);
+  }
+  head.termText = appendSection(out, termText.constData(), termText.size());
+  head.postings = appendSection(out, encoded.constData(), encoded.size());
+  std::memcpy(out.data(), &head, sizeof(head));
+
+  QDir{}.mkpath(QFileInfo{indexPath}.absolutePath());
+  QSaveFile file{indexPath};
+  if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() ||
+      !file.commit()) {
+    qWarning() << "Unable to write clue index:" << indexPath;
+    return false;
+  }
+  return true;
+}
+
+QString ClueIndex::defaultPath() {
+  // Shared by every tool, unlike AppDataLocation which is per application.
+  return QStandardPaths::writableLocation(
+             QStandardPaths::GenericDataLocation) +
+         "/cygnus/clues.index";
+}
+
+bool ClueIndex::open(const QString &indexPath) {
+  CYGNUS_TRACE_SPAN("ClueIndex::open");
+  if (!file_.open(indexPath)) {
+    return false;
+  }
+  const char *data = file_.data();
+  const qint64 size = file_.size();
+  bool valid = size >= static_cast<qint64>(sizeof(IndexHeader));
+  const IndexHeader &head = header(data);
+  valid = valid &&
+          std::memcmp(head.magic, INDEX_MAGIC, sizeof(head.magic)) == 0 &&
+          head.format == INDEX_FORMAT && head.byteOrder == 0x01020304 &&
+          head.paths.fits(size) && head.pathText.fits(size) &&
+          head.docs.fits(size) && head.text.fits(size) &&
+          head.termText.fits(size) && head.postings.fits(size) &&
+          head.paths.size ==
+              (uint64_t(head.fileCount) + 1) * sizeof(uint32_t) &&
+          head.docs.size == uint64_t(head.docCount) * sizeof(Doc);
+  for (int field = 0; valid && field < FIELD_COUNT; ++field) {
+    valid = head.terms[field].fits(size) &&
+            head.terms[field].size ==
+                uint64_t(head.termCount[field]) * sizeof(TermEntry);
+    // Terms are checked once here, so that queries can trust them.
+    const TermEntry *terms = head.terms[field].items<TermEntry>(data);
+    for (uint32_t i = 0; valid && i < head.termCount[field]; ++i) {
+      valid = terms[i].text <= head.termText.size &&
+              terms[i].length <= head.termText.size - terms[i].text &&
+              terms[i].postings <= head.postings.size;
+    }
+  }
+  if (!valid) {
+    qWarning() << "Invalid clue index:" << indexPath;
+    file_.close();
+    return false;
+  }
+  return true;
+}
+
+uint32_t ClueIndex::fileCount() const {
+  return isOpen() ? header(file_.data()).fileCount : 0;
+}
+
+uint32_t ClueIndex::clueCount() const {
+  return isOpen() ? header(file_.data()).docCount : 0;
+}
+
+QByteArray ClueIndex::term(Field field, uint32_t i) const {
+  const IndexHeader &head = header(file_.data());
+  const TermEntry &entry = head.terms[field].items<TermEntry>(file_.data())[i];
+  return QByteArray::fromRawData(
+      file_.data() + head.termText.offset + entry.text,
+      static_cast<int>(entry.length));
+}
+
+void ClueIndex::appendPostings(Field field, uint32_t i,
+                               std::vector<uint32_t> &docs) const {
+  const IndexHeader &head = header(file_.data());
+  const TermEntry &entry = head.terms[field].items<TermEntry>(file_.data())[i];
+  const auto *p = reinterpret_cast<const uint8_t *>(
+      file_.data() + head.postings.offset + entry.postings);
+  const auto *end = reinterpret_cast<const uint8_t *>(
+      file_.data() + head.postings.offset + head.postings.size);
+  uint32_t doc = 0;
+  for (uint32_t n = 0; n < entry.docCount && p < end; ++n) {
+    uint32_t delta = 0;
+    for (int shift = 0; p < end && shift < 32; shift += 7) {
+      const uint8_t byte = *p++;
+      delta |= uint32_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    doc += delta;
+    docs.push_back(doc);
+  }
+}
+
+std::vector<uint32_t> ClueIndex::match(Field field,
+                                       const QByteArray &pattern) const {
+  std::vector<uint32_t> docs{};
+  if (!file_.isOpen()) {
+    return docs;
+  }
+  int wildcard = -1;
+  for (int i = 0; i < pattern.size() && wildcard < 0; ++i) {
+    if (pattern[i] == '*' || pattern[i] == '?') {
+      wildcard = i;
+    }
+  }
+  const QByteArray prefix = wildcard < 0 ? pattern : pattern.left(wildcard);
+
+  // Terms are sorted, so the ones starting with the literal prefix of the
+  // pattern are contiguous.
+  const uint32_t count = header(file_.data()).termCount[field];
+  uint32_t lo = 0;
+  uint32_t hi = count;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (term(field, mid) < prefix) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  int matched = 0;
+  for (uint32_t i = lo; i < count; ++i) {
+    const QByteArray candidate = term(field, i);
+    if (!candidate.startsWith(prefix)) {
+      break;
+    }
+    if (wildcard < 0) {
+      if (candidate.size() == prefix.size()) {
+        appendPostings(field, i, docs);
+      }
+      break;
+    }
+    if (matchWildcard(pattern, candidate)) {
+      appendPostings(field, i, docs);
+      ++matched;
+    }
+  }
+  if (matched > 1) {
+    std::sort(docs.begin(), docs.end());
+    docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+  }
+  return docs;
+}
+
+bool ClueIndex::hit(uint32_t doc, Hit &hit) const {
+  const IndexHeader &head = header(file_.data());
+  if (doc >= head.docCount) {
+    return false;
+  }
+  const Doc &entry = head.docs.items<Doc>(file_.data())[doc];
+  const uint64_t textEnd =
+      uint64_t(entry.text) + entry.clueLength + entry.answerLength;
+  if (entry.file >= head.fileCount || textEnd > head.text.size) {
+    return false;
+  }
+  const uint32_t *paths = head.paths.items<uint32_t>(file_.data());
+  const uint32_t pathStart = paths[entry.file];
+  const uint32_t pathEnd = paths[entry.file + 1];
+  if (pathStart > pathEnd || pathEnd > head.pathText.size) {
+    return false;
+  }
+
+  const char *text = file_.data() + head.text.offset + entry.text;
+  hit.path = QString::fromUtf8(file_.data() + head.pathText.offset + pathStart,
+                               static_cast<int>(pathEnd - pathStart));
+  hit.num = entry.num;
+  hit.dir = static_cast<Direction>(entry.dir & 1);
+  hit.clue = QString::fromUtf8(text, entry.clueLength);
+  hit.answer =
+      QString::fromUtf8(text + entry.clueLength, entry.answerLength);
+  return true;
+}
+
+std::vector<ClueIndex::Hit> ClueIndex::search(const QString &query,
+                                              size_t limit) const {
+  CYGNUS_TRACE_SPAN("ClueIndex::search");
+  CYGNUS_METRICS_TIMER("clue_index.search_ns");
+  std::vector<Hit> hits{};
+  if (!file_.isOpen()) {
+    return hits;
+  }
+
+  std::vector<uint32_t> docs{};
+  bool first = true;
+  for (const QString &part : query.split(' ', QString::SkipEmptyParts)) {
+    const bool answer = part.startsWith("answer:", Qt::CaseInsensitive);
+    const Field field = answer ? ANSWER : CLUE;
+    for (const QString &word : words(answer ? part.mid(7) : part, true)) {
+      std::vector<uint32_t> matches = match(field, word.toUtf8());
+      if (first) {
+        docs = std::move(matches);
+        first = false;
+      } else {
+        std::vector<uint32_t> both{};
+        std::set_intersection(docs.begin(), docs.end(), matches.begin(),
+                              matches.end(), std::back_inserter(both));
+        docs = std::move(both);
+      }
+      if (docs.empty()) {
+        return hits;
+      }
+    }
+  }
+
+  for (const uint32_t doc : docs) {
+    if (hits.size() >= limit) {
+      break;
+    }
+    Hit h{};
+    if (hit(doc, h)) {
+      hits.push_back(std::move(h));
+    }
+  }
+  return hits;
+}
+
+} // namespace cygnus
@@ -0,0 +1,93 @@
+#ifndef CLUEINDEX_H
+#define CLUEINDEX_H
+
+#include "MappedFile.h"
+#include "Puzzle.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+namespace cygnus {
+
+/// Inverted index of the clues and answers of a collection of puzzle files,
+/// so that they can be searched without opening any puzzle.
+/// Every clue is a document, indexed by the words of its text and by its
+/// answer, read from the solution grid. Each term maps to the sorted list of
+/// documents containing it, delta encoded as variable length integers. The
+/// index is a single file which is memory mapped, so opening it reads
+/// nothing but its header, and a query only touches the terms and postings
+/// it needs.
+class ClueIndex {
+public:
+  /// What a term of a query is matched against.
+  enum Field : uint8_t {
+    CLUE,
+    ANSWER,
+    FIELD_COUNT,
+  };
+
+  /// A clue which matched a query.
+  struct Hit {
+    QString path;
+    uint16_t num;
+    Direction dir;
+    QString clue;
+    QString answer;
+  };
+
+  ClueIndex() = default;
+
+  /// Index the puzzles in \p paths, reading and parsing them on \p threads
+  /// threads, or one per core if it is 0, and write the index to
+  /// \p indexPath. Files which aren't valid puzzles are skipped.
+  /// \return false if the index couldn't be written.
+  static bool build(const QStringList &paths, const QString &indexPath,
+                    unsigned threads = 0);
+
+  /// \return the index file in the user's data directory, which is the same
+  /// for cygnus-cli and the application.
+  static QString defaultPath();
+
+  /// Map the index in the file at \p indexPath.
+  /// \return false if it can't be read or isn't a valid index.
+  bool open(const QString &indexPath);
+
+  inline bool isOpen() const { return file_.isOpen(); }
+
+  /// \return the number of puzzles and clues in the index.
+  uint32_t fileCount() const;
+  uint32_t clueCount() const;
+
+  /// \return the clues matching every term of \p query, at most \p limit,
+  /// in the order the files were indexed.
+  /// Terms are separated by spaces and match the words of the clue, or the
+  /// answer if they start with "answer:", ignoring case and punctuation.
+  /// In a term, '*' matches any number of characters and '?' matches one,
+  /// so "osl*" finds every word starting with "osl" and "answer:o?oe" finds
+  /// OBOE.
+  std::vector<Hit> search(const QString &query, size_t limit = 100) const;
+
+  /// \return the sorted documents containing a term of \p field which
+  /// matches \p pattern, a lower case term which may contain wildcards.
+  std::vector<uint32_t> match(Field field, const QByteArray &pattern) const;
+
+private:
+  /// \return the text of term \p i of \p field.
+  QByteArray term(Field field, uint32_t i) const;
+
+  /// Append the documents of term \p i of \p field to \p docs.
+  void appendPostings(Field field, uint32_t i,
+                      std::vector<uint32_t> &docs) const;
+
+  /// \return the clue of document \p doc, or false if it is corrupt.
+  bool hit(uint32_t doc, Hit &hit) const;
+
+  MappedFile file_{};
+};
+
+} // namespace cygnus
+
+#endif
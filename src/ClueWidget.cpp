@@ -1,6 +1,7 @@
 #include "ClueWidget.h"
 
 #include "Colors.h"
+#include "MemoryUsage.h"
 #include "Settings.h"
 
 #include <QDebug>
@@ -36,6 +37,14 @@ void ClueWidget::modifySize(int delta) {
   update();
 }
 
+size_t ClueWidget::memoryUsage() const {
+  size_t bytes = 0;
+  for (int i = 0; i < count(); ++i) {
+    bytes += sizeof(QListWidgetItem) + heapBytes(item(i)->text());
+  }
+  return bytes;
+}
+
 void ClueWidget::addClue(const QString &text) {
   this->addItem(text);
   if (pointSize_ == 0) {
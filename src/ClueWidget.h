@@ -16,6 +16,9 @@ public:
   /// Updates the size of the label to be consistent with the other labels.
   void addClue(const QString &text);
 
+  /// \return the estimated bytes used by the list items and their text.
+  size_t memoryUsage() const;
+
 public slots:
   void mousePressEvent(QMouseEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
@@ -0,0 +1,117 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "MemoryUsage.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cygnus {
+
+/// Cells of a puzzle stored contiguously in row-major order, and indexed as
+/// grid[row][col].
+/// A grid either owns its cells, or is a view of cells owned elsewhere, such
+/// as the block a Puzzle allocates for all of its grids at once. Iterating
+/// over a grid visits every cell in row-major order.
+template <typename T> class Grid {
+public:
+  Grid() = default;
+
+  /// Create a grid owning \p height x \p width cells set to \p value.
+  Grid(uint8_t height, uint8_t width, const T &value = T{})
+      : storage_(size_t(height) * width, value), cells_(storage_.data()),
+        height_(height), width_(width) {}
+
+  /// \return a grid of the \p height x \p width cells at \p cells, which
+  /// must outlive it.
+  static Grid view(T *cells, uint8_t height, uint8_t width) {
+    Grid grid{};
+    grid.cells_ = cells;
+    grid.height_ = height;
+    grid.width_ = width;
+    return grid;
+  }
+
+  /// \return a read-only grid of the cells at \p cells.
+  static const Grid view(const T *cells, uint8_t height, uint8_t width) {
+    return view(const_cast<T *>(cells), height, width);
+  }
+
+  Grid(const Grid &other)
+      : storage_(other.storage_), height_(other.height_),
+        width_(other.width_) {
+    cells_ = other.owning() ? storage_.data() : other.cells_;
+  }
+
+  Grid(Grid &&other) noexcept
+      : storage_(std::move(other.storage_)), cells_(other.cells_),
+        height_(other.height_), width_(other.width_) {
+    other.reset();
+  }
+
+  Grid &operator=(const Grid &other) {
+    if (this != &other) {
+      storage_ = other.storage_;
+      cells_ = other.owning() ? storage_.data() : other.cells_;
+      height_ = other.height_;
+      width_ = other.width_;
+    }
+    return *this;
+  }
+
+  Grid &operator=(Grid &&other) noexcept {
+    if (this != &other) {
+      storage_ = std::move(other.storage_);
+      cells_ = other.cells_;
+      height_ = other.height_;
+      width_ = other.width_;
+      other.reset();
+    }
+    return *this;
+  }
+
+  inline uint8_t height() const { return height_; }
+  inline uint8_t width() const { return width_; }
+  inline size_t size() const { return size_t(height_) * width_; }
+
+  /// \return the first cell of \p row.
+  inline T *operator[](size_t row) { return cells_ + row * width_; }
+  inline const T *operator[](size_t row) const {
+    return cells_ + row * width_;
+  }
+
+  inline T *data() { return cells_; }
+  inline const T *data() const { return cells_; }
+
+  inline T *begin() { return cells_; }
+  inline T *end() { return cells_ + size(); }
+  inline const T *begin() const { return cells_; }
+  inline const T *end() const { return cells_ + size(); }
+
+  /// \return the bytes of heap owned by the grid, 0 for a view.
+  inline size_t heapBytes() const { return storage_.capacity() * sizeof(T); }
+
+private:
+  inline bool owning() const { return cells_ == storage_.data(); }
+
+  void reset() {
+    storage_.clear();
+    cells_ = nullptr;
+    height_ = 0;
+    width_ = 0;
+  }
+
+  std::vector<T> storage_{};
+  T *cells_{nullptr};
+  uint8_t height_{0};
+  uint8_t width_{0};
+};
+
+template <typename T> inline size_t heapBytes(const Grid<T> &grid) {
+  return grid.heapBytes();
+}
+
+} // namespace cygnus
+
+#endif
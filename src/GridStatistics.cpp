@@ -0,0 +1,81 @@
+#include "GridStatistics.h"
+
+#include <vector>
+
+namespace cygnus {
+
+GridStatistics GridStatistics::compute(const Puzzle &puzzle) {
+  const Grid<char> &solution = puzzle.getSolution();
+  const Grid<Puzzle::Markup> &markup = puzzle.getMarkup();
+  const uint8_t height = solution.height();
+  const uint8_t width = solution.width();
+  const char *cells = solution.data();
+  const size_t size = solution.size();
+
+  GridStatistics stats{};
+  stats.puzzles = 1;
+  stats.cells = size;
+  stats.rebusCells = puzzle.getRebusFill().size();
+
+  // Lengths of the across run ending at the current cell, and of the down
+  // run ending in each column, so that the grid is read once in order.
+  uint32_t acrossRun = 0;
+  std::vector<uint32_t> downRuns(width, 0);
+  auto endRun = [&stats](uint32_t &run) {
+    if (run >= 2) {
+      ++stats.words;
+      stats.wordLetters += run;
+    }
+    run = 0;
+  };
+
+  bool rotational = true;
+  bool mirrored = true;
+  size_t i = 0;
+  for (uint8_t r = 0; r < height; ++r) {
+    const char *row = solution[r];
+    for (uint8_t c = 0; c < width; ++c, ++i) {
+      const char cell = cells[i];
+      const bool black = cell == BLACK;
+      rotational = rotational && black == (cells[size - 1 - i] == BLACK);
+      mirrored = mirrored && black == (row[width - 1 - c] == BLACK);
+      if (black) {
+        ++stats.blackCells;
+        endRun(acrossRun);
+        endRun(downRuns[c]);
+        continue;
+      }
+      ++acrossRun;
+      ++downRuns[c];
+      if (cell >= 'A' && cell <= 'Z') {
+        ++stats.letters[cell - 'A'];
+      }
+      stats.circledCells += (markup.data()[i] & Puzzle::CircledTag) != 0;
+    }
+    endRun(acrossRun);
+  }
+  for (uint32_t &run : downRuns) {
+    endRun(run);
+  }
+  stats.rotational = rotational;
+  stats.mirrored = mirrored;
+  return stats;
+}
+
+GridStatistics &GridStatistics::operator+=(const GridStatistics &other) {
+  puzzles += other.puzzles;
+  cells += other.cells;
+  blackCells += other.blackCells;
+  words += other.words;
+  wordLetters += other.wordLetters;
+  rebusCells += other.rebusCells;
+  circledCells += other.circledCells;
+  rotational += other.rotational;
+  mirrored += other.mirrored;
+  for (size_t i = 0; i < letters.size(); ++i) {
+    letters[i] += other.letters[i];
+  }
+  return *this;
+}
+
+} // namespace cygnus
@@ -0,0 +1,51 @@
+#ifndef GRIDSTATISTICS_H
+#define GRIDSTATISTICS_H
+
+#include "Puzzle.h"
+
+#include <array>
+#include <cstdint>
+
+namespace cygnus {
+
+/// Statistics of the grid of a puzzle, or the sum of those of several
+/// puzzles, for editorial checks of a collection.
+/// Everything is gathered in a single row-major pass over the solution and
+/// markup grids, so computing them costs less than loading the puzzle.
+struct GridStatistics {
+  /// Number of puzzles summed, 1 for a single puzzle.
+  uint64_t puzzles{0};
+  uint64_t cells{0};
+  uint64_t blackCells{0};
+  /// Entries of two or more letters, and their total length.
+  uint64_t words{0};
+  uint64_t wordLetters{0};
+  /// Cells with a rebus entry in the player's fill, from the RUSR extension.
+  uint64_t rebusCells{0};
+  /// Cells marked with Puzzle::CircledTag in the GEXT extension.
+  uint64_t circledCells{0};
+  /// Puzzles whose black cells are unchanged by a half turn, and by a
+  /// left-right mirror.
+  uint64_t rotational{0};
+  uint64_t mirrored{0};
+  /// Occurrences of each letter from A to Z in the solution.
+  std::array<uint64_t, 26> letters{};
+
+  /// \return the statistics of the grid of \p puzzle.
+  static GridStatistics compute(const Puzzle &puzzle);
+
+  /// Add the statistics of \p other to these.
+  GridStatistics &operator+=(const GridStatistics &other);
+
+  inline double averageWordLength() const {
+    return words ? static_cast<double>(wordLetters) / words : 0;
+  }
+
+  inline double blackRatio() const {
+    return cells ? static_cast<double>(blackCells) / cells : 0;
+  }
+};
+
+} // namespace cygnus
+
+#endif
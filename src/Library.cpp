@@ -0,0 +1,531 @@
+#include "Library.h"
+
+#include "Metrics.h"
+#include "SnapshotCache.h"
+#include "Trace.h"
+#include "WorkPool.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <algorithm>
+
+namespace cygnus {
+
+namespace {
+
+const quint32 INDEX_MAGIC = 0x4359494c;
+
+/// Increment whenever the layout of the index changes, older indices are
+/// discarded and rebuilt by a scan.
+const quint32 INDEX_FORMAT = 3;
+
+/// Wait for notifications to stop for this long before rescanning.
+const int kChangeDelayMs = 250;
+
+/// Wait for changes to stop for this long before writing the index.
+const int kSaveDelayMs = 2000;
+
+/// The library of the application, once instance() has created it.
+Library *applicationLibrary = nullptr;
+
+struct ScanResult {
+  std::vector<LibraryEntry> entries;
+  QStringList subdirectories;
+};
+
+/// \return true if \p path is \p directory or is inside it.
+bool isUnder(const QString &path, const QString &directory) {
+  return path.startsWith(directory) &&
+         (path.size() == directory.size() || path[directory.size()] == '/');
+}
+
+bool isUnderAny(const QString &path, const QStringList &directories) {
+  for (const QString &directory : directories) {
+    if (isUnder(path, directory)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// \return \p path as an absolute path without redundant separators.
+QString normalize(const QString &path) {
+  return QDir::cleanPath(QFileInfo{path}.absoluteFilePath());
+}
+
+/// Read the file of \p entry, summarize it and sign its answers.
+void summarize(LibraryEntry &entry) {
+  QFile file{entry.path};
+  if (!file.open(QIODevice::ReadOnly)) {
+    entry.valid = false;
+    return;
+  }
+  const QByteArray contents = file.readAll();
+  entry.hash = SnapshotCache::contentHash(contents);
+  entry.valid = Puzzle::summarize(contents, entry.summary);
+  entry.signature.clear();
+  if (entry.valid) {
+    // Answers follow the numbering of the clues, which takes a full load.
+    if (const auto puzzle = Puzzle::loadFromFile(contents)) {
+      entry.signature = SimilarityIndex::signature(*puzzle);
+    }
+  }
+}
+
+/// List every puzzle file and directory under \p roots, and summarize the
+/// files which aren't in \p known with the same size and modification time,
+/// along with the saved \p files.
+/// Runs on a background thread.
+ScanResult scanRoots(const QStringList &roots, const QStringList &files,
+                     const QHash<QString, LibraryEntry> &known) {
+  CYGNUS_TRACE_SPAN("Library::scan");
+  CYGNUS_METRICS_TIMER("library.scan_ns");
+  ScanResult result{};
+  std::vector<size_t> stale{};
+
+  // Listing is bound by the file system, so it stays on this thread.
+  for (const QString &root : roots) {
+    result.subdirectories.push_back(root);
+    QDirIterator dirs{root, QDir::Dirs | QDir::NoDotAndDotDot,
+                      QDirIterator::Subdirectories};
+    while (dirs.hasNext()) {
+      result.subdirectories.push_back(dirs.next());
+    }
+
+    QDirIterator files{root, QStringList{"*.puz"}, QDir::Files,
+                       QDirIterator::Subdirectories};
+    while (files.hasNext()) {
+      files.next();
+      const QFileInfo info = files.fileInfo();
+      LibraryEntry entry{};
+      entry.path = info.absoluteFilePath();
+      entry.size = info.size();
+      entry.modified = info.lastModified().toMSecsSinceEpoch();
+
+      auto it = known.find(entry.path);
+      if (it != known.end() && it->size == entry.size &&
+          it->modified == entry.modified) {
+        result.entries.push_back(*it);
+      } else {
+        stale.push_back(result.entries.size());
+        result.entries.push_back(std::move(entry));
+      }
+    }
+  }
+
+  // Saved files are read again regardless, since they just changed.
+  for (const QString &path : files) {
+    const QFileInfo info{path};
+    if (isUnderAny(path, roots) || !info.isFile()) {
+      continue;
+    }
+    LibraryEntry entry{};
+    entry.path = path;
+    entry.size = info.size();
+    entry.modified = info.lastModified().toMSecsSinceEpoch();
+    stale.push_back(result.entries.size());
+    result.entries.push_back(std::move(entry));
+  }
+
+  // Reading and summarizing files saturates every core.
+  static Counter &filesRead = Metrics::counter("library.files_read");
+  filesRead.add(static_cast<int64_t>(stale.size()));
+  WorkPool pool{};
+  pool.run(stale.size(),
+           [&](size_t i) { summarize(result.entries[stale[i]]); });
+  return result;
+}
+
+QDataStream &operator<<(QDataStream &out, const Signature &signature) {
+  out << quint8(signature.size());
+  for (const uint32_t hash : signature) {
+    out << quint32(hash);
+  }
+  return out;
+}
+
+QDataStream &operator>>(QDataStream &in, Signature &signature) {
+  quint8 size;
+  in >> size;
+  signature.resize(size);
+  for (uint32_t &hash : signature) {
+    quint32 value;
+    in >> value;
+    hash = value;
+  }
+  return in;
+}
+
+QDataStream &operator<<(QDataStream &out, const LibraryEntry &entry) {
+  const Puzzle::Summary &summary = entry.summary;
+  return out << entry.path << entry.size << entry.modified << entry.valid
+             << quint64(entry.hash) << summary.title << summary.author
+             << quint8(summary.width) << quint8(summary.height)
+             << quint16(summary.numClues)
+             << quint16(summary.cells) << quint16(summary.filled)
+             << quint64(summary.seconds) << entry.signature;
+}
+
+QDataStream &operator>>(QDataStream &in, LibraryEntry &entry) {
+  Puzzle::Summary &summary = entry.summary;
+  quint8 width, height;
+  quint16 numClues, cells, filled;
+  quint64 hash, seconds;
+  in >> entry.path >> entry.size >> entry.modified >> entry.valid >> hash >>
+      summary.title >> summary.author >> width >> height >> numClues >>
+      cells >> filled >> seconds >> entry.signature;
+  entry.hash = hash;
+  summary.width = width;
+  summary.height = height;
+  summary.numClues = numClues;
+  summary.cells = cells;
+  summary.filled = filled;
+  summary.seconds = seconds;
+  return in;
+}
+
+} // namespace
+
+Library::Library(const QString &indexPath, QObject *parent)
+    : QObject(parent), indexPath_(indexPath) {
+  if (loadIndex()) {
+    // Catch up with the files changed while the library wasn't watching.
+    // Unchanged files aren't read, so this only lists the directories.
+    QMetaObject::invokeMethod(this, &Library::scan, Qt::QueuedConnection);
+  }
+
+  changeTimer_.setSingleShot(true);
+  changeTimer_.setInterval(kChangeDelayMs);
+  connect(&watcher_, &QFileSystemWatcher::directoryChanged, this,
+          [this](const QString &directory) {
+            if (!changedDirectories_.contains(directory)) {
+              changedDirectories_.push_back(directory);
+            }
+            changeTimer_.start();
+          });
+  connect(&changeTimer_, &QTimer::timeout, this, [this] {
+    requestScan(changedDirectories_);
+    changedDirectories_.clear();
+  });
+
+  saveTimer_.setSingleShot(true);
+  saveTimer_.setInterval(kSaveDelayMs);
+  connect(&saveTimer_, &QTimer::timeout, this, &Library::startSave);
+}
+
+Library::~Library() {
+  if (scanThread_) {
+    scanThread_->wait();
+    delete scanThread_;
+  }
+  if (saveThread_) {
+    saveThread_->wait();
+    delete saveThread_;
+  }
+  // Changes made since the last write, which was still waiting.
+  if (unsaved_) {
+    saveIndex(indexPath_, directories_, watcher_.directories(), entries_);
+  }
+  if (applicationLibrary == this) {
+    applicationLibrary = nullptr;
+  }
+}
+
+Library &Library::instance() {
+  if (!applicationLibrary) {
+    applicationLibrary =
+        new Library{defaultIndexPath(), QCoreApplication::instance()};
+  }
+  return *applicationLibrary;
+}
+
+Library *Library::existing() { return applicationLibrary; }
+
+QString Library::defaultIndexPath() {
+  return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+         "/library.index";
+}
+
+void Library::addDirectory(const QString &directory) {
+  const QString root = normalize(directory);
+  if (isUnderAny(root, directories_)) {
+    return;
+  }
+  // Directories inside the new one are now covered by it.
+  directories_.erase(std::remove_if(directories_.begin(), directories_.end(),
+                                    [&](const QString &existing) {
+                                      return isUnder(existing, root);
+                                    }),
+                     directories_.end());
+  directories_.push_back(root);
+  scheduleSave();
+  requestScan(QStringList{root});
+}
+
+void Library::removeDirectory(const QString &directory) {
+  const QString root = normalize(directory);
+  directories_.removeAll(root);
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [&](const LibraryEntry &entry) {
+                                  return isUnder(entry.path, root);
+                                }),
+                 entries_.end());
+  updateWatches(QStringList{});
+  similarityStale_ = true;
+  scheduleSave();
+  emit changed();
+}
+
+void Library::scan() { requestScan(directories_); }
+
+void Library::refresh(const QString &path) {
+  const QString file = normalize(path);
+  if (!isUnderAny(file, directories_)) {
+    return;
+  }
+  if (!pendingFiles_.contains(file)) {
+    pendingFiles_.push_back(file);
+  }
+  // Saving also notifies the watcher, so wait for it to scan both at once.
+  changeTimer_.start();
+}
+
+std::vector<SimilarityIndex::Match> Library::similar(const QString &path,
+                                                     size_t limit) const {
+  const QString file = normalize(path);
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), file,
+      [](const LibraryEntry &a, const QString &b) { return a.path < b; });
+  if (it == entries_.end() || it->path != file) {
+    return {};
+  }
+  if (similarityStale_) {
+    CYGNUS_TRACE_SPAN("Library::buildSimilarity");
+    similarity_.clear();
+    for (const LibraryEntry &entry : entries_) {
+      similarity_.add(entry.signature);
+    }
+    similarityStale_ = false;
+  }
+
+  const auto self = static_cast<uint32_t>(it - entries_.begin());
+  auto matches = similarity_.query(
+      it->signature, SimilarityIndex::kThreshold, limit + 1);
+  matches.erase(std::remove_if(matches.begin(), matches.end(),
+                               [&](const SimilarityIndex::Match &match) {
+                                 return match.item == self;
+                               }),
+                matches.end());
+  if (matches.size() > limit) {
+    matches.resize(limit);
+  }
+  return matches;
+}
+
+void Library::requestScan(const QStringList &roots) {
+  for (const QString &root : roots) {
+    if (!pendingRoots_.contains(root)) {
+      pendingRoots_.push_back(root);
+    }
+  }
+  if (!scanThread_) {
+    startScan();
+  }
+}
+
+void Library::startScan() {
+  const QStringList roots = pendingRoots_;
+  const QStringList files = pendingFiles_;
+  pendingRoots_.clear();
+  pendingFiles_.clear();
+  if (roots.isEmpty() && files.isEmpty()) {
+    return;
+  }
+
+  // Files which were already indexed are only read again if they changed.
+  QHash<QString, LibraryEntry> known{};
+  for (const LibraryEntry &entry : entries_) {
+    if (isUnderAny(entry.path, roots)) {
+      known.insert(entry.path, entry);
+    }
+  }
+
+  scanThread_ = QThread::create([this, roots, files, known] {
+    ScanResult result = scanRoots(roots, files, known);
+    QMetaObject::invokeMethod(
+        this,
+        [this, roots, files, result] {
+          finishScan(roots, files, result.entries, result.subdirectories);
+        },
+        Qt::QueuedConnection);
+  });
+  connect(scanThread_, &QThread::finished, this, [this] {
+    scanThread_->deleteLater();
+    scanThread_ = nullptr;
+    startScan();
+    if (!scanThread_) {
+      emit scanningChanged(false);
+    }
+  });
+  scanThread_->start();
+  emit scanningChanged(true);
+}
+
+void Library::finishScan(const QStringList &roots, const QStringList &files,
+                         std::vector<LibraryEntry> entries,
+                         const QStringList &subdirectories) {
+  auto stale = [&](const QString &path) {
+    return isUnderAny(path, roots) || files.contains(path) ||
+           !isUnderAny(path, directories_);
+  };
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [&](const LibraryEntry &entry) {
+                                  return stale(entry.path);
+                                }),
+                 entries_.end());
+  for (auto &entry : entries) {
+    // Directories may have been removed while they were scanned.
+    if (isUnderAny(entry.path, directories_)) {
+      entries_.push_back(std::move(entry));
+    }
+  }
+  auto byPath = [](const LibraryEntry &a, const LibraryEntry &b) {
+    return a.path < b.path;
+  };
+  std::sort(entries_.begin(), entries_.end(), byPath);
+  entries_.erase(std::unique(entries_.begin(), entries_.end(),
+                             [](const LibraryEntry &a, const LibraryEntry &b) {
+                               return a.path == b.path;
+                             }),
+                 entries_.end());
+
+  updateWatches(subdirectories);
+  similarityStale_ = true;
+  scheduleSave();
+  emit changed();
+}
+
+void Library::updateWatches(const QStringList &directories) {
+  QStringList stale{};
+  for (const QString &directory : watcher_.directories()) {
+    if (!isUnderAny(directory, directories_)) {
+      stale.push_back(directory);
+    }
+  }
+  if (!stale.isEmpty()) {
+    watcher_.removePaths(stale);
+  }
+
+  QStringList added{};
+  for (const QString &directory : directories_ + directories) {
+    if (isUnderAny(directory, directories_) &&
+        !watcher_.directories().contains(directory) &&
+        !added.contains(directory)) {
+      added.push_back(directory);
+    }
+  }
+  if (!added.isEmpty()) {
+    watcher_.addPaths(added);
+  }
+}
+
+bool Library::loadIndex() {
+  CYGNUS_TRACE_SPAN("Library::loadIndex");
+  CYGNUS_METRICS_TIMER("library.load_ns");
+  QFile file{indexPath_};
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  QDataStream in{&file};
+  in.setVersion(QDataStream::Qt_5_12);
+  quint32 magic, format, count;
+  in >> magic >> format;
+  if (magic != INDEX_MAGIC || format != INDEX_FORMAT) {
+    qDebug() << "Discarding library index:" << indexPath_;
+    return false;
+  }
+
+  QStringList directories{};
+  QStringList watched{};
+  in >> directories >> watched >> count;
+  // Every entry takes more than a byte, which bounds a corrupt count.
+  if (count > file.size()) {
+    qWarning() << "Corrupt library index:" << indexPath_;
+    return false;
+  }
+  std::vector<LibraryEntry> entries(count);
+  for (auto &entry : entries) {
+    in >> entry;
+  }
+  if (in.status() != QDataStream::Ok) {
+    qWarning() << "Corrupt library index:" << indexPath_;
+    return false;
+  }
+
+  directories_ = directories;
+  entries_ = std::move(entries);
+  updateWatches(watched);
+  return true;
+}
+
+void Library::scheduleSave() {
+  unsaved_ = true;
+  saveTimer_.start();
+}
+
+void Library::startSave() {
+  if (saveThread_) {
+    // Written again once the current write finishes.
+    return;
+  }
+  unsaved_ = false;
+  // The entries are copied, so that they can change during the write.
+  saveThread_ = QThread::create([indexPath = indexPath_,
+                                 directories = directories_,
+                                 watched = watcher_.directories(),
+                                 entries = entries_] {
+    saveIndex(indexPath, directories, watched, entries);
+  });
+  connect(saveThread_, &QThread::finished, this, [this] {
+    saveThread_->deleteLater();
+    saveThread_ = nullptr;
+    if (unsaved_ && !saveTimer_.isActive()) {
+      startSave();
+    }
+  });
+  saveThread_->start();
+}
+
+bool Library::saveIndex(const QString &indexPath,
+                        const QStringList &directories,
+                        const QStringList &watched,
+                        const std::vector<LibraryEntry> &entries) {
+  CYGNUS_TRACE_SPAN("Library::saveIndex");
+  QDir{}.mkpath(QFileInfo{indexPath}.absolutePath());
+  QSaveFile file{indexPath};
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Unable to write library index:" << indexPath;
+    return false;
+  }
+  QDataStream out{&file};
+  out.setVersion(QDataStream::Qt_5_12);
+  out << INDEX_MAGIC << INDEX_FORMAT << directories << watched
+      << static_cast<quint32>(entries.size());
+  for (const auto &entry : entries) {
+    out << entry;
+  }
+  return file.commit();
+}
+
+} // namespace cygnus
@@ -0,0 +1,167 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "Puzzle.h"
+#include "SimilarityIndex.h"
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include <vector>
+
+class QThread;
+
+namespace cygnus {
+
+/// A puzzle file in the library, along with its metadata.
+struct LibraryEntry {
+  QString path{};
+  /// Size and modification time in ms since the epoch when the file was
+  /// summarized, used to tell whether it has to be read again.
+  qint64 size{0};
+  qint64 modified{0};
+  /// False if the file isn't a valid puzzle, in which case it is kept in the
+  /// index so that it isn't read on every scan, but not shown.
+  bool valid{false};
+  /// SnapshotCache::contentHash() of the file, which identifies its contents
+  /// in other caches.
+  uint64_t hash{0};
+  Puzzle::Summary summary{};
+  /// MinHash signature of the answers, computed along with the summary so
+  /// that similar puzzles can be found without reading any file.
+  Signature signature{};
+
+  /// \return the percentage of white cells filled in, from 0 to 100.
+  inline int completion() const {
+    return summary.cells ? 100 * summary.filled / summary.cells : 0;
+  }
+};
+
+/// Index of the puzzle files in a set of directories.
+/// The index is kept on disk, so that opening the library only reads the
+/// index. Scans run in the background: directories are listed, and the files
+/// which are new or have changed since they were indexed are summarized in
+/// parallel on every core, along with the signatures of their answers.
+/// Directories are watched for changes, which rescan only the directory that
+/// changed.
+class Library : public QObject {
+  Q_OBJECT
+
+public:
+  /// Keep the index in the file at \p indexPath, and load it if it exists.
+  /// The loaded entries are shown straight away, and a scan is queued to
+  /// bring them up to date.
+  explicit Library(const QString &indexPath = defaultIndexPath(),
+                   QObject *parent = nullptr);
+  ~Library() override;
+
+  /// \return the library of the application, using the default index.
+  /// It is created on first use and destroyed with the application.
+  static Library &instance();
+
+  /// \return the library of the application if instance() was called,
+  /// otherwise nullptr, so that updating it doesn't load it.
+  static Library *existing();
+
+  /// \return the index file in the user's data directory.
+  static QString defaultIndexPath();
+
+  /// \return the directories in the library.
+  inline const QStringList &directories() const { return directories_; }
+
+  /// \return every file in the library, sorted by path.
+  inline const std::vector<LibraryEntry> &entries() const { return entries_; }
+
+  /// \return true if a scan is running.
+  inline bool scanning() const { return scanThread_ != nullptr; }
+
+  /// Add \p directory and its subdirectories to the library, and scan them.
+  void addDirectory(const QString &directory);
+
+  /// Remove \p directory and every file in it from the library.
+  void removeDirectory(const QString &directory);
+
+  /// Rescan every directory. Unchanged files are not read again.
+  void scan();
+
+  /// Update the entry of the file at \p path in the background, after it was
+  /// saved.
+  void refresh(const QString &path);
+
+  /// \return the entries sharing the most answers with the file at \p path,
+  /// most similar first and without the file itself, at most \p limit.
+  /// Items of the matches are indices in entries(). The similarity index is
+  /// built from the stored signatures by the first query after a change.
+  std::vector<SimilarityIndex::Match> similar(const QString &path,
+                                              size_t limit = 50) const;
+
+signals:
+  /// Emitted whenever the entries have changed.
+  void changed();
+
+  /// Emitted when scanning starts or stops, see scanning().
+  void scanningChanged(bool scanning);
+
+private:
+  /// Scan \p roots in the background, replacing their entries when done.
+  /// Roots requested while a scan is running are scanned after it.
+  void requestScan(const QStringList &roots);
+
+  /// Start scanning the pending roots and files.
+  void startScan();
+
+  /// Replace every entry under \p roots, and those of \p files, by
+  /// \p entries.
+  void finishScan(const QStringList &roots, const QStringList &files,
+                  std::vector<LibraryEntry> entries,
+                  const QStringList &subdirectories);
+
+  /// Watch \p directories, and stop watching any directory not in the
+  /// library.
+  void updateWatches(const QStringList &directories);
+
+  bool loadIndex();
+
+  /// Write the index once changes stop for a while, rather than on every
+  /// change, since it holds every entry.
+  void scheduleSave();
+
+  /// Write the index in the background.
+  void startSave();
+
+  /// Write \p directories, \p watched and \p entries to the index at
+  /// \p indexPath. Runs on any thread.
+  static bool saveIndex(const QString &indexPath,
+                        const QStringList &directories,
+                        const QStringList &watched,
+                        const std::vector<LibraryEntry> &entries);
+
+  QString indexPath_;
+  QStringList directories_{};
+  std::vector<LibraryEntry> entries_{};
+  mutable SimilarityIndex similarity_{};
+  /// True if entries_ changed since similarity_ was built.
+  mutable bool similarityStale_{true};
+
+  QFileSystemWatcher watcher_{};
+  /// Coalesces bursts of change notifications into one scan.
+  QTimer changeTimer_{};
+  QStringList changedDirectories_{};
+
+  QThread *scanThread_{nullptr};
+  QStringList pendingRoots_{};
+  /// Saved files waiting to be summarized again, see refresh().
+  QStringList pendingFiles_{};
+
+  QTimer saveTimer_{};
+  QThread *saveThread_{nullptr};
+  /// True if entries_ changed since the index was last written.
+  bool unsaved_{false};
+};
+
+} // namespace cygnus
+
+#endif
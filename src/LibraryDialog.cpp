@@ -0,0 +1,286 @@
+#include "LibraryDialog.h"
+
+#include <QDebug>
+
+namespace cygnus {
+
+/// \return \p seconds as m:ss, or h:mm:ss from an hour on.
+static QString formatTime(uint64_t seconds) {
+  if (seconds >= 3600) {
+    return QString("%1:%2:%3")
+        .arg(seconds / 3600)
+        .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+        .arg(seconds % 60, 2, 10, QChar('0'));
+  }
+  return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10,
+                                                 QChar('0'));
+}
+
+LibraryModel::LibraryModel(const Library &library, QObject *parent)
+    : QAbstractTableModel(parent), library_(library) {
+  reload();
+  connect(&library, &Library::changed, this, &LibraryModel::reload);
+  connect(&thumbnails_, &ThumbnailCache::ready, this,
+          &LibraryModel::thumbnailReady);
+}
+
+void LibraryModel::reload() {
+  beginResetModel();
+  rows_.clear();
+  rowByPath_.clear();
+  const auto &entries = library_.entries();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].valid &&
+        (similarity_.isEmpty() || similarity_.contains(entries[i].path))) {
+      rowByPath_.insert(entries[i].path, static_cast<int>(rows_.size()));
+      rows_.push_back(i);
+    }
+  }
+  endResetModel();
+}
+
+void LibraryModel::showSimilar(const QHash<QString, float> &similarity) {
+  similarity_ = similarity;
+  reload();
+}
+
+void LibraryModel::thumbnailReady(const QString &path) {
+  auto it = rowByPath_.find(path);
+  if (it != rowByPath_.end()) {
+    const QModelIndex changed = index(*it, TITLE);
+    emit dataChanged(changed, changed, {Qt::DecorationRole});
+  }
+}
+
+int LibraryModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(rows_.size());
+}
+
+int LibraryModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+QVariant LibraryModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid()) {
+    return QVariant{};
+  }
+  const LibraryEntry &e = entry(index.row());
+  if (role == Qt::DecorationRole) {
+    // Only asked for the rows being painted, so a large library only makes
+    // the thumbnails which are looked at.
+    return index.column() == TITLE ? QVariant{thumbnails_.thumbnail(e)}
+                                   : QVariant{};
+  }
+  if (role != Qt::DisplayRole && role != SortRole && role != Qt::ToolTipRole) {
+    return QVariant{};
+  }
+  const Puzzle::Summary &summary = e.summary;
+  if (role == Qt::ToolTipRole) {
+    return e.path;
+  }
+  const bool display = role == Qt::DisplayRole;
+  switch (index.column()) {
+  case TITLE:
+    return summary.title;
+  case AUTHOR:
+    return summary.author;
+  case SIZE:
+    return display ? QVariant{QString("%1x%2")
+                                  .arg(summary.width)
+                                  .arg(summary.height)}
+                   : QVariant{summary.width * summary.height};
+  case CLUES:
+    return summary.numClues;
+  case COMPLETE:
+    return display ? QVariant{QString("%1%").arg(e.completion())}
+                   : QVariant{e.completion()};
+  case TIME:
+    return display ? QVariant{formatTime(summary.seconds)}
+                   : QVariant{static_cast<qulonglong>(summary.seconds)};
+  case FILE:
+    return QFileInfo{e.path}.fileName();
+  case SIMILARITY: {
+    auto it = similarity_.find(e.path);
+    if (it == similarity_.end()) {
+      return QVariant{};
+    }
+    return display ? QVariant{QString("%1%").arg(qRound(*it * 100))}
+                   : QVariant{*it};
+  }
+  default:
+    return QVariant{};
+  }
+}
+
+QVariant LibraryModel::headerData(int section, Qt::Orientation orientation,
+                                  int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+    return QVariant{};
+  }
+  switch (section) {
+  case TITLE:
+    return tr("Title");
+  case AUTHOR:
+    return tr("Author");
+  case SIZE:
+    return tr("Size");
+  case CLUES:
+    return tr("Clues");
+  case COMPLETE:
+    return tr("Complete");
+  case TIME:
+    return tr("Time");
+  case FILE:
+    return tr("File");
+  case SIMILARITY:
+    return tr("Similarity");
+  default:
+    return QVariant{};
+  }
+}
+
+LibraryDialog::LibraryDialog(Library &library, QWidget *parent)
+    : QDialog(parent), library_(library) {
+  setWindowTitle(tr("Puzzle Library"));
+  resize(900, 600);
+
+  model_ = new LibraryModel{library, this};
+  proxy_ = new QSortFilterProxyModel{this};
+  proxy_->setSourceModel(model_);
+  proxy_->setSortRole(LibraryModel::SortRole);
+  proxy_->setFilterKeyColumn(-1);
+  proxy_->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+  filter_ = new QLineEdit{};
+  filter_->setPlaceholderText(tr("Filter by title, author or file"));
+  filter_->setClearButtonEnabled(true);
+  connect(filter_, &QLineEdit::textChanged, proxy_,
+          &QSortFilterProxyModel::setFilterFixedString);
+
+  view_ = new QTableView{};
+  view_->setModel(proxy_);
+  view_->setSortingEnabled(true);
+  view_->sortByColumn(LibraryModel::TITLE, Qt::AscendingOrder);
+  view_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  view_->setSelectionMode(QAbstractItemView::SingleSelection);
+  view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  // Fixed row heights, so that large libraries don't measure every row.
+  view_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  const int thumbnailSize = model_->thumbnailSize();
+  view_->setIconSize(QSize{thumbnailSize, thumbnailSize});
+  view_->verticalHeader()->setDefaultSectionSize(thumbnailSize + 4);
+  view_->verticalHeader()->hide();
+  view_->horizontalHeader()->setSectionResizeMode(LibraryModel::TITLE,
+                                                  QHeaderView::Stretch);
+  // The similarity column is only shown with similar puzzles.
+  auto showSimilarity = [this] {
+    view_->setColumnHidden(LibraryModel::SIMILARITY, !model_->filtered());
+  };
+  showSimilarity();
+  connect(model_, &QAbstractItemModel::modelReset, this, showSimilarity);
+  connect(view_, &QTableView::activated, this, &LibraryDialog::openIndex);
+
+  status_ = new QLabel{};
+
+  auto *addButton = new QPushButton{tr("&Add Folder...")};
+  auto *removeButton = new QPushButton{tr("&Remove Folder...")};
+  auto *rescanButton = new QPushButton{tr("Re&scan")};
+  similarButton_ = new QPushButton{tr("Find S&imilar")};
+  similarButton_->setToolTip(
+      tr("Show the puzzles sharing many answers with the selected one"));
+  auto *buttons = new QDialogButtonBox{QDialogButtonBox::Open |
+                                       QDialogButtonBox::Cancel};
+  connect(addButton, &QPushButton::clicked, this,
+          &LibraryDialog::addDirectory);
+  connect(removeButton, &QPushButton::clicked, this,
+          &LibraryDialog::removeDirectory);
+  connect(rescanButton, &QPushButton::clicked, &library_, &Library::scan);
+  connect(similarButton_, &QPushButton::clicked, this,
+          &LibraryDialog::findSimilar);
+  connect(buttons, &QDialogButtonBox::accepted, this,
+          [this] { openIndex(view_->currentIndex()); });
+  connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+  auto *bottomLayout = new QHBoxLayout{};
+  bottomLayout->addWidget(addButton);
+  bottomLayout->addWidget(removeButton);
+  bottomLayout->addWidget(rescanButton);
+  bottomLayout->addWidget(similarButton_);
+  bottomLayout->addWidget(status_, 1);
+  bottomLayout->addWidget(buttons);
+
+  auto *layout = new QVBoxLayout{};
+  layout->addWidget(filter_);
+  layout->addWidget(view_);
+  layout->addLayout(bottomLayout);
+  setLayout(layout);
+
+  connect(&library_, &Library::changed, this, &LibraryDialog::updateStatus);
+  connect(&library_, &Library::scanningChanged, this,
+          &LibraryDialog::updateStatus);
+  updateStatus();
+}
+
+void LibraryDialog::addDirectory() {
+  const QString directory = QFileDialog::getExistingDirectory(
+      this, tr("Add Folder"), QDir::homePath());
+  if (!directory.isEmpty()) {
+    library_.addDirectory(directory);
+  }
+}
+
+void LibraryDialog::removeDirectory() {
+  bool ok = false;
+  const QString directory = QInputDialog::getItem(
+      this, tr("Remove Folder"), tr("Folder:"), library_.directories(), 0,
+      false, &ok);
+  if (ok && !directory.isEmpty()) {
+    library_.removeDirectory(directory);
+  }
+}
+
+void LibraryDialog::openIndex(const QModelIndex &index) {
+  if (!index.isValid()) {
+    return;
+  }
+  selectedFile_ = model_->entry(proxy_->mapToSource(index).row()).path;
+  accept();
+}
+
+void LibraryDialog::findSimilar() {
+  if (model_->filtered()) {
+    model_->showSimilar(QHash<QString, float>{});
+    view_->sortByColumn(LibraryModel::TITLE, Qt::AscendingOrder);
+    similarButton_->setText(tr("Find S&imilar"));
+    updateStatus();
+    return;
+  }
+  const QModelIndex index = view_->currentIndex();
+  if (!index.isValid()) {
+    return;
+  }
+  const QString path = model_->entry(proxy_->mapToSource(index).row()).path;
+  // The selected puzzle is listed first, as the most similar to itself.
+  QHash<QString, float> similarity{};
+  similarity.insert(path, 1.0f);
+  for (const auto &match : library_.similar(path)) {
+    similarity.insert(library_.entries()[match.item].path, match.similarity);
+  }
+  model_->showSimilar(similarity);
+  view_->sortByColumn(LibraryModel::SIMILARITY, Qt::DescendingOrder);
+  similarButton_->setText(tr("Show &All"));
+  updateStatus();
+}
+
+void LibraryDialog::updateStatus() {
+  QString status =
+      model_->filtered()
+          ? tr("%n similar puzzle(s)", "", qMax(model_->rowCount() - 1, 0))
+          : tr("%n puzzle(s)", "", model_->rowCount());
+  if (library_.scanning()) {
+    status += tr(", scanning...");
+  }
+  status_->setText(status);
+}
+
+} // namespace cygnus
@@ -0,0 +1,107 @@
+#ifndef LIBRARYDIALOG_H
+#define LIBRARYDIALOG_H
+
+#include "Library.h"
+#include "ThumbnailCache.h"
+
+#include <QtWidgets>
+
+#include <vector>
+
+namespace cygnus {
+
+/// Table of the valid puzzles in a Library, one row per file.
+/// The title of each puzzle is decorated with a thumbnail of its grid, which
+/// is only made once the row is shown.
+class LibraryModel : public QAbstractTableModel {
+  Q_OBJECT
+public:
+  enum Column {
+    TITLE,
+    AUTHOR,
+    SIZE,
+    CLUES,
+    COMPLETE,
+    TIME,
+    FILE,
+    /// Only has values while similar puzzles are shown, see showSimilar().
+    SIMILARITY,
+    COLUMN_COUNT,
+  };
+
+  /// Values sort by this role, so that sizes and times sort numerically.
+  static constexpr int SortRole = Qt::UserRole;
+
+  explicit LibraryModel(const Library &library, QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index,
+                int role = Qt::DisplayRole) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+  /// \return the library entry shown in \p row.
+  inline const LibraryEntry &entry(int row) const {
+    return library_.entries()[rows_[row]];
+  }
+
+  /// \return the size in pixels of the thumbnails.
+  inline int thumbnailSize() const { return thumbnails_.size(); }
+
+  /// Show only the files in \p similarity, with their similarity to the
+  /// puzzle they were found for, or every file if it is empty.
+  void showSimilar(const QHash<QString, float> &similarity);
+
+  /// \return true if only some of the files are shown, see showSimilar().
+  inline bool filtered() const { return !similarity_.isEmpty(); }
+
+private:
+  /// Rebuild the rows after the library has changed.
+  void reload();
+
+  /// Repaint the thumbnail of the file at \p path once it is ready.
+  void thumbnailReady(const QString &path);
+
+  const Library &library_;
+  /// Index in the library of the entry shown in each row.
+  std::vector<size_t> rows_{};
+  /// Row showing each file.
+  QHash<QString, int> rowByPath_{};
+  /// Files to show and their similarity, or empty to show every file.
+  QHash<QString, float> similarity_{};
+  mutable ThumbnailCache thumbnails_{};
+};
+
+/// Browses the puzzles in a Library, and picks one to open.
+class LibraryDialog : public QDialog {
+  Q_OBJECT
+public:
+  explicit LibraryDialog(Library &library, QWidget *parent = nullptr);
+
+  /// \return the file chosen by the user, empty if none was.
+  inline const QString &selectedFile() const { return selectedFile_; }
+
+private slots:
+  void addDirectory();
+  void removeDirectory();
+  void openIndex(const QModelIndex &index);
+  /// Show the puzzles sharing many answers with the selected one, or every
+  /// puzzle again if they are already shown.
+  void findSimilar();
+  void updateStatus();
+
+private:
+  Library &library_;
+  LibraryModel *model_;
+  QSortFilterProxyModel *proxy_;
+  QTableView *view_;
+  QLineEdit *filter_;
+  QPushButton *similarButton_;
+  QLabel *status_;
+  QString selectedFile_{};
+};
+
+} // namespace cygnus
+
+#endif
@@ -1,55 +1,33 @@
 #include "MainWindow.h"
 
 #include "Colors.h"
+#include "LibraryDialog.h"
+#include "Metrics.h"
 #include "Settings.h"
+#include "Trace.h"
 #include "Version.h"
 
 #include <QDebug>
 #include <QDir>
 #include <QFileDialog>
+#include <QThread>
 #include <QtWidgets>
 
 #include <memory>
 
 namespace cygnus {
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+MainWindow::MainWindow(QWidget *parent, const QString &snapshotDirectory)
+    : QMainWindow(parent), snapshots_(snapshotDirectory) {
   this->setWindowTitle(tr("Cygnus Crosswords"));
 
-  // Set up light and dark palettes.
+  // Set up the light palette. The dark one is built when it is first used.
   lightPalette_ = palette();
   lightPalette_.setColor(QPalette::Highlight, Colors::PRIMARY_HIGHLIGHT);
   lightPalette_.setColor(QPalette::HighlightedText, Qt::black);
   lightPalette_.setColor(QPalette::AlternateBase, Colors::SECONDARY_HIGHLIGHT);
   lightPalette_.setColor(QPalette::ButtonText, Colors::PENCIL);
 
-  darkPalette_.setColor(QPalette::Window, QColor(53, 53, 53));
-  darkPalette_.setColor(QPalette::WindowText, Qt::white);
-  darkPalette_.setColor(QPalette::Disabled, QPalette::WindowText,
-                        QColor(127, 127, 127));
-  darkPalette_.setColor(QPalette::Base, QColor(42, 42, 42));
-  darkPalette_.setColor(QPalette::AlternateBase, QColor(66, 66, 66));
-  darkPalette_.setColor(QPalette::ToolTipBase, Qt::white);
-  darkPalette_.setColor(QPalette::ToolTipText, Qt::white);
-  darkPalette_.setColor(QPalette::Text, Qt::white);
-  darkPalette_.setColor(QPalette::Disabled, QPalette::Text,
-                        QColor(127, 127, 127));
-  darkPalette_.setColor(QPalette::Dark, QColor(35, 35, 35));
-  darkPalette_.setColor(QPalette::Shadow, QColor(20, 20, 20));
-  darkPalette_.setColor(QPalette::Button, QColor(53, 53, 53));
-  darkPalette_.setColor(QPalette::ButtonText, Qt::white);
-  darkPalette_.setColor(QPalette::ButtonText, Colors::PENCIL_DARK);
-  darkPalette_.setColor(QPalette::Disabled, QPalette::ButtonText,
-                        QColor(127, 127, 127));
-  darkPalette_.setColor(QPalette::BrightText, Qt::red);
-  darkPalette_.setColor(QPalette::Link, QColor(42, 130, 218));
-  darkPalette_.setColor(QPalette::Highlight, Colors::PRIMARY_HIGHLIGHT_DARK);
-  darkPalette_.setColor(QPalette::Disabled, QPalette::Highlight,
-                        QColor(80, 80, 80));
-  darkPalette_.setColor(QPalette::HighlightedText, Qt::white);
-  darkPalette_.setColor(QPalette::Disabled, QPalette::HighlightedText,
-                        QColor(127, 127, 127));
-
   auto *vLayout = new QVBoxLayout{};
 
   auto *infoLayout = new QHBoxLayout{};
@@ -131,7 +109,18 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
   connect(timer, &QTimer::timeout, this, &MainWindow::tickTimer);
   connect(timerWidget_, &TimerWidget::clicked, this, &MainWindow::toggleTimer);
 
+  clueTimer_ = new QTimer(this);
+  clueTimer_->setInterval(0);
+  connect(clueTimer_, &QTimer::timeout, this, &MainWindow::fillClues);
+
+  frameTimer_ = new QTimer(this);
+  frameTimer_->setSingleShot(true);
+  frameTimer_->setTimerType(Qt::PreciseTimer);
+  connect(frameTimer_, &QTimer::timeout, this, &MainWindow::flushView);
+  lastFlush_.start();
+
   centralWidget_->hide();
+  setAcceptDrops(true);
 }
 
 void MainWindow::showMaximized() { QMainWindow::showMaximized(); }
@@ -140,12 +129,38 @@ void MainWindow::resizeEvent(QResizeEvent *event) {
   QMainWindow::resizeEvent(event);
 }
 
+/// \return the local puzzle files among the URLs dropped with \p mimeData.
+static QStringList droppedPuzzles(const QMimeData *mimeData) {
+  QStringList paths{};
+  for (const QUrl &url : mimeData->urls()) {
+    const QString path = url.toLocalFile();
+    if (path.endsWith(".puz", Qt::CaseInsensitive)) {
+      paths.push_back(path);
+    }
+  }
+  return paths;
+}
+
+void MainWindow::dragEnterEvent(QDragEnterEvent *event) {
+  if (!droppedPuzzles(event->mimeData()).isEmpty()) {
+    event->acceptProposedAction();
+  }
+}
+
+void MainWindow::dropEvent(QDropEvent *event) {
+  const QStringList paths = droppedPuzzles(event->mimeData());
+  if (!paths.isEmpty()) {
+    event->acceptProposedAction();
+    emit openRequested(paths);
+  }
+}
+
 void MainWindow::closeEvent(QCloseEvent *event) {
   if (!puzzle_) {
     return event->accept();
   }
 
-  if (!isWindowModified()) {
+  if (!modified_) {
     return event->accept();
   }
 
@@ -168,6 +183,7 @@ void MainWindow::closeEvent(QCloseEvent *event) {
 }
 
 void MainWindow::reloadPuzzle() {
+  CYGNUS_TRACE_SPAN("MainWindow::reloadPuzzle");
   saveAct_->setEnabled(true);
   saveAsAct_->setEnabled(true);
 
@@ -175,8 +191,19 @@ void MainWindow::reloadPuzzle() {
   viewMenu_->setEnabled(true);
 
   undoStack_.clear();
+  redoStack_.clear();
+  undoAct_->setEnabled(false);
+  redoAct_->setEnabled(false);
+
+  modified_ = false;
+  setWindowModified(false);
+  pendingUpdates_ = 0;
+  pendingChanges_.clear();
+  pendingIndex_.assign(puzzle_->getHeight() * puzzle_->getWidth(), -1);
+  cursorShown_ = false;
+  pastCluesKey_ = -1;
 
-  if (puzzle_->getNote().isEmpty()) {
+  if (!puzzle_->hasNote()) {
     noteButton_->hide();
   } else {
     noteButton_->show();
@@ -187,15 +214,12 @@ void MainWindow::reloadPuzzle() {
   timerWidget_->setCurrent(puzzle_->getTimer().current);
   timerWidget_->setRunning(puzzle_->getTimer().running);
 
+  // The clue lists are filled in once the grid is up, see fillClues().
   acrossWidget_->clear();
-  for (const auto &clue : puzzle_->getClues(Direction::ACROSS)) {
-    acrossWidget_->addClue(QString("%1. %2").arg(clue.num).arg(clue.clue));
-  }
-
   downWidget_->clear();
-  for (const auto &clue : puzzle_->getClues(Direction::DOWN)) {
-    downWidget_->addClue(QString("%1. %2").arg(clue.num).arg(clue.clue));
-  }
+  cluesFilled_[0] = 0;
+  cluesFilled_[1] = 0;
+  clueTimer_->start();
 
   if (puzzleWidget_) {
     delete puzzleWidget_;
@@ -221,11 +245,13 @@ void MainWindow::reloadPuzzle() {
 
   centralWidget_->show();
 
+  flushView();
   puzzleWidget_->setFocus();
   toggleDarkMode();
 }
 
 void MainWindow::setCursor(uint8_t row, uint8_t col, Direction dir) {
+  CYGNUS_TRACE_SPAN("MainWindow::setCursor");
   const auto &grid = puzzle_->getGrid();
 
   // Previous square in direction dir.
@@ -247,28 +273,40 @@ void MainWindow::setCursor(uint8_t row, uint8_t col, Direction dir) {
     dir = flip(dir);
   }
 
+  cursor_.row = row;
+  cursor_.col = col;
+  cursor_.dir = dir;
+  scheduleUpdate(kUpdateCursor);
+}
+
+void MainWindow::showCursor() {
+  const auto &grid = puzzle_->getGrid();
+  const uint8_t row = cursor_.row;
+  const uint8_t col = cursor_.col;
+  const Direction dir = cursor_.dir;
+
   // Clear current selection.
-  if (cursor_.dir == Direction::ACROSS) {
-    for (uint8_t i = 0; cursor_.col + i < puzzle_->getWidth() &&
-                        grid[cursor_.row][cursor_.col + i] != BLACK;
+  if (cursorShown_ && shownCursor_.dir == Direction::ACROSS) {
+    const Cursor &shown = shownCursor_;
+    for (uint8_t i = 0; shown.col + i < puzzle_->getWidth() &&
+                        grid[shown.row][shown.col + i] != BLACK;
          ++i) {
-      puzzleWidget_->deselectPosition(cursor_.row, cursor_.col + i);
+      puzzleWidget_->deselectPosition(shown.row, shown.col + i);
     }
     for (uint8_t i = 0;
-         cursor_.col - i >= 0 && grid[cursor_.row][cursor_.col - i] != BLACK;
-         ++i) {
-      puzzleWidget_->deselectPosition(cursor_.row, cursor_.col - i);
+         shown.col - i >= 0 && grid[shown.row][shown.col - i] != BLACK; ++i) {
+      puzzleWidget_->deselectPosition(shown.row, shown.col - i);
     }
-  } else {
-    for (uint8_t i = 0; cursor_.row + i < puzzle_->getHeight() &&
-                        grid[cursor_.row + i][cursor_.col] != BLACK;
+  } else if (cursorShown_) {
+    const Cursor &shown = shownCursor_;
+    for (uint8_t i = 0; shown.row + i < puzzle_->getHeight() &&
+                        grid[shown.row + i][shown.col] != BLACK;
          ++i) {
-      puzzleWidget_->deselectPosition(cursor_.row + i, cursor_.col);
+      puzzleWidget_->deselectPosition(shown.row + i, shown.col);
     }
     for (uint8_t i = 0;
-         cursor_.row - i >= 0 && grid[cursor_.row - i][cursor_.col] != BLACK;
-         ++i) {
-      puzzleWidget_->deselectPosition(cursor_.row - i, cursor_.col);
+         shown.row - i >= 0 && grid[shown.row - i][shown.col] != BLACK; ++i) {
+      puzzleWidget_->deselectPosition(shown.row - i, shown.col);
     }
   }
 
@@ -291,19 +329,10 @@ void MainWindow::setCursor(uint8_t row, uint8_t col, Direction dir) {
     }
   }
 
-  uint32_t curNum =
-      puzzle_->getNumByPosition(cursor_.row, cursor_.col, cursor_.dir);
-  uint32_t flipNum =
-      puzzle_->getNumByPosition(cursor_.row, cursor_.col, flip(cursor_.dir));
-  int curClue = puzzle_->getClueIdxByNum(cursor_.dir, curNum);
-  int flipClue = puzzle_->getClueIdxByNum(flip(cursor_.dir), flipNum);
-
-  curNum = puzzle_->getNumByPosition(row, col, dir);
-  flipNum = puzzle_->getNumByPosition(row, col, flip(dir));
-  curClue = puzzle_->getClueIdxByNum(dir, curNum);
-  flipClue = puzzle_->getClueIdxByNum(flip(dir), flipNum);
-
-  QPalette pal;
+  uint32_t curNum = puzzle_->getNumByPosition(row, col, dir);
+  uint32_t flipNum = puzzle_->getNumByPosition(row, col, flip(dir));
+  int curClue = puzzle_->getClueIdxByNum(dir, curNum);
+  int flipClue = puzzle_->getClueIdxByNum(flip(dir), flipNum);
 
   if (dir == Direction::ACROSS) {
     acrossWidget_->setCurrentRow(curClue);
@@ -320,13 +349,176 @@ void MainWindow::setCursor(uint8_t row, uint8_t col, Direction dir) {
   }
 
   puzzleWidget_->selectCursorPosition(row, col);
-  cursor_.row = row;
-  cursor_.col = col;
-  cursor_.dir = dir;
+  shownCursor_ = cursor_;
+  cursorShown_ = true;
+
+  const Clue &clue = puzzle_->getClues(dir)[curClue];
+  QString text =
+      QString{"%1. %2"}.arg(clue.num).arg(puzzle_->getClueText(clue));
+  if (pastCluesAct_->isChecked()) {
+    text += pastClues(clue);
+  }
+  curClueLabel_->setText(text);
+}
+
+QString MainWindow::pastClues(const Clue &clue) {
+  const int key = clue.num << 1 | static_cast<int>(clue.dir);
+  if (key == pastCluesKey_) {
+    return pastClues_;
+  }
+  if (!clueDatabase_) {
+    // Shown again with the past clues once the database is open.
+    if (!clueDatabaseTried_) {
+      openClueDatabase(false);
+    }
+    return QString{};
+  }
+  CYGNUS_TRACE_SPAN("MainWindow::pastClues");
+  pastCluesKey_ = key;
+  pastClues_.clear();
+
+  // The puzzle itself may be in the database, so its own clue is skipped.
+  const QString current = puzzle_->getClueText(clue).simplified();
+  QStringList clues{};
+  for (const auto &entry :
+       clueDatabase_->lookup(puzzle_->getAnswer(clue), kPastClues + 1)) {
+    if (clues.size() < static_cast<int>(kPastClues) &&
+        entry.clue.compare(current, Qt::CaseInsensitive) != 0) {
+      clues.push_back(entry.clue);
+    }
+  }
+  if (!clues.isEmpty()) {
+    pastClues_ = "\n" + tr("Also clued: %1").arg(clues.join("; "));
+  }
+  return pastClues_;
+}
+
+MainWindow::~MainWindow() {
+  if (clueDatabaseThread_) {
+    clueDatabaseThread_->wait();
+  }
+}
+
+void MainWindow::openClueDatabase(bool report) {
+  clueDatabaseTried_ = true;
+  clueDatabaseThread_ = QThread::create([this, report] {
+    auto database = std::make_shared<ClueDatabase>();
+    const bool opened = database->open(ClueDatabase::defaultPath());
+    QMetaObject::invokeMethod(
+        this,
+        [this, database, opened, report] {
+          if (!opened) {
+            if (report) {
+              QMessageBox::information(
+                  this, tr("Past Clues"),
+                  tr("There is no clue database at %1.\n\nBuild one from "
+                     "a folder of puzzles with \"cygnus-cli cluedb "
+                     "<folder>\".")
+                      .arg(ClueDatabase::defaultPath()));
+            }
+            return;
+          }
+          clueDatabase_ = database;
+          pastCluesKey_ = -1;
+          if (puzzle_) {
+            scheduleUpdate(kUpdateCursor);
+          }
+        },
+        Qt::QueuedConnection);
+  });
+  connect(clueDatabaseThread_, &QThread::finished, this, [this] {
+    clueDatabaseThread_->deleteLater();
+    clueDatabaseThread_ = nullptr;
+  });
+  clueDatabaseThread_->start();
+}
+
+void MainWindow::fillClues() {
+  CYGNUS_TRACE_SPAN("MainWindow::fillClues");
+  size_t budget = kClueChunk;
+  bool done = true;
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    ClueWidget *widget =
+        dir == Direction::ACROSS ? acrossWidget_ : downWidget_;
+    const auto &clues = puzzle_->getClues(dir);
+    size_t &filled = cluesFilled_[size_t(dir)];
+    for (; filled < clues.size() && budget > 0; ++filled, --budget) {
+      const Clue &clue = clues[filled];
+      widget->addClue(
+          QString("%1. %2").arg(clue.num).arg(puzzle_->getClueText(clue)));
+    }
+    done = done && filled == clues.size();
+  }
+
+  if (done) {
+    clueTimer_->stop();
+    // Select the current clues, which may not have been in the lists yet.
+    scheduleUpdate(kUpdateCursor);
+  }
+}
+
+void MainWindow::finishLoading() {
+  while (clueTimer_->isActive()) {
+    fillClues();
+  }
+  flushView();
+}
+
+void MainWindow::scheduleUpdate(uint8_t updates) {
+  pendingUpdates_ |= updates;
+  if (frameTimer_->isActive()) {
+    return;
+  }
+  // Update right away if a frame has passed since the last update, so that
+  // isolated keystrokes aren't delayed. Otherwise wait for the next frame.
+  qint64 elapsed = lastFlush_.elapsed();
+  frameTimer_->start(elapsed >= kFrameIntervalMs
+                         ? 0
+                         : static_cast<int>(kFrameIntervalMs - elapsed));
+}
+
+void MainWindow::flushView() {
+  CYGNUS_TRACE_SPAN("MainWindow::flushView");
+  frameTimer_->stop();
+  lastFlush_.start();
+
+  const uint8_t updates = pendingUpdates_;
+  pendingUpdates_ = 0;
+  if (!puzzle_ || !puzzleWidget_) {
+    return;
+  }
+
+  if (updates & kUpdateCells) {
+    puzzleWidget_->applyChanges(pendingChanges_);
+    for (const auto &change : pendingChanges_) {
+      pendingIndex_[change.row * puzzle_->getWidth() + change.col] = -1;
+    }
+    pendingChanges_.clear();
+  }
+
+  if (updates & kUpdateCursor) {
+    showCursor();
+  }
+
+  if (updates & kUpdateHistory) {
+    setWindowModified(modified_);
+    undoAct_->setEnabled(!undoStack_.empty());
+    redoAct_->setEnabled(!redoStack_.empty());
+    static Counter &undoRecords = Metrics::counter("undo.records");
+    undoRecords.set(undoStack_.size());
+  }
 
-  uint32_t num = curNum;
-  const Clue &clue = puzzle_->getClues(dir)[puzzle_->getClueIdxByNum(dir, num)];
-  curClueLabel_->setText(QString{"%1. %2"}.arg(clue.num).arg(clue.clue));
+  if (inputStart_ >= 0) {
+    static Histogram &latency = Metrics::histogram("input.latency_ns");
+    static Histogram &allocations = Metrics::histogram("input.allocations");
+    latency.record(Metrics::now() - inputStart_);
+    if (Metrics::countsAllocations()) {
+      allocations.record(
+          (Metrics::threadAllocations() - inputAllocations_) / inputEvents_);
+    }
+    inputStart_ = -1;
+    inputEvents_ = 0;
+  }
 }
 
 std::pair<QWidget *, ClueWidget *>
@@ -363,6 +555,12 @@ void MainWindow::createActions() {
   openAct_->setStatusTip(tr("Open an existing file"));
   connect(openAct_, &QAction::triggered, this, &MainWindow::open);
 
+  openLibraryAct_ = new QAction(tr("Open from &Library..."), this);
+  openLibraryAct_->setShortcut(QKeySequence(tr("Ctrl+Shift+O")));
+  openLibraryAct_->setStatusTip(tr("Browse the puzzles in your library"));
+  connect(openLibraryAct_, &QAction::triggered, this,
+          &MainWindow::openLibrary);
+
   saveAct_ = new QAction(tr("&Save"), this);
   saveAct_->setShortcuts(QKeySequence::Save);
   saveAct_->setStatusTip(tr("Save the current puzzle"));
@@ -402,6 +600,18 @@ void MainWindow::createActions() {
           &MainWindow::toggleDarkMode);
   toggleDarkMode();
 
+  pastCluesAct_ = new QAction(tr("&Past Clues"), this);
+  pastCluesAct_->setCheckable(true);
+  pastCluesAct_->setStatusTip(
+      tr("Show how the current answer was clued in other puzzles"));
+  pastCluesAct_->setChecked(settings.value(Settings::pastClues).toBool());
+  connect(pastCluesAct_, &QAction::triggered, this,
+          &MainWindow::togglePastClues);
+  if (pastCluesAct_->isChecked()) {
+    // Ready by the time a puzzle is shown, without delaying it.
+    openClueDatabase(false);
+  }
+
   revealCurrentAct_ = new QAction(tr("Current Letter"), this);
   revealCurrentAct_->setStatusTip(tr("Reveal the current letter"));
   connect(revealCurrentAct_, &QAction::triggered, this,
@@ -438,27 +648,43 @@ void MainWindow::createActions() {
 
   shortcutsAct_ = new QAction(tr("View &Shortcuts"), this);
   connect(shortcutsAct_, &QAction::triggered, this, &MainWindow::shortcuts);
+
+  saveStatsAct_ = new QAction(tr("Save S&tatistics..."), this);
+  saveStatsAct_->setStatusTip(tr("Save latency histograms and counters"));
+  connect(saveStatsAct_, &QAction::triggered, this, &MainWindow::saveStats);
+
+  memoryUsageAct_ = new QAction(tr("&Memory Usage"), this);
+  memoryUsageAct_->setStatusTip(tr("Show the memory used by each window"));
+  connect(memoryUsageAct_, &QAction::triggered, this,
+          &MainWindow::showMemoryUsage);
 }
 
-void MainWindow::loadFile() {
-  qDebug() << "Opening file:" << fileName_;
-  QFile file{fileName_};
-  if (!file.open(QIODevice::ReadOnly)) {
-    fileName_ = nullptr;
+void MainWindow::loadFile() { loadFile(fileName_); }
+
+void MainWindow::loadFile(const QString &fileName) {
+  CYGNUS_TRACE_SPAN("MainWindow::loadFile");
+  CYGNUS_METRICS_TIMER("load_ns");
+  qDebug() << "Opening file:" << fileName;
+  if (!QFileInfo{fileName}.isReadable()) {
     return;
   }
-  QByteArray puzFile = file.readAll();
-  puzzle_ = std::move(Puzzle::loadFromFile(puzFile));
-  if (puzzle_) {
-    QFileInfo info{fileName_};
-    this->setWindowTitle(
-        QString("[*]%1 - Cygnus Crosswords").arg(info.fileName()));
-    reloadPuzzle();
-  } else {
+  setPuzzle(fileName, snapshots_.load(fileName));
+}
+
+void MainWindow::setPuzzle(const QString &fileName,
+                           std::unique_ptr<Puzzle> puzzle) {
+  if (!puzzle) {
     QMessageBox::warning(
         this, QString("Corrupted File"),
-        QString("The file %1 isn't a valid puzzle file.").arg(fileName_));
+        QString("The file %1 isn't a valid puzzle file.").arg(fileName));
+    return;
   }
+  fileName_ = fileName;
+  puzzle_ = std::move(puzzle);
+  QFileInfo info{fileName_};
+  this->setWindowTitle(
+      QString("[*]%1 - Cygnus Crosswords").arg(info.fileName()));
+  reloadPuzzle();
 }
 
 void MainWindow::open() {
@@ -467,19 +693,32 @@ void MainWindow::open() {
                                    tr("Across Lite File (*.puz)"));
 
   if (!fileName.isEmpty()) {
-    fileName_ = fileName;
-    loadFile();
+    loadFile(fileName);
+  }
+}
+
+void MainWindow::openLibrary() {
+  LibraryDialog dialog{Library::instance(), this};
+  if (dialog.exec() == QDialog::Accepted && !dialog.selectedFile().isEmpty()) {
+    loadFile(dialog.selectedFile());
   }
 }
 
 void MainWindow::save() {
+  CYGNUS_METRICS_TIMER("save_ns");
   QFile file{fileName_};
   qDebug() << "Saving to:" << file.fileName();
   if (file.open(QIODevice::WriteOnly)) {
     QByteArray bytes = puzzle_->serialize();
     file.write(bytes);
     file.close();
-    setWindowModified(false);
+    snapshots_.store(fileName_, *puzzle_, bytes);
+    // A library which hasn't been opened has nothing to update.
+    if (Library *library = Library::existing()) {
+      library->refresh(fileName_);
+    }
+    modified_ = false;
+    scheduleUpdate(kUpdateHistory);
   }
 }
 
@@ -488,127 +727,153 @@ void MainWindow::saveAs() {
       this, tr("Save Puzzle"), "",
       tr("Across Lite File (*.puz);;All Files (*)"));
 
+  CYGNUS_METRICS_TIMER("save_ns");
   QFile file{fileName};
   qDebug() << "Saving to:" << file.fileName();
   if (file.open(QIODevice::WriteOnly)) {
     QByteArray bytes = puzzle_->serialize();
     file.write(bytes);
+    file.close();
+    snapshots_.store(fileName, *puzzle_, bytes);
+    if (Library *library = Library::existing()) {
+      library->refresh(fileName);
+    }
   }
 }
 
-void MainWindow::reveal(uint8_t row, uint8_t col, bool check) {
-  char current = puzzle_->getGrid()[row][col];
+void MainWindow::reveal(Puzzle::Transaction &txn, uint8_t row, uint8_t col) {
+  char current = txn.getCell(row, col);
   if (current == BLACK) {
     return;
   }
   char solution = puzzle_->getSolution()[row][col];
   if (current == EMPTY || current != solution) {
-    setCell(row, col, QString("%1").arg(solution), false);
-    puzzle_->getMarkup()[row][col] |= Puzzle::RevealedTag;
-    puzzleWidget_->setMarkup(row, col, puzzle_->getMarkup()[row][col]);
-  }
-  if (check) {
-    checkSuccess();
+    setCell(txn, row, col, QChar(solution), false);
+    txn.setMarkup(row, col, txn.getMarkup(row, col) | Puzzle::RevealedTag);
   }
 }
 
-void MainWindow::revealCurrent() { reveal(cursor_.row, cursor_.col); }
+void MainWindow::revealCurrent() {
+  Puzzle::Transaction txn{*puzzle_};
+  reveal(txn, cursor_.row, cursor_.col);
+  commit(txn);
+}
 
 void MainWindow::revealClue() {
   auto num = puzzle_->getNumByPosition(cursor_.row, cursor_.col, cursor_.dir);
   const Clue &clue = puzzle_->getClueByNum(cursor_.dir, num);
   uint8_t r = clue.row;
   uint8_t c = clue.col;
+  Puzzle::Transaction txn{*puzzle_};
   if (cursor_.dir == Direction::ACROSS) {
     while (c < puzzle_->getWidth() &&
            puzzle_->getCellData()[r][c].acrossNum == num) {
-      reveal(r, c);
+      reveal(txn, r, c);
       ++c;
     }
   } else {
     while (r < puzzle_->getHeight() &&
            puzzle_->getCellData()[r][c].downNum == num) {
-      reveal(r, c);
+      reveal(txn, r, c);
       ++r;
     }
   }
+  commit(txn);
 }
 
 void MainWindow::revealAll() {
+  Puzzle::Transaction txn{*puzzle_};
   for (uint8_t r = 0; r < puzzle_->getHeight(); ++r) {
     for (uint8_t c = 0; c < puzzle_->getWidth(); ++c) {
-      reveal(r, c, false);
+      reveal(txn, r, c);
     }
   }
-  checkSuccess();
+  commit(txn);
 }
 
-bool MainWindow::checkAndMark(uint8_t row, uint8_t col) {
+bool MainWindow::checkAndMark(Puzzle::Transaction &txn, uint8_t row,
+                              uint8_t col) {
   if (puzzle_->check(row, col)) {
     return true;
   }
-  puzzle_->getMarkup()[row][col] |= Puzzle::IncorrectTag;
-  puzzleWidget_->setMarkup(row, col, puzzle_->getMarkup()[row][col]);
+  txn.setMarkup(row, col, txn.getMarkup(row, col) | Puzzle::IncorrectTag);
   return false;
 }
 
-void MainWindow::undo() {
-  if (undoStack_.empty()) {
+void MainWindow::commit(Puzzle::Transaction &txn, bool undoable) {
+  Puzzle::ChangeSet changes = txn.commit();
+  if (changes.empty()) {
     return;
   }
-  const auto &entry = undoStack_.back();
-  uint32_t row = entry.row;
-  uint32_t col = entry.col;
 
-  redoStack_.emplace_back(
-      UndoEntry{row, col, puzzle_->getMarkup()[row][col],
-                puzzle_->getRebusFill()[row][col].isEmpty()
-                    ? QString(QChar(puzzle_->getGrid()[row][col]))
-                    : puzzle_->getRebusFill()[row][col],
-                QChar(puzzle_->getGrid()[row][col]).isLower()});
+  if (undoable) {
+    recordHistory(undoStack_, changes);
+    redoStack_.clear();
+  }
+  updateViews(changes);
 
-  setWindowModified(true);
-  puzzle_->getGrid()[row][col] = entry.text.at(0).toLatin1();
-  puzzle_->getRebusFill()[row][col] = entry.text;
-  puzzleWidget_->setCell(row, col, entry.text, entry.pencil);
-  setCursor(row, col, cursor_.dir);
+  for (const auto &change : changes) {
+    if (change.cell != change.oldCell) {
+      checkSuccess();
+      break;
+    }
+  }
+}
 
-  puzzle_->getMarkup()[row][col] = entry.markup;
-  puzzleWidget_->setMarkup(row, col, entry.markup);
+void MainWindow::recordHistory(UndoStack &stack,
+                               const Puzzle::ChangeSet &changes) {
+  stack.beginGroup();
+  for (const auto &change : changes) {
+    stack.push(change.row, change.col, change.oldCell, change.oldMarkup,
+               change.oldRebus);
+  }
+  stack.endGroup();
+}
 
-  undoStack_.pop_back();
+void MainWindow::updateViews(const Puzzle::ChangeSet &changes) {
+  for (const auto &change : changes) {
+    int32_t &idx = pendingIndex_[change.row * puzzle_->getWidth() + change.col];
+    if (idx < 0) {
+      idx = static_cast<int32_t>(pendingChanges_.size());
+      pendingChanges_.push_back(change);
+    } else {
+      pendingChanges_[idx] = change;
+    }
+  }
+  modified_ = true;
+  scheduleUpdate(kUpdateCells | kUpdateHistory);
+}
 
-  undoAct_->setEnabled(!undoStack_.empty());
-  redoAct_->setEnabled(!redoStack_.empty());
+void MainWindow::undo() {
+  if (undoStack_.empty()) {
+    return;
+  }
+  UndoStack::Record last = popHistory(undoStack_, redoStack_);
+  setCursor(last.row, last.col, cursor_.dir);
 }
 
 void MainWindow::redo() {
   if (redoStack_.empty()) {
     return;
   }
-  const auto &entry = redoStack_.back();
-  uint32_t row = entry.row;
-  uint32_t col = entry.col;
-
-  undoStack_.emplace_back(
-      UndoEntry{row, col, puzzle_->getMarkup()[row][col],
-                puzzle_->getRebusFill()[row][col].isEmpty()
-                    ? QString(QChar(puzzle_->getGrid()[row][col]))
-                    : puzzle_->getRebusFill()[row][col],
-                QChar(puzzle_->getGrid()[row][col]).isLower()});
+  popHistory(redoStack_, undoStack_);
+}
 
-  setWindowModified(true);
-  puzzle_->getGrid()[row][col] = entry.text.at(0).toLatin1();
-  puzzle_->getRebusFill()[row][col] = entry.text;
-  puzzleWidget_->setCell(row, col, entry.text, entry.pencil);
+UndoStack::Record MainWindow::popHistory(UndoStack &from, UndoStack &to) {
+  std::vector<UndoStack::Record> records = from.popGroup();
 
-  puzzle_->getMarkup()[row][col] = entry.markup;
-  puzzleWidget_->setMarkup(row, col, entry.markup);
+  // Records are most recent first, so the oldest state of each cell wins.
+  Puzzle::Transaction txn{*puzzle_};
+  for (const auto &record : records) {
+    txn.setCell(record.row, record.col, record.cell, from.getRebus(record));
+    txn.setMarkup(record.row, record.col, record.markup);
+  }
+  Puzzle::ChangeSet changes = txn.commit();
 
-  redoStack_.pop_back();
+  recordHistory(to, changes);
+  updateViews(changes);
 
-  undoAct_->setEnabled(!undoStack_.empty());
-  redoAct_->setEnabled(!redoStack_.empty());
+  return records.back();
 }
 
 void MainWindow::increaseSize() {
@@ -625,11 +890,58 @@ void MainWindow::decreaseSize() {
   }
 }
 
+void MainWindow::togglePastClues() {
+  const bool show = pastCluesAct_->isChecked();
+  QSettings{}.setValue(Settings::pastClues, show);
+  if (show && !clueDatabase_ && !clueDatabaseThread_) {
+    openClueDatabase(true);
+  }
+  pastCluesKey_ = -1;
+  if (puzzle_) {
+    scheduleUpdate(kUpdateCursor);
+  }
+}
+
+/// \return the palette of dark mode, built on first use since most sessions
+/// never need it.
+static const QPalette &darkPalette() {
+  static const QPalette palette = [] {
+    QPalette dark{};
+    dark.setColor(QPalette::Window, QColor(53, 53, 53));
+    dark.setColor(QPalette::WindowText, Qt::white);
+    dark.setColor(QPalette::Disabled, QPalette::WindowText,
+                  QColor(127, 127, 127));
+    dark.setColor(QPalette::Base, QColor(42, 42, 42));
+    dark.setColor(QPalette::AlternateBase, QColor(66, 66, 66));
+    dark.setColor(QPalette::ToolTipBase, Qt::white);
+    dark.setColor(QPalette::ToolTipText, Qt::white);
+    dark.setColor(QPalette::Text, Qt::white);
+    dark.setColor(QPalette::Disabled, QPalette::Text, QColor(127, 127, 127));
+    dark.setColor(QPalette::Dark, QColor(35, 35, 35));
+    dark.setColor(QPalette::Shadow, QColor(20, 20, 20));
+    dark.setColor(QPalette::Button, QColor(53, 53, 53));
+    dark.setColor(QPalette::ButtonText, Qt::white);
+    dark.setColor(QPalette::ButtonText, Colors::PENCIL_DARK);
+    dark.setColor(QPalette::Disabled, QPalette::ButtonText,
+                  QColor(127, 127, 127));
+    dark.setColor(QPalette::BrightText, Qt::red);
+    dark.setColor(QPalette::Link, QColor(42, 130, 218));
+    dark.setColor(QPalette::Highlight, Colors::PRIMARY_HIGHLIGHT_DARK);
+    dark.setColor(QPalette::Disabled, QPalette::Highlight, QColor(80, 80, 80));
+    dark.setColor(QPalette::HighlightedText, Qt::white);
+    dark.setColor(QPalette::Disabled, QPalette::HighlightedText,
+                  QColor(127, 127, 127));
+    return dark;
+  }();
+  return palette;
+}
+
 void MainWindow::toggleDarkMode() {
+  CYGNUS_TRACE_SPAN("MainWindow::toggleDarkMode");
   QSettings settings;
   bool dark = toggleDarkModeAct_->isChecked();
   settings.setValue(Settings::darkMode, dark);
-  QPalette &pal = dark ? darkPalette_ : lightPalette_;
+  const QPalette &pal = dark ? darkPalette() : lightPalette_;
   setPalette(lightPalette_);
   setPalette(pal);
   for (QWidget *child : findChildren<QWidget *>()) {
@@ -648,40 +960,49 @@ void MainWindow::checkSuccess() {
     return;
   }
 
-  // Puzzle is complete.
+  // Puzzle is complete. Show the final entry before the message box.
+  flushView();
   setTimerStatus(false);
   QMessageBox::information(this, "Congratulations!",
                            "You completed the puzzle correctly.");
 }
 
-void MainWindow::checkCurrent() { checkAndMark(cursor_.row, cursor_.col); }
+void MainWindow::checkCurrent() {
+  Puzzle::Transaction txn{*puzzle_};
+  checkAndMark(txn, cursor_.row, cursor_.col);
+  commit(txn, false);
+}
 
 void MainWindow::checkClue() {
   auto num = puzzle_->getNumByPosition(cursor_.row, cursor_.col, cursor_.dir);
   const Clue &clue = puzzle_->getClueByNum(cursor_.dir, num);
   uint8_t r = clue.row;
   uint8_t c = clue.col;
+  Puzzle::Transaction txn{*puzzle_};
   if (cursor_.dir == Direction::ACROSS) {
     while (c < puzzle_->getWidth() &&
            puzzle_->getCellData()[r][c].acrossNum == num) {
-      checkAndMark(r, c);
+      checkAndMark(txn, r, c);
       ++c;
     }
   } else {
     while (r < puzzle_->getHeight() &&
            puzzle_->getCellData()[r][c].downNum == num) {
-      checkAndMark(r, c);
+      checkAndMark(txn, r, c);
       ++r;
     }
   }
+  commit(txn, false);
 }
 
 void MainWindow::checkAll() {
+  Puzzle::Transaction txn{*puzzle_};
   for (uint8_t r = 0; r < puzzle_->getHeight(); ++r) {
     for (uint8_t c = 0; c < puzzle_->getWidth(); ++c) {
-      checkAndMark(r, c);
+      checkAndMark(txn, r, c);
     }
   }
+  commit(txn, false);
 }
 
 void MainWindow::insertMultiple() {
@@ -696,8 +1017,8 @@ void MainWindow::insertMultiple() {
         "", &ok, windowHint, inputHint);
     rebusInput = rebusInput.trimmed();
     if (!rebusInput.isEmpty()) {
-      setCell(cursor_.row, cursor_.col, rebusInput.toUpper(), false);
-      checkSuccess();
+      rebusInput = rebusInput.toUpper();
+      setCell(cursor_.row, cursor_.col, rebusInput.at(0), false, rebusInput);
     }
   }
 }
@@ -745,9 +1066,66 @@ void MainWindow::shortcuts() {
       QStringLiteral("https://github.com/avp/cygnus/wiki/Keyboard-Shortcuts"));
 }
 
+MemoryUsage MainWindow::memoryUsage() const {
+  MemoryUsage usage{};
+  usage.add("window.object", sizeof(MainWindow) + heapBytes(fileName_));
+  if (puzzle_) {
+    usage.add(puzzle_->memoryUsage());
+  }
+  usage.add("history.undo", undoStack_.memoryUsage());
+  usage.add("history.redo", redoStack_.memoryUsage());
+  usage.add("view.pending",
+            heapBytes(pendingChanges_) + heapBytes(pendingIndex_));
+  usage.add("widgets.grid", puzzleWidget_ ? puzzleWidget_->memoryUsage() : 0);
+  usage.add("widgets.clues",
+            acrossWidget_->memoryUsage() + downWidget_->memoryUsage());
+  return usage;
+}
+
+void MainWindow::showMemoryUsage() {
+  QString report{};
+  size_t total = 0;
+  for (QWidget *widget : QApplication::topLevelWidgets()) {
+    const auto *window = qobject_cast<MainWindow *>(widget);
+    if (!window) {
+      continue;
+    }
+    const MemoryUsage usage = window->memoryUsage();
+    total += usage.total();
+    report += QString("%1\n").arg(window->fileName_.isEmpty()
+                                      ? tr("(no puzzle)")
+                                      : window->fileName_);
+    report += usage.toString("  ");
+    report += '\n';
+  }
+  report += QString("%1 %2\n").arg(tr("All windows"), -22).arg(total, 10);
+  qDebug().noquote() << report;
+
+  QMessageBox box{this};
+  box.setWindowTitle(tr("Memory Usage"));
+  box.setTextFormat(Qt::RichText);
+  box.setText(QString("<pre>%1</pre>").arg(report.toHtmlEscaped()));
+  box.exec();
+}
+
+void MainWindow::saveStats() {
+  QString fileName = QFileDialog::getSaveFileName(
+      this, tr("Save Statistics"), "", tr("JSON File (*.json);;All Files (*)"));
+  if (fileName.isEmpty()) {
+    return;
+  }
+
+  QFile file{fileName};
+  qDebug() << "Saving statistics to:" << file.fileName();
+  if (file.open(QIODevice::WriteOnly)) {
+    file.write(Metrics::toJson());
+  }
+}
+
 void MainWindow::createMenus() {
   fileMenu_ = menuBar()->addMenu(tr("&File"));
   fileMenu_->addAction(openAct_);
+  fileMenu_->addAction(openLibraryAct_);
   fileMenu_->addAction(saveAct_);
   saveAct_->setEnabled(false);
   fileMenu_->addAction(saveAsAct_);
@@ -776,14 +1154,43 @@ void MainWindow::createMenus() {
   viewMenu_->addAction(decreaseSizeAct_);
   viewMenu_->addSeparator();
   viewMenu_->addAction(toggleDarkModeAct_);
+  viewMenu_->addAction(pastCluesAct_);
   viewMenu_->setEnabled(false);
 
   helpMenu_ = menuBar()->addMenu(tr("&Help"));
   helpMenu_->addAction(aboutAct_);
   helpMenu_->addAction(shortcutsAct_);
+  helpMenu_->addAction(saveStatsAct_);
+  helpMenu_->addAction(memoryUsageAct_);
+}
+
+bool MainWindow::event(QEvent *event) {
+  if (event->type() != QEvent::UpdateRequest) {
+    return QMainWindow::event(event);
+  }
+  bool result = false;
+  {
+    CYGNUS_METRICS_TIMER("paint.frame_ns");
+    result = QMainWindow::event(event);
+  }
+
+  // Startup ends with the first frame which shows a puzzle, in any window.
+  static bool started = false;
+  if (!started && puzzle_ && centralWidget_->isVisible()) {
+    started = true;
+    const int64_t startup = Metrics::now();
+    Metrics::histogram("startup.first_frame_ns").record(startup);
+    qDebug() << "First frame after" << startup / 1000000 << "ms";
+  }
+  return result;
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *event) {
+  if (inputStart_ < 0) {
+    inputStart_ = Metrics::now();
+    inputAllocations_ = Metrics::threadAllocations();
+  }
+  ++inputEvents_;
   switch (event->key()) {
   case Qt::Key_Up:
     keyUp(event->modifiers() & Qt::ShiftModifier);
@@ -890,9 +1297,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
           event->modifiers() == Qt::ShiftModifier) {
         // Convert to lowercase if shift is being held.
         QChar letter = event->key();
-        setCell(cursor_.row, cursor_.col, QString("%1").arg(letter.toUpper()),
+        setCell(cursor_.row, cursor_.col, letter.toUpper(),
                 event->modifiers() == Qt::ShiftModifier);
-        checkSuccess();
         entryMovement();
       }
     }
@@ -902,13 +1308,20 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
           event->modifiers() == Qt::ShiftModifier) {
         // TODO: Allow penciling numbers.
         QChar number = event->key();
-        setCell(cursor_.row, cursor_.col, QString("%1").arg(number),
-                event->modifiers() == Qt::ShiftModifier);
-        checkSuccess();
+        setCell(cursor_.row, cursor_.col, number,
+                event->modifiers() == Qt::ShiftModifier, QString(number));
         entryMovement();
       }
     }
   }
+
+  // Keys which changed nothing, such as a bare modifier, are never shown by
+  // flushView(), which would otherwise count the idle time until the next
+  // update as their latency.
+  if (pendingUpdates_ == 0) {
+    inputStart_ = -1;
+    inputEvents_ = 0;
+  }
 }
 
 void MainWindow::keyUp(bool shift) {
@@ -1010,21 +1423,24 @@ void MainWindow::keyTab(bool reverse) {
   setCursor(newPos.first, newPos.second, dir);
 }
 
-void MainWindow::setCell(uint8_t row, uint8_t col, QString text, bool pencil) {
-  if (puzzle_->getMarkup()[row][col] & Puzzle::RevealedTag) {
+void MainWindow::setCell(uint8_t row, uint8_t col, QChar entry, bool pencil,
+                         const QString &rebus) {
+  Puzzle::Transaction txn{*puzzle_};
+  setCell(txn, row, col, entry, pencil, rebus);
+  commit(txn);
+}
+
+void MainWindow::setCell(Puzzle::Transaction &txn, uint8_t row, uint8_t col,
+                         QChar entry, bool pencil, const QString &rebus) {
+  CYGNUS_TRACE_SPAN("MainWindow::setCell");
+  Puzzle::Markup markup = txn.getMarkup(row, col);
+  if (markup & Puzzle::RevealedTag) {
     // If the letter was revealed, don't allow editing it.
     return;
   }
 
-  undoStack_.emplace_back(
-      UndoEntry{row, col, puzzle_->getMarkup()[row][col],
-                puzzle_->getRebusFill()[row][col].isEmpty()
-                    ? QString(QChar(puzzle_->getGrid()[row][col]))
-                    : puzzle_->getRebusFill()[row][col]});
-  redoStack_.clear();
-
   const char digitLookup[] = "ZOTTFFSSEN";
-  QChar gridValue = text.at(0);
+  QChar gridValue = entry;
   if (gridValue.isDigit()) {
     gridValue = QChar(digitLookup[gridValue.digitValue()]);
   }
@@ -1032,23 +1448,16 @@ void MainWindow::setCell(uint8_t row, uint8_t col, QString text, bool pencil) {
     gridValue = gridValue.toLower();
   }
 
-  setWindowModified(true);
-  puzzle_->getGrid()[row][col] = gridValue.toLatin1();
-  puzzle_->getRebusFill()[row][col] = text;
-  puzzleWidget_->setCell(row, col, text, pencil);
-  Puzzle::Markup &markup = puzzle_->getMarkup()[row][col];
+  txn.setCell(row, col, gridValue.toLatin1(), rebus);
   if (markup & Puzzle::IncorrectTag) {
     markup &= ~Puzzle::IncorrectTag;
     markup |= Puzzle::PreviousIncorrectTag;
+    txn.setMarkup(row, col, markup);
   }
-  puzzleWidget_->setMarkup(row, col, markup);
-
-  undoAct_->setEnabled(!undoStack_.empty());
-  redoAct_->setEnabled(!redoStack_.empty());
 }
 
 void MainWindow::clearLetter(uint8_t row, uint8_t col) {
-  setCell(row, col, QString(EMPTY), false);
+  setCell(row, col, QChar(EMPTY), false);
 }
 
 void MainWindow::puzzleClicked(uint8_t row, uint8_t col) {
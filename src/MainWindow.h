@@ -1,14 +1,19 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "ClueDatabase.h"
 #include "ClueWidget.h"
 #include "FilledLabel.h"
 #include "Puzzle.h"
 #include "PuzzleWidget.h"
+#include "SnapshotCache.h"
 #include "TimerWidget.h"
+#include "UndoStack.h"
 
 #include <QtWidgets>
 
+#include <memory>
+
 namespace cygnus {
 
 struct Cursor {
@@ -21,7 +26,13 @@ class MainWindow : public QMainWindow {
   Q_OBJECT
 
 public:
-  explicit MainWindow(QWidget *parent = nullptr);
+  /// Snapshots of the puzzles opened in the window are kept in
+  /// \p snapshotDirectory.
+  explicit MainWindow(
+      QWidget *parent = nullptr,
+      const QString &snapshotDirectory = SnapshotCache::defaultDirectory());
+  /// Waits for the clue database to finish opening, if it is.
+  ~MainWindow() override;
   void showMaximized();
 
   void setFileName(QString fileName) { fileName_ = fileName; }
@@ -29,13 +40,41 @@ public:
   /// Load the file at the internally set fileName_;
   void loadFile();
 
+  /// Load and show the file at \p fileName. The current puzzle is kept if
+  /// the file isn't a valid puzzle.
+  void loadFile(const QString &fileName);
+
+  /// Show \p puzzle, which was loaded from \p fileName, or warn that the
+  /// file isn't a valid puzzle if it is nullptr.
+  void setPuzzle(const QString &fileName, std::unique_ptr<Puzzle> puzzle);
+
   /// \return true if the window is displaying a puzzle.
   bool isLoaded() const { return puzzle_ != nullptr; }
 
+  /// Apply any pending updates to the views immediately, instead of waiting
+  /// for the next frame.
+  void flushView();
+
+  /// Add every clue not yet in the clue lists immediately, instead of a
+  /// chunk per event loop iteration.
+  void finishLoading();
+
+  /// \return the estimated memory used by the puzzle, the undo history and
+  /// the widgets of this window.
+  MemoryUsage memoryUsage() const;
+
+signals:
+  /// Emitted when puzzle files are dropped on the window, for the
+  /// application to open them.
+  void openRequested(const QStringList &paths);
+
 public slots:
   /// Show open file dialog.
   void open();
 
+  /// Show the library, and open the puzzle chosen in it.
+  void openLibrary();
+
 private slots:
   void save();
   void saveAs();
@@ -53,10 +92,14 @@ private slots:
   void showNote();
   void about();
   void shortcuts();
+  void saveStats();
+  /// Show the memory usage of every open window.
+  void showMemoryUsage();
 
   void increaseSize();
   void decreaseSize();
   void toggleDarkMode();
+  void togglePastClues();
 
   /// Set the cursor to (row, col) and point the active squares in the direction
   /// of \param dir.
@@ -74,30 +117,112 @@ private slots:
   void tickTimer();
   void toggleTimer();
 
+  /// Add the next chunk of clues to the clue lists.
+  void fillClues();
+
 protected:
+  /// Times the painting of each frame, which happens when the window handles
+  /// an update request, and the time from process start to the first frame
+  /// with a puzzle.
+  bool event(QEvent *event) override;
+
   void resizeEvent(QResizeEvent *event) override;
 
   void closeEvent(QCloseEvent *event) override;
 
+  /// Accept puzzle files dragged onto the window.
+  void dragEnterEvent(QDragEnterEvent *event) override;
+  void dropEvent(QDropEvent *event) override;
+
 private:
   QString fileName_;
   std::unique_ptr<Puzzle> puzzle_;
   Cursor cursor_;
 
-  struct UndoEntry {
-    uint32_t row;
-    uint32_t col;
-    Puzzle::Markup markup;
-    QString text;
-    bool pencil;
+  /// Decoded puzzles, so that reopening a file doesn't parse it again.
+  SnapshotCache snapshots_;
+
+  UndoStack undoStack_{};
+  UndoStack redoStack_{};
+
+  /// Whether the puzzle has unsaved changes.
+  bool modified_{false};
+
+  /// Parts of the view which are out of date with the puzzle.
+  /// Edits are applied to the puzzle immediately, but the views are only
+  /// updated once per frame so that bursts of input are coalesced.
+  enum ViewUpdate : uint8_t {
+    kUpdateCells = 1 << 0,
+    kUpdateCursor = 1 << 1,
+    kUpdateHistory = 1 << 2,
   };
-  std::vector<UndoEntry> undoStack_{};
-  std::vector<UndoEntry> redoStack_{};
+
+  /// Minimum time between view updates, one frame at 60Hz.
+  static constexpr int kFrameIntervalMs = 16;
+
+  uint8_t pendingUpdates_{0};
+  /// Cells to update in the grid, at most one entry per cell.
+  Puzzle::ChangeSet pendingChanges_{};
+  /// Index into pendingChanges_ for each cell, -1 if it has none.
+  std::vector<int32_t> pendingIndex_{};
+
+  QTimer *frameTimer_;
+  QElapsedTimer lastFlush_{};
+
+  /// Time of the oldest keystroke not yet shown by flushView(), -1 if none,
+  /// along with the allocation count at that point and the keystroke count.
+  int64_t inputStart_{-1};
+  uint64_t inputAllocations_{0};
+  uint32_t inputEvents_{0};
+
+  /// Clues added to the lists by each call to fillClues().
+  /// The grid is shown as soon as a puzzle is loaded, and the clue lists are
+  /// filled in afterwards, so that large puzzles appear without waiting for
+  /// every list item to be created.
+  static constexpr size_t kClueChunk = 64;
+
+  QTimer *clueTimer_;
+  /// Number of clues in the across and down lists so far.
+  size_t cluesFilled_[2]{0, 0};
+
+  /// The cursor as currently displayed, valid if cursorShown_.
+  Cursor shownCursor_;
+  bool cursorShown_{false};
+
+  /// Mark \p updates as pending and schedule a flush on the next frame.
+  void scheduleUpdate(uint8_t updates);
+
+  /// Move the selection in the grid and clue lists to cursor_.
+  void showCursor();
+
+  /// \return the clues given to the answer of \p clue in other puzzles, as a
+  /// line to show under it, or an empty string if there are none or the
+  /// database isn't open yet.
+  /// The database is only searched when the current clue changes.
+  QString pastClues(const Clue &clue);
+
+  /// Open the clue database on a background thread, and show the past clues
+  /// of the current clue once it is open. If \p report, tell the user when
+  /// there is no database.
+  void openClueDatabase(bool report);
+
+  /// Clues of the answers in other puzzles, nullptr until they are opened.
+  std::shared_ptr<const ClueDatabase> clueDatabase_{};
+  /// Opens clueDatabase_, while it is running.
+  QThread *clueDatabaseThread_{nullptr};
+  bool clueDatabaseTried_{false};
+  /// Past clues shown at most for the current clue.
+  static constexpr size_t kPastClues = 5;
+  /// Clue whose past clues are in pastClues_, as (number << 1 | direction),
+  /// -1 if none.
+  int pastCluesKey_{-1};
+  QString pastClues_{};
 
   void reloadPuzzle();
 
   QMenu *fileMenu_;
   QAction *openAct_;
+  QAction *openLibraryAct_;
   QAction *saveAct_;
   QAction *saveAsAct_;
 
@@ -118,10 +243,13 @@ private:
   QAction *increaseSizeAct_;
   QAction *decreaseSizeAct_;
   QAction *toggleDarkModeAct_;
+  QAction *pastCluesAct_;
 
   QMenu *helpMenu_;
   QAction *aboutAct_;
   QAction *shortcutsAct_;
+  QAction *saveStatsAct_;
+  QAction *memoryUsageAct_;
 
   QWidget *centralWidget_;
 
@@ -142,7 +270,6 @@ private:
   PuzzleWidget *puzzleWidget_{nullptr};
 
   QPalette lightPalette_;
-  QPalette darkPalette_;
 
   void createActions();
   void createMenus();
@@ -156,16 +283,40 @@ private:
   void keyRight(bool shift = false);
   void keyTab(bool reverse);
 
-  void setCell(uint8_t row, uint8_t col, QString text, bool pencil);
+  /// Enter \p entry at (\p row, \p col) as a single edit.
+  /// \p rebus holds the full text of a multi-letter or digit entry, starting
+  /// with \p entry.
+  void setCell(uint8_t row, uint8_t col, QChar entry, bool pencil,
+               const QString &rebus = QString{});
+  void setCell(Puzzle::Transaction &txn, uint8_t row, uint8_t col, QChar entry,
+               bool pencil, const QString &rebus = QString{});
   void clearLetter(uint8_t row, uint8_t col);
 
-  void reveal(uint8_t row, uint8_t col, bool check = true);
+  void reveal(Puzzle::Transaction &txn, uint8_t row, uint8_t col);
   bool check(uint8_t row, uint8_t col);
-  bool checkAndMark(uint8_t row, uint8_t col);
+  bool checkAndMark(Puzzle::Transaction &txn, uint8_t row, uint8_t col);
+
+  /// Apply the edits in \p txn to the puzzle and update the views once.
+  /// If \p undoable, the edits are recorded as a single undo step.
+  /// Checks for completion if any cell contents changed.
+  void commit(Puzzle::Transaction &txn, bool undoable = true);
+
+  /// Push the previous state of the cells in \p changes to \p stack as one
+  /// group.
+  void recordHistory(UndoStack &stack, const Puzzle::ChangeSet &changes);
+
+  /// Schedule the grid and window state to be updated after the puzzle has
+  /// been modified.
+  void updateViews(const Puzzle::ChangeSet &changes);
 
   void undo();
   void redo();
 
+  /// Pop the most recent group from \p from and restore the cells it
+  /// recorded, pushing their current state to \p to.
+  /// \return the record of the last cell restored.
+  UndoStack::Record popHistory(UndoStack &from, UndoStack &to);
+
   /// Check whole puzzle and show message if completely correct.
   /// Else, do nothing.
   void checkSuccess();
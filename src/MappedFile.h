@@ -0,0 +1,92 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cygnus {
+
+/// A range of bytes in a file made of sections, such as the clue index.
+/// Sections start at offsets aligned to 8 bytes, so that the arrays of
+/// structs they hold can be used in place once the file is mapped.
+struct FileSection {
+  uint64_t offset;
+  uint64_t size;
+
+  /// \return true if the section is aligned and lies within a file of
+  /// \p fileSize bytes.
+  inline bool fits(qint64 fileSize) const {
+    return offset % 8 == 0 && offset <= uint64_t(fileSize) &&
+           size <= uint64_t(fileSize) - offset;
+  }
+
+  /// \return the section of the file mapped at \p data as an array of T.
+  template <typename T> inline const T *items(const char *data) const {
+    return reinterpret_cast<const T *>(data + offset);
+  }
+};
+
+/// Append \p size bytes at \p data to \p out, at an offset aligned to 8
+/// bytes. \return the section they occupy.
+inline FileSection appendSection(QByteArray &out, const char *data,
+                                 size_t size) {
+  out.append(static_cast<int>((8 - out.size() % 8) % 8), '\0');
+  FileSection section{static_cast<uint64_t>(out.size()),
+                      static_cast<uint64_t>(size)};
+  out.append(data, static_cast<int>(size));
+  return section;
+}
+
+template <typename T>
+inline FileSection appendSection(QByteArray &out,
+                                 const std::vector<T> &items) {
+  return appendSection(out, reinterpret_cast<const char *>(items.data()),
+                       items.size() * sizeof(T));
+}
+
+/// A whole file mapped read-only. The mapping lasts as long as the file is
+/// open.
+class MappedFile {
+public:
+  /// Map the file at \p path, closing any file mapped before.
+  /// \return false if it can't be opened or mapped.
+  bool open(const QString &path) {
+    close();
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly) || file->size() == 0) {
+      return false;
+    }
+    const uchar *data = file->map(0, file->size());
+    if (!data) {
+      return false;
+    }
+    size_ = file->size();
+    data_ = reinterpret_cast<const char *>(data);
+    file_ = std::move(file);
+    return true;
+  }
+
+  void close() {
+    file_.reset();
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  inline bool isOpen() const { return data_ != nullptr; }
+  inline const char *data() const { return data_; }
+  inline qint64 size() const { return size_; }
+
+private:
+  std::unique_ptr<QFile> file_{};
+  const char *data_{nullptr};
+  qint64 size_{0};
+};
+
+} // namespace cygnus
+
+#endif
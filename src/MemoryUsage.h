@@ -0,0 +1,97 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <vector>
+
+namespace cygnus {
+
+/// Estimated bytes used by each area of a window, such as the puzzle grids or
+/// the undo stack. Areas are named "subsystem.part", and the estimates count
+/// both the objects and the heap blocks they own.
+class MemoryUsage {
+public:
+  struct Entry {
+    QString area;
+    size_t bytes;
+  };
+
+  /// Add \p bytes to \p area, creating it if necessary.
+  void add(const QString &area, size_t bytes) {
+    for (auto &entry : entries_) {
+      if (entry.area == area) {
+        entry.bytes += bytes;
+        return;
+      }
+    }
+    entries_.push_back(Entry{area, bytes});
+  }
+
+  /// Add every area of \p other.
+  void add(const MemoryUsage &other) {
+    for (const auto &entry : other.entries_) {
+      add(entry.area, entry.bytes);
+    }
+  }
+
+  /// \return the bytes counted for \p area, 0 if it has none.
+  size_t bytes(const QString &area) const {
+    for (const auto &entry : entries_) {
+      if (entry.area == area) {
+        return entry.bytes;
+      }
+    }
+    return 0;
+  }
+
+  size_t total() const {
+    size_t total = 0;
+    for (const auto &entry : entries_) {
+      total += entry.bytes;
+    }
+    return total;
+  }
+
+  /// \return the areas in the order they were added.
+  inline const std::vector<Entry> &entries() const { return entries_; }
+
+  /// \return one line per area followed by the total, each indented by
+  /// \p indent.
+  QString toString(const QString &indent = QString{}) const {
+    QString out{};
+    for (const auto &entry : entries_) {
+      out += QString("%1%2 %3\n")
+                 .arg(indent)
+                 .arg(entry.area, -20)
+                 .arg(entry.bytes, 10);
+    }
+    out += QString("%1%2 %3\n").arg(indent).arg("total", -20).arg(total(), 10);
+    return out;
+  }
+
+private:
+  std::vector<Entry> entries_{};
+};
+
+/// \return the bytes of heap owned by \p vec.
+template <typename T> inline size_t heapBytes(const std::vector<T> &vec) {
+  return vec.capacity() * sizeof(T);
+}
+
+/// \return the bytes of heap owned by \p str, counting shared data in full.
+inline size_t heapBytes(const QString &str) {
+  if (str.isNull()) {
+    return 0;
+  }
+  return sizeof(QArrayData) + (str.capacity() + 1) * sizeof(QChar);
+}
+
+inline size_t heapBytes(const QByteArray &bytes) {
+  return bytes.isNull() ? 0 : sizeof(QArrayData) + bytes.capacity() + 1;
+}
+
+} // namespace cygnus
+
+#endif
@@ -0,0 +1,201 @@
+#include "Metrics.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace cygnus {
+
+// Counted by AllocationCounter.cpp, in the programs which link it.
+thread_local uint64_t allocationCount = 0;
+bool countingAllocations = false;
+
+namespace {
+
+const auto epoch = std::chrono::steady_clock::now();
+
+std::mutex registryMutex{};
+std::map<std::string, std::unique_ptr<Histogram>> histograms{};
+std::map<std::string, std::unique_ptr<Counter>> counters{};
+QString outputPath{};
+
+/// \return the index of the bucket holding \p value.
+size_t bucketIndex(uint64_t value) {
+  size_t index = 0;
+  for (size_t shift = 32; shift > 0; shift /= 2) {
+    if (value >> shift) {
+      value >>= shift;
+      index += shift;
+    }
+  }
+  return value ? index + 1 : 0;
+}
+
+/// \return the largest value counted in bucket \p index.
+uint64_t bucketLimit(size_t index) {
+  return index == 0 ? 0 : UINT64_MAX >> (Histogram::kBuckets - 1 - index);
+}
+
+} // namespace
+
+void Histogram::record(uint64_t value) {
+  buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t Histogram::quantile(double p) const {
+  uint64_t total = count();
+  uint64_t rank = static_cast<uint64_t>(p * total);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen > rank || seen == total) {
+      return std::min(bucketLimit(i), max_.load(std::memory_order_relaxed));
+    }
+  }
+  return 0;
+}
+
+QByteArray Histogram::toJson() const {
+  uint64_t total = count();
+  uint64_t sum = sum_.load(std::memory_order_relaxed);
+  QByteArray json{"{\"count\":"};
+  json += QByteArray::number(static_cast<qulonglong>(total));
+  json += ",\"mean\":";
+  json += QByteArray::number(total ? static_cast<double>(sum) / total : 0.0);
+  json += ",\"max\":";
+  json += QByteArray::number(
+      static_cast<qulonglong>(max_.load(std::memory_order_relaxed)));
+  for (double p : {0.5, 0.9, 0.99}) {
+    json += ",\"p";
+    json += QByteArray::number(static_cast<int>(p * 100));
+    json += "\":";
+    json += QByteArray::number(static_cast<qulonglong>(quantile(p)));
+  }
+
+  // Only the non-empty buckets, as [upper limit, count] pairs.
+  json += ",\"buckets\":[";
+  bool first = true;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+    if (n == 0) {
+      continue;
+    }
+    if (!first) {
+      json += ',';
+    }
+    first = false;
+    json += '[';
+    json += QByteArray::number(static_cast<qulonglong>(bucketLimit(i)));
+    json += ',';
+    json += QByteArray::number(static_cast<qulonglong>(n));
+    json += ']';
+  }
+  json += "]}";
+  return json;
+}
+
+Histogram::Timer::Timer(Histogram &histogram)
+    : histogram_(histogram), start_(Metrics::now()) {}
+
+Histogram::Timer::~Timer() {
+  histogram_.record(static_cast<uint64_t>(Metrics::now() - start_));
+}
+
+Histogram &Metrics::histogram(const char *name) {
+  std::lock_guard<std::mutex> lock{registryMutex};
+  auto &histogram = histograms[name];
+  if (!histogram) {
+    histogram.reset(new Histogram{});
+  }
+  return *histogram;
+}
+
+Counter &Metrics::counter(const char *name) {
+  std::lock_guard<std::mutex> lock{registryMutex};
+  auto &counter = counters[name];
+  if (!counter) {
+    counter.reset(new Counter{});
+  }
+  return *counter;
+}
+
+void Metrics::init(int &argc, char *argv[]) {
+  outputPath = QString::fromLocal8Bit(qgetenv("CYGNUS_STATS"));
+
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (std::strncmp(arg, "--stats=", 8) == 0) {
+      outputPath = QString::fromLocal8Bit(arg + 8);
+    } else if (std::strcmp(arg, "--stats") == 0 && i + 1 < argc) {
+      outputPath = QString::fromLocal8Bit(argv[++i]);
+    } else {
+      argv[out++] = argv[i];
+    }
+  }
+  argc = out;
+  argv[argc] = nullptr;
+}
+
+void Metrics::finish() {
+  if (outputPath.isEmpty()) {
+    return;
+  }
+  QFile file{outputPath};
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Unable to write stats to:" << outputPath;
+    return;
+  }
+  file.write(toJson());
+}
+
+QByteArray Metrics::toJson() {
+  std::lock_guard<std::mutex> lock{registryMutex};
+  QByteArray json{"{\n  \"histograms\": {"};
+  const char *separator = "\n    ";
+  for (const auto &entry : histograms) {
+    json += separator;
+    json += '"';
+    json += entry.first.c_str();
+    json += "\": ";
+    json += entry.second->toJson();
+    separator = ",\n    ";
+  }
+  json += "\n  },\n  \"counters\": {";
+  separator = "\n    ";
+  for (const auto &entry : counters) {
+    json += separator;
+    json += '"';
+    json += entry.first.c_str();
+    json += "\": ";
+    json += QByteArray::number(static_cast<qlonglong>(entry.second->value()));
+    separator = ",\n    ";
+  }
+  json += "\n  }\n}\n";
+  return json;
+}
+
+int64_t Metrics::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+uint64_t Metrics::threadAllocations() { return allocationCount; }
+
+bool Metrics::countsAllocations() { return countingAllocations; }
+
+} // namespace cygnus
@@ -0,0 +1,116 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+namespace cygnus {
+
+/// Distribution of non-negative values, such as durations in nanoseconds.
+/// Values are counted in power of two buckets, so recording is a handful of
+/// relaxed atomic operations and never takes a lock.
+class Histogram {
+public:
+  /// Bucket 0 counts zeros, bucket i counts values in [2^(i-1), 2^i).
+  static constexpr size_t kBuckets = 65;
+
+  void record(uint64_t value);
+
+  inline uint64_t count() const {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  /// \return an upper bound for the \p p quantile, with 0 <= p <= 1.
+  uint64_t quantile(double p) const;
+
+  QByteArray toJson() const;
+
+  /// Records the lifetime of the enclosing scope in nanoseconds.
+  class Timer {
+  public:
+    explicit Timer(Histogram &histogram);
+    ~Timer();
+
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+
+  private:
+    Histogram &histogram_;
+    int64_t start_;
+  };
+
+private:
+  std::atomic<uint64_t> buckets_[kBuckets]{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+/// A single value which is either accumulated or set, such as the number of
+/// cells painted or the current size of the undo stack.
+class Counter {
+public:
+  inline void add(int64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+  inline void set(int64_t n) { value_.store(n, std::memory_order_relaxed); }
+  inline int64_t value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> value_{0};
+};
+
+/// Process wide registry of named histograms and counters.
+/// Metrics are always recorded, and are written as JSON on exit if requested
+/// by the CYGNUS_STATS environment variable or the --stats <file> argument.
+class Metrics {
+public:
+  /// \return the histogram called \p name, creating it on first use.
+  /// The reference stays valid for the lifetime of the process, so call sites
+  /// should look it up once and keep it in a static.
+  static Histogram &histogram(const char *name);
+
+  /// \return the counter called \p name, creating it on first use.
+  static Counter &counter(const char *name);
+
+  /// Read the stats output file from CYGNUS_STATS, or from --stats=<file> or
+  /// --stats <file> in \p argv. The stats arguments are removed from \p argc
+  /// and \p argv.
+  static void init(int &argc, char *argv[]);
+
+  /// Write every metric to the file given to init(), if any.
+  static void finish();
+
+  /// \return every metric as a JSON object.
+  static QByteArray toJson();
+
+  /// \return the current time in nanoseconds, on the clock used for timers.
+  static int64_t now();
+
+  /// \return the number of heap allocations made by the calling thread, or
+  /// 0 unless countsAllocations().
+  static uint64_t threadAllocations();
+
+  /// \return true if the program counts its allocations, which takes linking
+  /// AllocationCounter.cpp into it.
+  static bool countsAllocations();
+};
+
+} // namespace cygnus
+
+/// Time the rest of the current scope into the histogram called \p name.
+#define CYGNUS_METRICS_TIMER(name)                                             \
+  static ::cygnus::Histogram &CYGNUS_METRICS_CONCAT(histogram, __LINE__) =     \
+      ::cygnus::Metrics::histogram(name);                                      \
+  ::cygnus::Histogram::Timer CYGNUS_METRICS_CONCAT(timer, __LINE__) {          \
+    CYGNUS_METRICS_CONCAT(histogram, __LINE__)                                 \
+  }
+
+#define CYGNUS_METRICS_CONCAT_(a, b) a##b
+#define CYGNUS_METRICS_CONCAT(a, b) CYGNUS_METRICS_CONCAT_(a, b)
+
+#endif
@@ -1,8 +1,13 @@
 #include "Puzzle.h"
 
+#include "Trace.h"
+
+#include <QCryptographicHash>
 #include <QDebug>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <memory>
 
 namespace cygnus {
 
@@ -45,12 +50,36 @@ static inline void writeUInt64LE(QByteArray::iterator start, uint64_t x) {
   }
 }
 
+/// \return the length of the NUL-terminated string at \p start, stopping at
+/// \p end if the string is unterminated.
+/// \param[in,out] start first byte, will be updated to point after the NUL
+/// byte, or to \p end.
+static inline uint32_t skipString(QByteArray::const_iterator &start,
+                                  const QByteArray::const_iterator end) {
+  if (start >= end) {
+    return 0;
+  }
+  const uint32_t length = qstrnlen(start, static_cast<uint>(end - start));
+  start += std::min<ptrdiff_t>(length + 1, end - start);
+  return length;
+}
+
 /// Reads a null-terminated string from position \p offset.
 /// \param[in,out] start first byte, will be update to point after the NUL byte.
-static inline QString readString(QByteArray::const_iterator &start) {
-  QString result = QString::fromLatin1(start);
-  start += result.size() + 1;
-  return result;
+static inline QString readString(QByteArray::const_iterator &start,
+                                 const QByteArray::const_iterator end) {
+  const auto first = start;
+  const uint32_t length = skipString(start, end);
+  return QString::fromLatin1(first, static_cast<int>(length));
+}
+
+/// Reads a NUL-terminated string as a span relative to \p base.
+static inline TextSpan readSpan(QByteArray::const_iterator &start,
+                                const QByteArray::const_iterator base,
+                                const QByteArray::const_iterator end) {
+  const auto first = start;
+  const uint32_t length = skipString(start, end);
+  return TextSpan{static_cast<uint32_t>(first - base), length};
 }
 
 static inline QByteArray makeUInt16LE(uint16_t x) {
@@ -60,35 +89,28 @@ static inline QByteArray makeUInt16LE(uint16_t x) {
   return result;
 }
 
+/// Reads every cell of \p grid from \p start.
+/// \param[in,out] start first byte, will be updated to point after the grid.
 template <typename T>
-static Grid<T> readGrid(QByteArray::const_iterator &start, const uint8_t height,
-                        const uint8_t width) {
+static inline void readGrid(QByteArray::const_iterator &start, Grid<T> &grid) {
   static_assert(sizeof(T) == sizeof(char),
                 "readGrid can only read single bytes");
-  Grid<T> grid;
-  grid.reserve(height);
-
-  for (uint8_t r = 0; r < height; ++r) {
-    std::vector<T> row;
-    row.reserve(width);
-    for (uint8_t c = 0; c < width; ++c) {
-      row.emplace_back(*start++);
-    }
-    grid.push_back(std::move(row));
-  }
+  std::memcpy(grid.data(), start, grid.size());
+  start += grid.size();
+}
 
-  return grid;
+/// \return a read-only view of the grid stored at \p start.
+static inline const Grid<char> viewGrid(QByteArray::const_iterator start,
+                                        const uint8_t height,
+                                        const uint8_t width) {
+  return Grid<char>::view(start, height, width);
 }
 
 /// Writes \p grid to \p start in place.
 template <typename T>
-static inline void writeGrid(QByteArray::iterator start, Grid<T> grid) {
+static inline void writeGrid(QByteArray::iterator start, const Grid<T> &grid) {
   static_assert(sizeof(T) == 1, "Can only write grids of chars with this");
-  for (const auto &row : grid) {
-    for (const auto c : row) {
-      *start++ = c;
-    }
-  }
+  std::copy(grid.begin(), grid.end(), start);
 }
 
 /// Computes the 16-bit checksum of the provided region.
@@ -109,23 +131,12 @@ uint16_t Puzzle::checksum(const QByteArray::const_iterator start,
 /// Computes the 16-bit checksum of the provided grid.
 /// \param seed the initial checksum to seed this computation with.
 uint16_t Puzzle::checksum(const Grid<char> &grid, uint16_t seed) {
-  uint16_t result = seed;
-  for (const auto &row : grid) {
-    for (const auto c : row) {
-      uint16_t lsb = result & 1;
-      result >>= 1;
-      // Carry the LSB over.
-      result |= lsb << 15;
-      result = (result + (c & 0xff)) & 0xffff;
-    }
-  }
-  return result & 0xffff;
+  return checksum(grid.begin(), grid.end(), seed);
 }
 
-inline uint16_t Puzzle::headerChecksum(uint8_t width, uint8_t height,
-                                       uint16_t numClues, PuzzleType puzzleType,
-                                       SolutionState solutionState,
-                                       uint16_t seed) {
+uint16_t Puzzle::headerChecksum(uint8_t width, uint8_t height,
+                                uint16_t numClues, PuzzleType puzzleType,
+                                SolutionState solutionState, uint16_t seed) {
   QByteArray header(8, 0);
   header[0] = width;
   header[1] = height;
@@ -141,28 +152,27 @@ uint16_t Puzzle::textChecksum(uint16_t numClues, const QByteArray &text,
   uint16_t result{seed};
   auto it = text.begin();
   auto titleStart = it;
-  auto title = readString(it);
+  auto title = skipString(it, text.end());
   auto authorStart = it;
-  auto author = readString(it);
+  auto author = skipString(it, text.end());
   auto copyrightStart = it;
-  auto copyright = readString(it);
+  auto copyright = skipString(it, text.end());
   auto cluesStart = it;
 
-  if (!title.isEmpty()) {
+  if (title > 0) {
     result = checksum(titleStart, authorStart, result);
   }
-  if (!author.isEmpty()) {
+  if (author > 0) {
     result = checksum(authorStart, copyrightStart, result);
   }
-  if (!copyright.isEmpty()) {
+  if (copyright > 0) {
     result = checksum(copyrightStart, cluesStart, result);
   }
 
-  for (uint16_t i = 0; i < numClues; ++i) {
+  for (uint16_t i = 0; i < numClues && it < text.end(); ++i) {
     auto start = it;
-    auto clue = readString(it);
-    auto end = it - 1;
-    result = checksum(start, end, result);
+    auto length = skipString(it, text.end());
+    result = checksum(start, start + length, result);
   }
 
   return result;
@@ -208,7 +218,9 @@ uint16_t Puzzle::globalChecksum(uint8_t width, uint8_t height,
   return result;
 }
 
-bool Puzzle::validatePuzzle(const QByteArray &puzFile) {
+/// \return true if \p puzFile has a valid header and is long enough to hold
+/// its grids.
+static bool validateHeader(const QByteArray &puzFile) {
   if (puzFile.size() < 0x34) {
     return false;
   }
@@ -219,27 +231,51 @@ bool Puzzle::validatePuzzle(const QByteArray &puzFile) {
   }
 
   uint16_t numClues = readUInt16LE(puzFile.begin() + 0x2e);
-  PuzzleType puzzleType = PuzzleType(readUInt16LE(puzFile.begin() + 0x30));
-  SolutionState solutionState =
-      SolutionState(readUInt16LE(puzFile.begin() + 0x32));
+  auto puzzleType = Puzzle::PuzzleType(readUInt16LE(puzFile.begin() + 0x30));
+  auto solutionState =
+      Puzzle::SolutionState(readUInt16LE(puzFile.begin() + 0x32));
 
   uint16_t headerChecksumExpected = readUInt16LE(puzFile.begin() + 0xe);
-  uint16_t headerChecksumActual =
-      headerChecksum(width, height, numClues, puzzleType, solutionState);
+  uint16_t headerChecksumActual = Puzzle::headerChecksum(
+      width, height, numClues, puzzleType, solutionState);
 
   if (headerChecksumExpected != headerChecksumActual) {
     qCritical() << "Header checksum check failed";
     return false;
   }
 
-  auto it = puzFile.begin() + 0x34;
-  auto solution = readGrid<char>(it, height, width);
-  auto puzzle = readGrid<char>(it, height, width);
+  if (std::memcmp(puzFile.constData() + 0x2, MAGIC, 0xb) != 0 ||
+      puzFile[0x0d] != '\x00') {
+    qCritical() << "Magic number check failed";
+    return false;
+  }
+
+  return true;
+}
+
+bool Puzzle::validatePuzzle(const QByteArray &puzFile) {
+  if (!validateHeader(puzFile)) {
+    return false;
+  }
+  uint8_t width = puzFile[0x2c];
+  uint8_t height = puzFile[0x2d];
+  uint16_t numClues = readUInt16LE(puzFile.begin() + 0x2e);
+  PuzzleType puzzleType = PuzzleType(readUInt16LE(puzFile.begin() + 0x30));
+  SolutionState solutionState =
+      SolutionState(readUInt16LE(puzFile.begin() + 0x32));
+
+  // Check the grids and text in place, without copying them.
+  const int textStart = 0x34 + 2 * width * height;
+  const auto solution = viewGrid(puzFile.begin() + 0x34, height, width);
+  const auto puzzle = viewGrid(puzFile.begin() + 0x34 + width * height, height,
+                               width);
+  const QByteArray text = QByteArray::fromRawData(
+      puzFile.constData() + textStart, puzFile.size() - textStart);
 
   uint64_t magicChecksumExpected = readUInt64LE(puzFile.begin() + 0x10);
   uint64_t magicChecksumActual =
       magicChecksum(width, height, numClues, puzzleType, solutionState,
-                    solution, puzzle, puzFile.mid(0x34 + (2 * width * height)));
+                    solution, puzzle, text);
 
   // TODO: Re-enable with extensions excluded.
   // if (magicChecksumExpected != magicChecksumActual) {
@@ -250,23 +286,134 @@ bool Puzzle::validatePuzzle(const QByteArray &puzFile) {
   uint16_t globalChecksumExpected = readUInt16LE(puzFile.begin());
   uint16_t globalChecksumActual = globalChecksum(
       width, height, numClues, puzzleType, solutionState, solution, puzzle,
-      puzFile.mid(0x34 + (2 * width * height)));
+      text);
 
   // if (globalChecksumExpected != globalChecksumActual) {
   //   qCritical() << "Global checksum check failed";
   //   return false;
   // }
 
-  QByteArray magic = puzFile.mid(0x2, 0xb);
-  if (magic != MAGIC || puzFile[0x0d] != '\x00') {
-    qCritical() << "Magic number check failed";
+  return true;
+}
+
+const Grid<char> Puzzle::viewPlayerGrid(const QByteArray &puzFile) {
+  if (!validateHeader(puzFile)) {
+    return Grid<char>{};
+  }
+  const uint8_t width = puzFile[0x2c];
+  const uint8_t height = puzFile[0x2d];
+  return viewGrid(puzFile.begin() + 0x34 + width * height, height, width);
+}
+
+QByteArray Puzzle::fingerprint(const QByteArray &puzFile) {
+  if (!validateHeader(puzFile)) {
+    return QByteArray{};
+  }
+  const uint8_t width = puzFile[0x2c];
+  const uint8_t height = puzFile[0x2d];
+  const uint16_t numClues = readUInt16LE(puzFile.begin() + 0x2e);
+  QCryptographicHash hash{QCryptographicHash::Sha1};
+  // Width, height and number of clues, followed by the solution.
+  hash.addData(puzFile.constData() + 0x2c, 4);
+  hash.addData(puzFile.constData() + 0x34, width * height);
+
+  auto it = puzFile.begin() + 0x34 + 2 * width * height;
+  const auto end = puzFile.end();
+  // The title, author and copyright.
+  for (int i = 0; i < 3; ++i) {
+    skipString(it, end);
+  }
+  const auto clues = it;
+  for (uint32_t i = 0; i < numClues; ++i) {
+    skipString(it, end);
+  }
+  // Clues keep their NUL terminators, so that moving text from one clue to
+  // the next changes the fingerprint.
+  hash.addData(clues, static_cast<int>(it - clues));
+  return hash.result();
+}
+
+bool Puzzle::summarize(const QByteArray &puzFile, Summary &summary) {
+  if (!validateHeader(puzFile)) {
     return false;
   }
+  const uint8_t width = puzFile[0x2c];
+  const uint8_t height = puzFile[0x2d];
+  summary.width = width;
+  summary.height = height;
+  summary.numClues = readUInt16LE(puzFile.begin() + 0x2e);
+
+  summary.cells = 0;
+  summary.filled = 0;
+  for (const char c :
+       viewGrid(puzFile.begin() + 0x34 + width * height, height, width)) {
+    summary.cells += c != BLACK;
+    summary.filled += c != BLACK && c != EMPTY;
+  }
+
+  auto it = puzFile.begin() + 0x34 + 2 * width * height;
+  const auto end = puzFile.end();
+  summary.title = readString(it, end);
+  summary.author = readString(it, end);
+  // The copyright, every clue and the note.
+  for (uint32_t i = 0; i < summary.numClues + 2u; ++i) {
+    skipString(it, end);
+  }
 
+  summary.seconds = 0;
+  while (end - it > 8) {
+    const uint16_t len = readUInt16LE(it + 4);
+    if (::strncmp(it, "LTIM", 4) == 0) {
+      const auto data = it + 8;
+      const QByteArray timer = QByteArray::fromRawData(
+          data, static_cast<int>(std::min<ptrdiff_t>(len, end - data)));
+      summary.seconds = timer.left(timer.indexOf(',')).toULongLong();
+      break;
+    }
+    // Skip the header, the data and the null terminator.
+    it += std::min<ptrdiff_t>(8 + len + 1, end - it);
+  }
+  return true;
+}
+
+bool Puzzle::repairChecksums(QByteArray &puzFile) {
+  if (puzFile.size() < 0x34) {
+    return false;
+  }
+  uint8_t width = puzFile[0x2c];
+  uint8_t height = puzFile[0x2d];
+  if (puzFile.size() < 0x34 + 2 * (width * height)) {
+    return false;
+  }
+
+  uint16_t numClues = readUInt16LE(puzFile.cbegin() + 0x2e);
+  PuzzleType puzzleType = PuzzleType(readUInt16LE(puzFile.cbegin() + 0x30));
+  SolutionState solutionState =
+      SolutionState(readUInt16LE(puzFile.cbegin() + 0x32));
+
+  // Detach before taking views, so that writing the checksums below doesn't
+  // move the data out from under them.
+  const char *bytes = puzFile.data();
+  const int textStart = 0x34 + 2 * width * height;
+  const auto solution = viewGrid(bytes + 0x34, height, width);
+  const auto grid = viewGrid(bytes + 0x34 + width * height, height, width);
+  const QByteArray text =
+      QByteArray::fromRawData(bytes + textStart, puzFile.size() - textStart);
+
+  writeUInt16LE(puzFile.begin() + 0x0e, headerChecksum(width, height, numClues,
+                                                       puzzleType,
+                                                       solutionState));
+  writeUInt64LE(puzFile.begin() + 0x10,
+                magicChecksum(width, height, numClues, puzzleType,
+                              solutionState, solution, grid, text));
+  writeUInt16LE(puzFile.begin(),
+                globalChecksum(width, height, numClues, puzzleType,
+                               solutionState, solution, grid, text));
   return true;
 }
 
 std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
+  CYGNUS_TRACE_SPAN("Puzzle::loadFromFile");
   if (!validatePuzzle(puzFile)) {
     qCritical() << "Failed to validate puzzle";
     return nullptr;
@@ -274,94 +421,88 @@ std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
 
   uint8_t width = puzFile[0x2c];
   uint8_t height = puzFile[0x2d];
-  uint16_t numClues = readUInt16LE(puzFile.begin() + 0x2e);
-  (void)numClues;
-  PuzzleType puzzleType = PuzzleType(readUInt16LE(puzFile.begin() + 0x30));
-  SolutionState solutionState =
-      SolutionState(readUInt16LE(puzFile.begin() + 0x32));
+
+  // Every grid is allocated at once, and filled in place.
+  std::unique_ptr<Puzzle> puzzle(new Puzzle(height, width));
+  puzzle->puzzleType_ = PuzzleType(readUInt16LE(puzFile.begin() + 0x30));
+  puzzle->solutionState_ = SolutionState(readUInt16LE(puzFile.begin() + 0x32));
+  std::copy_n(puzFile.begin() + 0x18, puzzle->version_.size(),
+              puzzle->version_.begin());
 
   auto it = puzFile.begin() + 0x34;
-  auto solution = readGrid<char>(it, height, width);
-  auto grid = readGrid<char>(it, height, width);
+  readGrid(it, puzzle->solution_);
+  readGrid(it, puzzle->grid_);
+  const Grid<char> &grid = puzzle->grid_;
+  Grid<CellData> &data = puzzle->data_;
 
   qDebug() << "Text start offset:" << (it - puzFile.begin());
   const auto textStart = it;
-  QString title = readString(it);
-  QString author = readString(it);
-  QString copyright = readString(it);
-
-  uint32_t num = 1;
-  std::vector<Clue> across{};
-  std::vector<Clue> down{};
-  Grid<CellData> data{};
-  data.reserve(height);
-
-  uint32_t acrossIdx = 0;
-  uint32_t downIdx = 0;
-
+  const auto fileEnd = puzFile.end();
+  puzzle->title_ = readSpan(it, textStart, fileEnd);
+  puzzle->author_ = readSpan(it, textStart, fileEnd);
+  puzzle->copyright_ = readSpan(it, textStart, fileEnd);
+
+  // Find where clues start first, so that the clue lists are allocated once.
+  size_t acrossCount = 0;
+  size_t downCount = 0;
   for (uint8_t r = 0; r < height; ++r) {
-    std::vector<CellData> dataRow{};
-    dataRow.reserve(width);
     for (uint8_t c = 0; c < width; ++c) {
       if (grid[r][c] == BLACK) {
-        dataRow.emplace_back();
         continue;
       }
       // For a clue to begin, the preceding square must be either a boundary or
       // black, and the next square must not be.
-      bool acrossStart = (c == 0 || grid[r][c - 1] == BLACK) &&
+      CellData &cell = data[r][c];
+      cell.acrossStart = (c == 0 || grid[r][c - 1] == BLACK) &&
                          (c < width - 1 && grid[r][c + 1] != BLACK);
-      bool downStart = (r == 0 || grid[r - 1][c] == BLACK) &&
+      cell.downStart = (r == 0 || grid[r - 1][c] == BLACK) &&
                        (r < height - 1 && grid[r + 1][c] != BLACK);
-      if (acrossStart || downStart) {
-        CellData data{};
-        if (acrossStart) {
-          Clue clue{readString(it), r, c, num, Direction::ACROSS};
-          across.emplace_back(std::move(clue));
-          data.acrossNum = num;
-          data.acrossStart = true;
-          data.acrossIdx = acrossIdx++;
-        }
-        if (downStart) {
-          Clue clue{readString(it), r, c, num, Direction::DOWN};
-          down.push_back(std::move(clue));
-          data.downNum = num;
-          data.downStart = true;
-          data.downIdx = downIdx++;
-        }
-        dataRow.push_back(data);
-        ++num;
-      } else {
-        dataRow.emplace_back();
+      acrossCount += cell.acrossStart;
+      downCount += cell.downStart;
+    }
+  }
+
+  std::vector<Clue> &across = puzzle->clues_[size_t(Direction::ACROSS)];
+  std::vector<Clue> &down = puzzle->clues_[size_t(Direction::DOWN)];
+  across.reserve(acrossCount);
+  down.reserve(downCount);
+
+  // Clues are stored in order of their number, across before down.
+  uint16_t num = 1;
+  for (uint8_t r = 0; r < height; ++r) {
+    for (uint8_t c = 0; c < width; ++c) {
+      CellData &cell = data[r][c];
+      if (!cell.acrossStart && !cell.downStart) {
+        continue;
+      }
+      if (cell.acrossStart) {
+        cell.acrossNum = num;
+        cell.acrossIdx = static_cast<uint16_t>(across.size());
+        across.push_back(Clue{readSpan(it, textStart, fileEnd), r, c, num,
+                              Direction::ACROSS});
+      }
+      if (cell.downStart) {
+        cell.downNum = num;
+        cell.downIdx = static_cast<uint16_t>(down.size());
+        down.push_back(
+            Clue{readSpan(it, textStart, fileEnd), r, c, num, Direction::DOWN});
       }
+      ++num;
     }
-    data.push_back(dataRow);
   }
 
-  QString note{readString(it)};
+  puzzle->note_ = readSpan(it, textStart, fileEnd);
 
   qDebug() << "Text end offset:" << (it - puzFile.begin());
-  const auto textEnd = it;
+  // The text section is a view of the shared file, rather than a copy.
+  puzzle->file_ = puzFile;
+  puzzle->text_ = QByteArray::fromRawData(
+      puzzle->file_.constData() + (textStart - puzFile.begin()),
+      static_cast<int>(it - textStart));
 
-  Grid<Markup> markup{};
-  markup.resize(height);
-  for (uint8_t i = 0; i < height; ++i) {
-    markup[i].resize(width);
-    std::fill(markup[i].begin(), markup[i].end(), Puzzle::DefaultTag);
-  }
-
-  Timer timer{};
+  Timer &timer = puzzle->timer_;
   timer.running = true;
 
-  Grid<QString> rebusFill{};
-  for (uint32_t r = 0; r < height; ++r) {
-    std::vector<QString> row;
-    for (uint32_t c = 0; c < width; ++c) {
-      row.push_back("");
-    }
-    rebusFill.push_back(std::move(row));
-  }
-
   // Try and read extensions.
   while (it < puzFile.end() - 8) {
     qDebug() << "Attempting to read extension at" << (it - puzFile.begin());
@@ -376,7 +517,11 @@ std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
       uint16_t cksum = readUInt16LE(it);
       (void)cksum;
       it += 2;
-      markup = readGrid<Markup>(it, height, width);
+      if (puzFile.end() - it < width * height) {
+        qDebug() << "Truncated markup";
+        break;
+      }
+      readGrid(it, puzzle->markup_);
       qDebug() << "Read extension:    Markup";
       // Account for the NUL character.
       ++it;
@@ -389,7 +534,7 @@ std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
       // TODO: Check checksum here.
       (void)cksum;
       it += 2;
-      QString timerString = readString(it);
+      QString timerString = readString(it, puzFile.end());
       if (timerString.size() != len) {
         qDebug() << "Invalid length";
         return nullptr;
@@ -415,20 +560,21 @@ std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
       qDebug() << "Reading extension: Rebus Fill";
       it += 4;
       uint16_t len = readUInt16LE(it);
-      (void)len;
       it += 2;
       uint16_t cksum = readUInt16LE(it);
       // TODO: Check checksum.
       (void)cksum;
       it += 2;
-      for (uint32_t r = 0; r < height; ++r) {
-        for (uint32_t c = 0; c < width; ++c) {
-          rebusFill[r][c] = readString(it);
-        }
+      if (puzFile.end() - it <= len) {
+        qDebug() << "Truncated rebus fill";
+        break;
       }
-      // Null terminator.
-      ++it;
-      qDebug() << "Read extension:    Rebus Fill";
+      // Only locate the entries, they are decoded on first use.
+      puzzle->rebusStart_ = static_cast<int>(it - puzFile.begin());
+      puzzle->rebusEnd_ = puzzle->rebusStart_ + len;
+      // Skip the entries and the null terminator.
+      it += len + 1;
+      qDebug() << "Found extension:   Rebus Fill";
     } else {
       qDebug() << "Unable to read extension";
       it += 4;
@@ -447,8 +593,8 @@ std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
   }
 
   // Perform post-processing on the cellData.
-  uint32_t curNum = 0;
-  uint32_t curIdx = 0;
+  uint16_t curNum = 0;
+  uint16_t curIdx = 0;
   for (uint8_t r = 0; r < height; ++r) {
     for (uint8_t c = 0; c < width; ++c) {
       if (data[r][c].acrossStart) {
@@ -473,29 +619,58 @@ std::unique_ptr<Puzzle> Puzzle::loadFromFile(const QByteArray &puzFile) {
     }
   }
 
-  std::vector<Clue> clues[2]{across, down};
-  QByteArray version = puzFile.mid(0x18, 4);
-  return std::unique_ptr<Puzzle>(
-      new Puzzle(version, height, width, puzzleType, solutionState, clues,
-                 std::move(note), solution, grid, data,
-                 puzFile.mid(textStart - puzFile.begin(), textEnd - textStart),
-                 markup, timer, rebusFill));
+  return puzzle;
 }
 
-Puzzle::Puzzle(QByteArray version, uint8_t height, uint8_t width,
-               PuzzleType puzzleType, SolutionState solutionState,
-               std::vector<Clue> clues[2], QString note, Grid<char> solution,
-               Grid<char> grid, Grid<CellData> data, QByteArray text,
-               Grid<Markup> markup, Timer timer, Grid<QString> rebusFill)
-    : version_(version), height_(height), width_(width),
-      puzzleType_(puzzleType),
-      solutionState_(solutionState), clues_{clues[0], clues[1]}, note_(note),
-      solution_(solution), grid_(grid), data_(data), text_(text),
-      markup_(markup), timer_(timer), rebusFill_(rebusFill) {
-  QByteArray::const_iterator it = text.begin();
-  title_ = readString(it);
-  author_ = readString(it);
-  copyright_ = readString(it);
+Puzzle::Puzzle(uint8_t height, uint8_t width)
+    : height_(height), width_(width), puzzleType_(PuzzleType::NORMAL),
+      solutionState_(SolutionState::UNLOCKED),
+      cellsSize_(size_t(height) * width * (sizeof(CellData) + 3)),
+      cells_(new char[cellsSize_]), rebusFill_(width) {
+  const size_t cells = size_t(height) * width;
+  auto *data = reinterpret_cast<CellData *>(cells_.get());
+  std::uninitialized_fill_n(data, cells, CellData{});
+  char *solution = cells_.get() + cells * sizeof(CellData);
+  char *grid = solution + cells;
+  auto *markup = reinterpret_cast<Markup *>(grid + cells);
+  std::fill_n(solution, 2 * cells, EMPTY);
+  std::fill_n(markup, cells, DefaultTag);
+
+  data_ = Grid<CellData>::view(data, height, width);
+  solution_ = Grid<char>::view(solution, height, width);
+  grid_ = Grid<char>::view(grid, height, width);
+  markup_ = Grid<Markup>::view(markup, height, width);
+}
+
+void Puzzle::decodeRebusFill() const {
+  if (rebusStart_ < 0) {
+    return;
+  }
+  CYGNUS_TRACE_SPAN("Puzzle::decodeRebusFill");
+  auto it = file_.begin() + rebusStart_;
+  const auto end = file_.begin() + rebusEnd_;
+  for (uint8_t r = 0; r < height_; ++r) {
+    for (uint8_t c = 0; c < width_; ++c) {
+      // Most cells have no entry, so only decode the ones which do.
+      const auto first = it;
+      const uint32_t length = skipString(it, end);
+      if (length > 0) {
+        rebusFill_.set(r, c,
+                       QString::fromLatin1(first, static_cast<int>(length)));
+      }
+    }
+  }
+  rebusStart_ = -1;
+}
+
+MemoryUsage Puzzle::memoryUsage() const {
+  MemoryUsage usage{};
+  usage.add("puzzle.object", sizeof(Puzzle));
+  usage.add("puzzle.grids", cellsSize_);
+  usage.add("puzzle.rebus", rebusFill_.memoryUsage());
+  usage.add("puzzle.clues", heapBytes(clues_[0]) + heapBytes(clues_[1]));
+  usage.add("puzzle.file", heapBytes(file_));
+  return usage;
 }
 
 int Puzzle::getClueIdxByNum(Direction dir, uint32_t num) const {
@@ -505,7 +680,7 @@ int Puzzle::getClueIdxByNum(Direction dir, uint32_t num) const {
 
   Clue clue{};
   clue.num = num;
-  auto clues = clues_[static_cast<int>(dir)];
+  const auto &clues = clues_[static_cast<int>(dir)];
   auto result =
       std::lower_bound(clues.begin(), clues.end(), clue, compareForNum);
   if (result == clues.end()) {
@@ -530,6 +705,21 @@ std::pair<uint32_t, uint32_t> Puzzle::getClueEnd(const Clue &clue) const {
   }
 }
 
+QByteArray Puzzle::getAnswer(const Clue &clue) const {
+  QByteArray answer{};
+  uint32_t r = clue.row;
+  uint32_t c = clue.col;
+  while (r < height_ && c < width_ && getSolution()[r][c] != BLACK) {
+    answer += getSolution()[r][c];
+    if (clue.dir == Direction::ACROSS) {
+      ++c;
+    } else {
+      ++r;
+    }
+  }
+  return answer;
+}
+
 /// \return the first blank space in this clue, and return the start of the
 /// clue if there are none.
 std::pair<uint32_t, uint32_t> Puzzle::getFirstBlank(const Clue &clue) const {
@@ -551,7 +741,89 @@ std::pair<uint32_t, uint32_t> Puzzle::getFirstBlank(const Clue &clue) const {
   return {clue.row, clue.col};
 }
 
+int Puzzle::Transaction::find(uint8_t row, uint8_t col) const {
+  if (index_.empty()) {
+    for (size_t i = 0; i < changes_.size(); ++i) {
+      if (changes_[i].row == row && changes_[i].col == col) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+  auto it = index_.find(key(row, col));
+  return it == index_.end() ? -1 : static_cast<int>(it->second);
+}
+
+Puzzle::CellChange &Puzzle::Transaction::change(uint8_t row, uint8_t col) {
+  int idx = find(row, col);
+  if (idx >= 0) {
+    return changes_[idx];
+  }
+
+  const char cell = puzzle_.grid_[row][col];
+  const Markup markup = puzzle_.markup_[row][col];
+  const QString &rebus = puzzle_.getRebusFill().get(row, col);
+  changes_.push_back(
+      CellChange{row, col, cell, markup, rebus, cell, markup, rebus});
+
+  if (changes_.size() == kLinearLimit) {
+    for (size_t i = 0; i < changes_.size(); ++i) {
+      index_.emplace(key(changes_[i].row, changes_[i].col), i);
+    }
+  } else if (changes_.size() > kLinearLimit) {
+    index_.emplace(key(row, col), changes_.size() - 1);
+  }
+  return changes_.back();
+}
+
+char Puzzle::Transaction::getCell(uint8_t row, uint8_t col) const {
+  int idx = find(row, col);
+  return idx >= 0 ? changes_[idx].cell : puzzle_.grid_[row][col];
+}
+
+Puzzle::Markup Puzzle::Transaction::getMarkup(uint8_t row, uint8_t col) const {
+  int idx = find(row, col);
+  return idx >= 0 ? changes_[idx].markup : puzzle_.markup_[row][col];
+}
+
+void Puzzle::Transaction::setCell(uint8_t row, uint8_t col, char cell,
+                                  const QString &rebus) {
+  CellChange &edit = change(row, col);
+  edit.cell = cell;
+  edit.rebus = RebusFill::isRebus(rebus) ? rebus : QString{};
+}
+
+void Puzzle::Transaction::setMarkup(uint8_t row, uint8_t col, Markup markup) {
+  change(row, col).markup = markup;
+}
+
+Puzzle::ChangeSet Puzzle::Transaction::commit() {
+  puzzle_.decodeRebusFill();
+  ChangeSet result{};
+  result.reserve(changes_.size());
+  for (auto &edit : changes_) {
+    if (edit.cell == edit.oldCell && edit.markup == edit.oldMarkup &&
+        edit.rebus == edit.oldRebus) {
+      continue;
+    }
+    puzzle_.grid_[edit.row][edit.col] = edit.cell;
+    puzzle_.markup_[edit.row][edit.col] = edit.markup;
+    puzzle_.rebusFill_.set(edit.row, edit.col, edit.rebus);
+    result.push_back(std::move(edit));
+  }
+  changes_.clear();
+  index_.clear();
+  return result;
+}
+
+QByteArray Puzzle::serializeExtension(const QByteArray &extTag,
+                                      const QByteArray &data) {
+  return extTag + makeUInt16LE(data.size()) +
+         makeUInt16LE(checksum(data.begin(), data.end())) + data + '\0';
+}
+
 QByteArray Puzzle::serialize() const {
+  CYGNUS_TRACE_SPAN("Puzzle::serialize");
   QByteArray result(0x34 + (2 * static_cast<uint16_t>(width_) *
                             static_cast<uint16_t>(height_)),
                     '\0');
@@ -566,7 +838,7 @@ QByteArray Puzzle::serialize() const {
   writeUInt64LE(result.begin() + 0x10,
                 magicChecksum(width_, height_, getNumClues(), puzzleType_,
                               solutionState_, solution_, grid_, text_));
-  result.replace(0x18, version_.size(), version_);
+  std::copy(version_.begin(), version_.end(), result.begin() + 0x18);
 
   result[0x2c] = width_;
   result[0x2d] = height_;
@@ -579,12 +851,6 @@ QByteArray Puzzle::serialize() const {
 
   result += text_;
 
-  auto serializeExtension = [](const QByteArray &extTag,
-                               const QByteArray &data) {
-    return extTag + makeUInt16LE(data.size()) +
-           makeUInt16LE(checksum(data.begin(), data.end())) + data + '\0';
-  };
-
   // Serialize markup.
   QByteArray markupString{width_ * height_, '\0'};
   writeGrid(markupString.begin(), markup_);
@@ -598,22 +864,226 @@ QByteArray Puzzle::serialize() const {
   result += serializeExtension(QByteArray("LTIM", 4), timeString);
 
   // Serialize rebus fill.
-  bool serializeRebusFill = false;
+  const QByteArray rebusFillString = rebusData();
+  if (!rebusFillString.isEmpty()) {
+    result += serializeExtension(QByteArray("RUSR", 4), rebusFillString);
+  }
+
+  return result;
+}
+
+QByteArray Puzzle::rebusData() const {
+  decodeRebusFill();
   QByteArray rebusFillString{};
-  for (const auto &row : rebusFill_) {
-    for (const auto &s : row) {
-      if (s.size() > 1 || (s.size() == 1 && s.at(0).isDigit())) {
-        rebusFillString.append(s);
-        serializeRebusFill = true;
-      }
+  if (rebusFill_.empty()) {
+    return rebusFillString;
+  }
+  rebusFillString.reserve(width_ * height_ + 4 * rebusFill_.size());
+  for (uint8_t r = 0; r < height_; ++r) {
+    for (uint8_t c = 0; c < width_; ++c) {
+      rebusFillString.append(rebusFill_.get(r, c));
       rebusFillString.append('\0');
     }
   }
-  if (serializeRebusFill) {
-    result += serializeExtension(QByteArray("RUSR", 4), rebusFillString);
-  }
+  return rebusFillString;
+}
+
+const static char SNAPSHOT_MAGIC[8] = "CYGSNAP";
+
+/// Increment whenever the layout of a snapshot, or of the structs it copies
+/// verbatim, changes.
+const static uint32_t SNAPSHOT_FORMAT = 2;
+
+// Clues and cell data are copied verbatim, so their layout is part of the
+// format.
+static_assert(sizeof(Clue) == 16, "Clue layout changed, see SNAPSHOT_FORMAT");
+static_assert(sizeof(Puzzle::CellData) == 10,
+              "CellData layout changed, see SNAPSHOT_FORMAT");
+
+namespace {
+
+/// Start of a snapshot, followed by the cell block, the clues, the text
+/// section and the rebus entries, each at an offset aligned to 8 bytes.
+/// Snapshots are only read by the build that wrote them, so every field is
+/// in native byte order.
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t format;
+  uint16_t headerSize;
+  uint16_t cellDataSize;
+  uint16_t clueSize;
+  uint16_t byteOrder;
+  uint8_t height;
+  uint8_t width;
+  uint16_t puzzleType;
+  uint16_t solutionState;
+  char version[4];
+  uint8_t timerRunning;
+  uint64_t timerCurrent;
+  TextSpan title;
+  TextSpan author;
+  TextSpan copyright;
+  TextSpan note;
+  uint32_t cluesCount[2];
+  uint32_t cellsOffset;
+  uint32_t cluesOffset;
+  uint32_t textOffset;
+  uint32_t textSize;
+  uint32_t rebusOffset;
+  uint32_t rebusSize;
+};
+
+} // namespace
+
+static inline uint32_t align8(uint32_t offset) { return (offset + 7) & ~7u; }
+
+/// \return true if [\p offset, \p offset + \p size) lies in [0, \p limit).
+static inline bool inBounds(uint64_t offset, uint64_t size, uint64_t limit) {
+  return offset <= limit && size <= limit - offset;
+}
+
+/// \return true if \p span lies within a text section of \p size bytes.
+static inline bool inBounds(TextSpan span, uint32_t size) {
+  return inBounds(span.offset, span.length, size);
+}
 
+QByteArray Puzzle::snapshot() const {
+  CYGNUS_TRACE_SPAN("Puzzle::snapshot");
+  const QByteArray rebus = rebusData();
+
+  SnapshotHeader header{};
+  std::copy_n(SNAPSHOT_MAGIC, sizeof(header.magic), header.magic);
+  header.format = SNAPSHOT_FORMAT;
+  header.headerSize = sizeof(SnapshotHeader);
+  header.cellDataSize = sizeof(CellData);
+  header.clueSize = sizeof(Clue);
+  header.byteOrder = 0x0102;
+  header.height = height_;
+  header.width = width_;
+  header.puzzleType = uint16_t(puzzleType_);
+  header.solutionState = uint16_t(solutionState_);
+  std::copy(version_.begin(), version_.end(), header.version);
+  header.timerRunning = timer_.running;
+  header.timerCurrent = timer_.current;
+  header.title = title_;
+  header.author = author_;
+  header.copyright = copyright_;
+  header.note = note_;
+  header.cluesCount[0] = static_cast<uint32_t>(clues_[0].size());
+  header.cluesCount[1] = static_cast<uint32_t>(clues_[1].size());
+
+  const uint32_t cluesSize =
+      (header.cluesCount[0] + header.cluesCount[1]) * sizeof(Clue);
+  header.cellsOffset = align8(sizeof(SnapshotHeader));
+  header.cluesOffset = align8(header.cellsOffset + cellsSize_);
+  header.textOffset = align8(header.cluesOffset + cluesSize);
+  header.textSize = static_cast<uint32_t>(text_.size());
+  header.rebusOffset = align8(header.textOffset + header.textSize);
+  header.rebusSize = static_cast<uint32_t>(rebus.size());
+
+  QByteArray result(header.rebusOffset + header.rebusSize, '\0');
+  char *out = result.data();
+  std::memcpy(out, &header, sizeof(header));
+  std::memcpy(out + header.cellsOffset, cells_.get(), cellsSize_);
+  char *clues = out + header.cluesOffset;
+  for (const auto &list : clues_) {
+    std::memcpy(clues, list.data(), list.size() * sizeof(Clue));
+    clues += list.size() * sizeof(Clue);
+  }
+  std::memcpy(out + header.textOffset, text_.constData(), header.textSize);
+  std::memcpy(out + header.rebusOffset, rebus.constData(), header.rebusSize);
   return result;
 }
 
+std::unique_ptr<Puzzle> Puzzle::fromSnapshot(const QByteArray &snapshot) {
+  CYGNUS_TRACE_SPAN("Puzzle::fromSnapshot");
+  SnapshotHeader header;
+  if (static_cast<size_t>(snapshot.size()) < sizeof(header)) {
+    qWarning() << "Snapshot is truncated";
+    return nullptr;
+  }
+  std::memcpy(&header, snapshot.constData(), sizeof(header));
+  if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.format != SNAPSHOT_FORMAT ||
+      header.headerSize != sizeof(SnapshotHeader) ||
+      header.cellDataSize != sizeof(CellData) ||
+      header.clueSize != sizeof(Clue) || header.byteOrder != 0x0102) {
+    qDebug() << "Snapshot was written by an incompatible build";
+    return nullptr;
+  }
+
+  // Check every offset before copying anything, so that a corrupt snapshot
+  // is rejected rather than read out of bounds.
+  const uint64_t size = static_cast<uint64_t>(snapshot.size());
+  const uint64_t cellsSize =
+      uint64_t(header.height) * header.width * (sizeof(CellData) + 3);
+  const uint64_t cluesSize =
+      (uint64_t(header.cluesCount[0]) + header.cluesCount[1]) * sizeof(Clue);
+  if (!inBounds(header.cellsOffset, cellsSize, size) ||
+      !inBounds(header.cluesOffset, cluesSize, size) ||
+      !inBounds(header.textOffset, header.textSize, size) ||
+      !inBounds(header.rebusOffset, header.rebusSize, size) ||
+      !inBounds(header.title, header.textSize) ||
+      !inBounds(header.author, header.textSize) ||
+      !inBounds(header.copyright, header.textSize) ||
+      !inBounds(header.note, header.textSize)) {
+    qWarning() << "Snapshot is corrupt";
+    return nullptr;
+  }
+
+  std::unique_ptr<Puzzle> puzzle(new Puzzle(header.height, header.width));
+  puzzle->puzzleType_ = PuzzleType(header.puzzleType);
+  puzzle->solutionState_ = SolutionState(header.solutionState);
+  std::copy_n(header.version, puzzle->version_.size(),
+              puzzle->version_.begin());
+  puzzle->timer_.current = header.timerCurrent;
+  puzzle->timer_.running = header.timerRunning != 0;
+  puzzle->title_ = header.title;
+  puzzle->author_ = header.author;
+  puzzle->copyright_ = header.copyright;
+  puzzle->note_ = header.note;
+
+  const char *bytes = snapshot.constData();
+  std::memcpy(puzzle->cells_.get(), bytes + header.cellsOffset, cellsSize);
+  const char *clues = bytes + header.cluesOffset;
+  for (size_t dir = 0; dir < 2; ++dir) {
+    auto &list = puzzle->clues_[dir];
+    list.resize(header.cluesCount[dir]);
+    std::memcpy(list.data(), clues, list.size() * sizeof(Clue));
+    clues += list.size() * sizeof(Clue);
+    for (const Clue &clue : list) {
+      if (!inBounds(clue.text, header.textSize) || clue.row >= header.height ||
+          clue.col >= header.width) {
+        qWarning() << "Snapshot is corrupt";
+        return nullptr;
+      }
+    }
+  }
+  // Clue indices in the cell data are used without checks.
+  for (const CellData &cell : puzzle->data_) {
+    if ((cell.acrossIdx > 0 && cell.acrossIdx >= header.cluesCount[0]) ||
+        (cell.downIdx > 0 && cell.downIdx >= header.cluesCount[1])) {
+      qWarning() << "Snapshot is corrupt";
+      return nullptr;
+    }
+  }
+
+  // The text and rebus entries are copied out, rather than referring into
+  // the snapshot, so that a mapped snapshot file is released straight away
+  // and can be replaced when the puzzle is saved. They are still only decoded
+  // on first use, like those in the file read by loadFromFile().
+  puzzle->file_.reserve(static_cast<int>(header.textSize + header.rebusSize));
+  puzzle->file_.append(bytes + header.textOffset,
+                       static_cast<int>(header.textSize));
+  puzzle->file_.append(bytes + header.rebusOffset,
+                       static_cast<int>(header.rebusSize));
+  puzzle->text_ = QByteArray::fromRawData(puzzle->file_.constData(),
+                                          static_cast<int>(header.textSize));
+  if (header.rebusSize > 0) {
+    puzzle->rebusStart_ = static_cast<int>(header.textSize);
+    puzzle->rebusEnd_ = puzzle->file_.size();
+  }
+  return puzzle;
+}
+
 } // namespace cygnus
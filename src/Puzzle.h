@@ -1,11 +1,17 @@
 #ifndef PUZZLE_H
 #define PUZZLE_H
 
+#include "Grid.h"
+#include "MemoryUsage.h"
+#include "RebusFill.h"
+
 #include <QByteArray>
 #include <QDebug>
 #include <QString>
 
+#include <array>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -14,7 +20,7 @@ namespace cygnus {
 const char BLACK = '.';
 const char EMPTY = '-';
 
-enum class Direction {
+enum class Direction : uint8_t {
   ACROSS,
   DOWN,
 };
@@ -23,25 +29,30 @@ inline Direction flip(Direction dir) {
   return (dir == Direction::ACROSS) ? Direction::DOWN : Direction::ACROSS;
 }
 
+/// A string in the text section of a puzzle, stored as Latin-1.
+struct TextSpan {
+  /// Offset from the start of the text section.
+  uint32_t offset;
+  uint32_t length;
+};
+
 struct Clue {
-  QString clue;
-  uint32_t row;
-  uint32_t col;
-  uint32_t num;
+  /// Text of the clue, see Puzzle::getClueText().
+  TextSpan text;
+  uint8_t row;
+  uint8_t col;
+  uint16_t num;
   Direction dir;
 };
 
-template <typename T> using Grid = std::vector<std::vector<T>>;
-
 class Puzzle {
 public:
   struct CellData {
-    uint32_t acrossNum{0};
-    uint32_t acrossIdx{0};
+    uint16_t acrossNum{0};
+    uint16_t acrossIdx{0};
+    uint16_t downNum{0};
+    uint16_t downIdx{0};
     bool acrossStart{false};
-
-    uint32_t downNum{0};
-    uint32_t downIdx{0};
     bool downStart{false};
   };
 
@@ -67,56 +78,197 @@ public:
     bool running{false};
   };
 
+  /// A modification of a single cell, made through a Transaction.
+  struct CellChange {
+    uint8_t row;
+    uint8_t col;
+
+    char oldCell;
+    Markup oldMarkup;
+    QString oldRebus;
+
+    char cell;
+    Markup markup;
+    QString rebus;
+  };
+  using ChangeSet = std::vector<CellChange>;
+
+  /// Collects edits to the cells of a puzzle and applies them in one pass.
+  /// The puzzle is not modified until commit() is called, but the getters
+  /// reflect the uncommitted edits.
+  class Transaction {
+  public:
+    explicit Transaction(Puzzle &puzzle) : puzzle_(puzzle) {}
+
+    /// \return the contents of the cell at (\p row, \p col).
+    char getCell(uint8_t row, uint8_t col) const;
+    /// \return the markup of the cell at (\p row, \p col).
+    Markup getMarkup(uint8_t row, uint8_t col) const;
+
+    /// Set the contents of the cell at (\p row, \p col) to \p cell,
+    /// with the full text of the entry in \p rebus if it is a rebus entry.
+    void setCell(uint8_t row, uint8_t col, char cell,
+                 const QString &rebus = QString{});
+    void setMarkup(uint8_t row, uint8_t col, Markup markup);
+
+    inline bool empty() const { return changes_.empty(); }
+
+    /// Apply every edit to the puzzle and reset the transaction.
+    /// \return the cells which were modified, in the order they were first
+    /// edited. Edits which left a cell unchanged are dropped.
+    ChangeSet commit();
+
+  private:
+    /// Transactions with more edits than this index them in a hash table,
+    /// smaller ones are searched linearly.
+    static constexpr size_t kLinearLimit = 16;
+
+    /// \return the index of the edit to (\p row, \p col), or -1.
+    int find(uint8_t row, uint8_t col) const;
+
+    /// \return the edit to (\p row, \p col), creating it if necessary.
+    CellChange &change(uint8_t row, uint8_t col);
+
+    inline uint32_t key(uint8_t row, uint8_t col) const {
+      return row * puzzle_.width_ + col;
+    }
+
+    Puzzle &puzzle_;
+    ChangeSet changes_{};
+    std::unordered_map<uint32_t, size_t> index_{};
+  };
+
 private:
-  Puzzle(QByteArray version, uint8_t height, uint8_t width,
-         PuzzleType puzzleType, SolutionState solutionState,
-         std::vector<Clue> clues[2], QString note, Grid<char> solution,
-         Grid<char> grid, Grid<CellData> data, QByteArray text,
-         Grid<Markup> markup, Timer timer, Grid<QString> rebusFill);
-  QByteArray version_;
+  /// Allocate the grids of a \p height x \p width puzzle, with every cell
+  /// empty and without markup.
+  Puzzle(uint8_t height, uint8_t width);
+
+  std::array<char, 4> version_{};
 
   uint8_t height_;
   uint8_t width_;
   PuzzleType puzzleType_;
   SolutionState solutionState_;
   std::vector<Clue> clues_[2];
-  QString note_;
+
+  /// Single allocation holding the cells of every grid below, which are
+  /// views into it: the cell data first for alignment, then the solution,
+  /// the grid and the markup.
+  size_t cellsSize_;
+  std::unique_ptr<char[]> cells_;
+
   Grid<char> solution_;
   Grid<char> grid_;
   Grid<CellData> data_;
+  /// The file the puzzle was loaded from, shared with the caller rather than
+  /// copied, or the text and rebus sections of its snapshot. Parts of it are
+  /// only decoded when they are first requested.
+  QByteArray file_;
+  /// Raw text section of file_, which every string in the puzzle refers
+  /// into. Strings are only decoded when they are requested.
   QByteArray text_;
   Grid<Markup> markup_;
   Timer timer_;
-  Grid<QString> rebusFill_{};
 
-  QString title_;
-  QString author_;
-  QString copyright_;
+  /// Rebus entries, decoded from the RUSR extension of file_ on first use.
+  /// While rebusStart_ is non-negative, the extension has not been decoded
+  /// yet and spans [rebusStart_, rebusEnd_) of file_.
+  mutable RebusFill rebusFill_{};
+  mutable int rebusStart_{-1};
+  int rebusEnd_{-1};
+
+  /// Decode the rebus entries if they haven't been decoded yet.
+  void decodeRebusFill() const;
+
+  /// \return the contents of the RUSR extension, empty if there are no rebus
+  /// entries.
+  QByteArray rebusData() const;
+
+  TextSpan title_{};
+  TextSpan author_{};
+  TextSpan copyright_{};
+  TextSpan note_{};
+
+  /// \return the string stored at \p span.
+  inline QString getText(TextSpan span) const {
+    return QString::fromLatin1(text_.constData() + span.offset,
+                               static_cast<int>(span.length));
+  }
 
 public:
+  /// \return the puzzle in \p puzFile, or nullptr if it isn't valid.
+  /// Only the header, the grids, the clue positions and the markup and timer
+  /// are parsed, which is enough to show the puzzle. Text and the rebus
+  /// entries are decoded from \p puzFile when they are first requested, so
+  /// the puzzle keeps a shallow copy of it.
   static std::unique_ptr<Puzzle> loadFromFile(const QByteArray &puzFile);
 
+  /// Metadata of a puzzle file, read without loading the puzzle.
+  struct Summary {
+    QString title{};
+    QString author{};
+    uint8_t width{0};
+    uint8_t height{0};
+    uint16_t numClues{0};
+    /// Number of white cells, and how many of them are filled in the player
+    /// grid.
+    uint16_t cells{0};
+    uint16_t filled{0};
+    /// Time from the LTIM extension, 0 if there is none.
+    uint64_t seconds{0};
+  };
+
+  /// Read the metadata of \p puzFile into \p summary.
+  /// Only the header is validated, and the clues are skipped without being
+  /// decoded, so this is far cheaper than loadFromFile().
+  /// \return false if \p puzFile doesn't have a valid header.
+  static bool summarize(const QByteArray &puzFile, Summary &summary);
+
+  /// \return a view of the player grid stored in \p puzFile, or an empty
+  /// grid if \p puzFile doesn't have a valid header.
+  /// Like summarize(), only the header is validated.
+  static const Grid<char> viewPlayerGrid(const QByteArray &puzFile);
+
+  /// \return a SHA-1 digest of the dimensions, solution and clues of
+  /// \p puzFile, or an empty array if it doesn't have a valid header.
+  /// The player grid, markup, timer, title and note are left out, so copies
+  /// of a puzzle which were solved to different points, or renamed, share a
+  /// fingerprint. Like summarize(), only the header is validated.
+  static QByteArray fingerprint(const QByteArray &puzFile);
+
   inline uint8_t getHeight() const { return height_; }
   inline uint8_t getWidth() const { return width_; }
   inline const std::vector<Clue> &getClues(Direction dir) const {
     return clues_[static_cast<int>(dir)];
   }
-  inline Grid<char> &getGrid() { return grid_; }
   inline const Grid<char> &getGrid() const { return grid_; }
-  inline Grid<Markup> &getMarkup() { return markup_; }
   inline const Grid<Markup> &getMarkup() const { return markup_; }
   inline const Grid<char> &getSolution() const { return solution_; }
   inline const Grid<CellData> &getCellData() const { return data_; }
-  inline const QString &getNote() const { return note_; }
+  inline QString getNote() const { return getText(note_); }
+  inline bool hasNote() const { return note_.length > 0; }
   inline uint16_t getNumClues() const {
     return static_cast<uint16_t>(clues_[0].size() + clues_[1].size());
   }
-  inline const QString &getTitle() const { return title_; }
-  inline const QString &getAuthor() const { return author_; }
-  inline const QString &getCopyright() const { return copyright_; }
+  inline QString getTitle() const { return getText(title_); }
+  inline QString getAuthor() const { return getText(author_); }
+  inline QString getCopyright() const { return getText(copyright_); }
   inline Timer &getTimer() { return timer_; }
-  inline Grid<QString> &getRebusFill() { return rebusFill_; }
-  inline const Grid<QString> &getRebusFill() const { return rebusFill_; }
+  /// \return the rebus entries, decoding them on first use.
+  /// Not thread safe, like every other getter of a Puzzle.
+  inline const RebusFill &getRebusFill() const {
+    decodeRebusFill();
+    return rebusFill_;
+  }
+
+  /// \return the estimated memory used by the grids, rebus fill, clues and
+  /// file, including the Puzzle object itself.
+  MemoryUsage memoryUsage() const;
+
+  /// \return the text of \p clue, decoded from the text section.
+  inline QString getClueText(const Clue &clue) const {
+    return getText(clue.text);
+  }
 
   /// \return the clue index of clue number \p num in direction \p dir.
   int getClueIdxByNum(Direction dir, uint32_t num) const;
@@ -139,6 +291,10 @@ public:
   /// clue if there are none.
   std::pair<uint32_t, uint32_t> getFirstBlank(const Clue &clue) const;
 
+  /// \return the answer to \p clue, read from the solution.
+  /// Rebus squares only contribute the first letter of their entry.
+  QByteArray getAnswer(const Clue &clue) const;
+
   /// \return true if the grid entry at (row,col) is correct.
   inline bool check(uint8_t row, uint8_t col) const {
     const char solution = getSolution()[row][col];
@@ -156,11 +312,9 @@ public:
 
   /// \return true if every cell has an entry in it.
   inline bool completelyFilled() const {
-    for (const auto &row : grid_) {
-      for (const auto &c : row) {
-        if (c == EMPTY) {
-          return false;
-        }
+    for (const char c : grid_) {
+      if (c == EMPTY) {
+        return false;
       }
     }
     return true;
@@ -188,6 +342,22 @@ public:
 
   QByteArray serialize() const;
 
+  /// \return the fully decoded puzzle, as read by fromSnapshot().
+  /// Unlike serialize(), the grids, the clue numbering and the clues are
+  /// stored as they are laid out in memory.
+  QByteArray snapshot() const;
+
+  /// \return the puzzle stored in \p snapshot by snapshot(), or nullptr if
+  /// it is corrupt or was written by an incompatible build.
+  /// Nothing is validated or numbered again, the puzzle is copied in a few
+  /// blocks, so \p snapshot needn't outlive it and may be a memory mapping.
+  static std::unique_ptr<Puzzle> fromSnapshot(const QByteArray &snapshot);
+
+  /// \return the extension section with tag \p extTag holding \p data,
+  /// including its length and checksum.
+  static QByteArray serializeExtension(const QByteArray &extTag,
+                                       const QByteArray &data);
+
   inline QDebug dumpGrid(QDebug &stream) const {
     for (uint8_t r = 0; r < height_; ++r) {
       QString row;
@@ -199,9 +369,16 @@ public:
     return stream;
   }
 
-private:
+  /// \return true if \p puzFile has a valid header and header checksum.
   static bool validatePuzzle(const QByteArray &puzFile);
 
+  /// Recompute the header, magic and global checksums of \p puzFile and
+  /// write them in place, without parsing the rest of the puzzle.
+  /// \return false if \p puzFile is too short to hold its grids.
+  static bool repairChecksums(QByteArray &puzFile);
+
+  /// Checksums used by the .puz format, see repairChecksums() for where
+  /// each one is stored.
   static uint16_t checksum(const QByteArray::const_iterator start,
                            const QByteArray::const_iterator end,
                            uint16_t seed = 0);
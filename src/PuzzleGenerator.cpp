@@ -0,0 +1,249 @@
+#include "PuzzleGenerator.h"
+#include "Puzzle.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace cygnus {
+
+namespace {
+
+/// Names of each Corruption, in declaration order.
+const char *const kCorruptionNames[] = {
+    "none",  "header-checksum", "global-checksum", "magic-checksum",
+    "magic", "truncated",       "clue-count",      "extension-length",
+};
+
+/// Deterministic random numbers.
+/// std::mt19937 produces the same sequence everywhere, but the standard
+/// distributions don't, so values are derived from its raw output.
+class Random {
+public:
+  explicit Random(uint64_t seed) : engine_(mix(seed)) {}
+
+  /// \return a uniform value in [0, \p n).
+  inline uint32_t below(uint32_t n) {
+    return static_cast<uint32_t>((uint64_t{engine_()} * n) >> 32);
+  }
+
+  /// \return true with probability \p p.
+  inline bool chance(double p) { return engine_() < p * 4294967296.0; }
+
+  inline char letter() { return static_cast<char>('A' + below(26)); }
+
+private:
+  /// Spread nearby seeds across the seed space of the engine.
+  static std::seed_seq::result_type mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return static_cast<std::seed_seq::result_type>(x);
+  }
+
+  std::mt19937 engine_;
+};
+
+void writeUInt16LE(QByteArray &out, int offset, uint16_t x) {
+  out[offset] = static_cast<char>(x & 0xff);
+  out[offset + 1] = static_cast<char>(x >> 8);
+}
+
+QByteArray makeClue(Random &random, uint32_t length) {
+  const uint32_t target = length / 2 + random.below(length + 1);
+  QByteArray clue{};
+  clue.reserve(static_cast<int>(target) + 8);
+  while (static_cast<uint32_t>(clue.size()) < target) {
+    if (!clue.isEmpty()) {
+      clue += ' ';
+    }
+    const uint32_t word = 2 + random.below(7);
+    for (uint32_t i = 0; i < word; ++i) {
+      clue += static_cast<char>(random.letter() | (clue.isEmpty() ? 0 : 32));
+    }
+  }
+  return clue;
+}
+
+} // namespace
+
+QByteArray PuzzleGenerator::generate(const Options &options, uint64_t seed) {
+  Random random{seed};
+  const uint8_t width = std::max<uint8_t>(options.width, 1);
+  const uint8_t height = std::max<uint8_t>(options.height, 1);
+
+  Grid<char> solution(height, width);
+  for (uint8_t r = 0; r < height; ++r) {
+    for (uint8_t c = 0; c < width; ++c) {
+      solution[r][c] = random.letter();
+    }
+  }
+  // Black squares are mirrored through the center, as in most crosswords.
+  const uint32_t cells = width * height;
+  for (uint32_t i = 0; i <= (cells - 1) / 2; ++i) {
+    if (random.chance(options.blackDensity)) {
+      solution[i / width][i % width] = BLACK;
+      const uint32_t mirror = cells - 1 - i;
+      solution[mirror / width][mirror % width] = BLACK;
+    }
+  }
+
+  Grid<char> grid(height, width, EMPTY);
+  Grid<QByteArray> rebus(height, width);
+  const bool useRebus = options.extensions & RUSR;
+  for (uint8_t r = 0; r < height; ++r) {
+    for (uint8_t c = 0; c < width; ++c) {
+      if (solution[r][c] == BLACK) {
+        grid[r][c] = BLACK;
+      } else if (random.chance(options.fillDensity)) {
+        grid[r][c] = solution[r][c];
+        if (useRebus && random.chance(options.rebusDensity)) {
+          rebus[r][c] += solution[r][c];
+          for (uint32_t i = 0, n = 1 + random.below(3); i < n; ++i) {
+            rebus[r][c] += random.letter();
+          }
+        }
+      }
+    }
+  }
+
+  // Clues are stored in order of their number, across before down.
+  QByteArray clues{};
+  uint16_t numClues = 0;
+  for (uint8_t r = 0; r < height; ++r) {
+    for (uint8_t c = 0; c < width; ++c) {
+      if (solution[r][c] == BLACK) {
+        continue;
+      }
+      bool across = (c == 0 || solution[r][c - 1] == BLACK) &&
+                    (c < width - 1 && solution[r][c + 1] != BLACK);
+      bool down = (r == 0 || solution[r - 1][c] == BLACK) &&
+                  (r < height - 1 && solution[r + 1][c] != BLACK);
+      for (bool start : {across, down}) {
+        if (start) {
+          clues += makeClue(random, options.clueLength);
+          clues += '\0';
+          ++numClues;
+        }
+      }
+    }
+  }
+
+  QByteArray file(0x34, '\0');
+  std::memcpy(file.data() + 0x02, "ACROSS&DOWN", 12);
+  std::memcpy(file.data() + 0x18, "1.3", 4);
+  file[0x2c] = static_cast<char>(width);
+  file[0x2d] = static_cast<char>(height);
+  writeUInt16LE(file, 0x2e, numClues);
+  writeUInt16LE(file, 0x30, uint16_t(Puzzle::PuzzleType::NORMAL));
+  writeUInt16LE(file, 0x32, uint16_t(Puzzle::SolutionState::UNLOCKED));
+
+  for (const Grid<char> *g : {&solution, &grid}) {
+    file.append(g->data(), static_cast<int>(g->size()));
+  }
+
+  file += QString("Synthetic %1x%2 #%3")
+              .arg(width)
+              .arg(height)
+              .arg(seed)
+              .toLatin1();
+  file += '\0';
+  file += "cygnus";
+  file += '\0';
+  file += '\0';
+  file += clues;
+  file += QString("Generated from seed %1").arg(seed).toLatin1();
+  file += '\0';
+
+  const int extensionStart = file.size();
+  if (options.extensions & GEXT) {
+    QByteArray markup{};
+    markup.reserve(static_cast<int>(cells));
+    for (uint8_t r = 0; r < height; ++r) {
+      for (uint8_t c = 0; c < width; ++c) {
+        Puzzle::Markup tag = Puzzle::DefaultTag;
+        if (solution[r][c] != BLACK && random.chance(0.05)) {
+          tag |= Puzzle::CircledTag;
+        }
+        if (grid[r][c] != EMPTY && random.chance(0.02)) {
+          tag |= Puzzle::PreviousIncorrectTag;
+        }
+        markup += static_cast<char>(tag);
+      }
+    }
+    file += Puzzle::serializeExtension(QByteArray("GEXT", 4), markup);
+  }
+  if (options.extensions & LTIM) {
+    QByteArray timer = QString("%1,%2")
+                           .arg(random.below(7200))
+                           .arg(random.below(2))
+                           .toLatin1();
+    file += Puzzle::serializeExtension(QByteArray("LTIM", 4), timer);
+  }
+  if (useRebus) {
+    QByteArray rebusFill{};
+    for (const auto &entry : rebus) {
+      rebusFill += entry;
+      rebusFill += '\0';
+    }
+    file += Puzzle::serializeExtension(QByteArray("RUSR", 4), rebusFill);
+  }
+
+  Puzzle::repairChecksums(file);
+
+  switch (options.corruption) {
+  case Corruption::NONE:
+    break;
+  case Corruption::HEADER_CHECKSUM:
+    file[0x0e] = static_cast<char>(file[0x0e] ^ 0x1);
+    break;
+  case Corruption::GLOBAL_CHECKSUM:
+    file[0x00] = static_cast<char>(file[0x00] ^ 0x1);
+    break;
+  case Corruption::MAGIC_CHECKSUM:
+    file[0x10] = static_cast<char>(file[0x10] ^ 0x1);
+    break;
+  case Corruption::MAGIC:
+    file[0x02] = 'X';
+    break;
+  case Corruption::TRUNCATED:
+    file.truncate(0x34 + static_cast<int>(random.below(
+                             static_cast<uint32_t>(file.size() - 0x34))));
+    break;
+  case Corruption::CLUE_COUNT:
+    writeUInt16LE(file, 0x2e, static_cast<uint16_t>(numClues + 1));
+    Puzzle::repairChecksums(file);
+    break;
+  case Corruption::EXTENSION_LENGTH:
+    if (file.size() > extensionStart) {
+      writeUInt16LE(file, extensionStart + 4, 0xffff);
+    }
+    break;
+  }
+
+  return file;
+}
+
+bool PuzzleGenerator::parseCorruption(const QString &name,
+                                      Corruption &corruption) {
+  const int count = sizeof(kCorruptionNames) / sizeof(kCorruptionNames[0]);
+  for (int i = 0; i < count; ++i) {
+    if (name == QLatin1String(kCorruptionNames[i])) {
+      corruption = static_cast<Corruption>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+QStringList PuzzleGenerator::corruptionNames() {
+  QStringList names{};
+  for (const char *name : kCorruptionNames) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+} // namespace cygnus
@@ -0,0 +1,74 @@
+#ifndef PUZZLEGENERATOR_H
+#define PUZZLEGENERATOR_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <cstdint>
+
+namespace cygnus {
+
+/// Generates synthetic .puz files for benchmarks and stress tests.
+/// Output depends only on the options and the seed, on every platform, so a
+/// corpus can be regenerated instead of being stored.
+class PuzzleGenerator {
+public:
+  /// Extension sections to include.
+  enum Extension : uint8_t {
+    GEXT = 0x1,
+    LTIM = 0x2,
+    RUSR = 0x4,
+  };
+
+  /// Damage applied to an otherwise valid file.
+  enum class Corruption {
+    NONE,
+    /// Wrong header checksum, rejected by validatePuzzle().
+    HEADER_CHECKSUM,
+    /// Wrong global checksum.
+    GLOBAL_CHECKSUM,
+    /// Wrong magic checksum.
+    MAGIC_CHECKSUM,
+    /// Wrong file magic, rejected by validatePuzzle().
+    MAGIC,
+    /// File cut short at a random point after the header.
+    TRUNCATED,
+    /// Header claims one more clue than the text holds, with checksums
+    /// which match the wrong count.
+    CLUE_COUNT,
+    /// First extension claims to be longer than the file. No effect if there
+    /// are no extensions.
+    EXTENSION_LENGTH,
+  };
+
+  struct Options {
+    uint8_t width{15};
+    uint8_t height{15};
+    /// Fraction of black squares, placed with rotational symmetry.
+    double blackDensity{0.16};
+    /// Average length of clue text in characters.
+    uint32_t clueLength{30};
+    /// Fraction of white squares the player has filled in.
+    double fillDensity{0.5};
+    /// Fraction of filled squares holding a rebus entry, needs RUSR.
+    double rebusDensity{0.0};
+    uint8_t extensions{GEXT | LTIM};
+    Corruption corruption{Corruption::NONE};
+  };
+
+  /// \return a puzzle generated from \p options and \p seed, with correct
+  /// checksums unless a corruption was requested.
+  static QByteArray generate(const Options &options, uint64_t seed);
+
+  /// Parse the command line name of a corruption, such as "magic-checksum".
+  /// \return false if \p name is not a corruption.
+  static bool parseCorruption(const QString &name, Corruption &corruption);
+
+  /// \return the command line names of every corruption.
+  static QStringList corruptionNames();
+};
+
+} // namespace cygnus
+
+#endif
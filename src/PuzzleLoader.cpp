@@ -0,0 +1,55 @@
+#include "PuzzleLoader.h"
+
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <QRunnable>
+
+namespace cygnus {
+
+namespace {
+
+class Job : public QRunnable {
+public:
+  explicit Job(std::function<void()> run) : run_(std::move(run)) {}
+  void run() override { run_(); }
+
+private:
+  std::function<void()> run_;
+};
+
+} // namespace
+
+PuzzleLoader::PuzzleLoader(QObject *parent, const QString &snapshotDirectory)
+    : QObject(parent), snapshots_(snapshotDirectory) {}
+
+PuzzleLoader::~PuzzleLoader() {
+  pool_.clear();
+  pool_.waitForDone();
+}
+
+void PuzzleLoader::load(const QStringList &paths, Callback done) {
+  static Counter &files = Metrics::counter("loader.files");
+  files.add(paths.size());
+  // Shared by the jobs, which outlive this call.
+  auto callback = std::make_shared<Callback>(std::move(done));
+  for (const QString &path : paths) {
+    ++pending_;
+    pool_.start(new Job{[this, path, callback] {
+      CYGNUS_TRACE_SPAN("PuzzleLoader::load");
+      // Owned by the queued call, so that it is freed even if the loader is
+      // destroyed before the call is delivered.
+      auto puzzle = std::make_shared<std::unique_ptr<Puzzle>>(
+          snapshots_.load(path));
+      QMetaObject::invokeMethod(
+          this,
+          [this, path, callback, puzzle] {
+            --pending_;
+            (*callback)(path, std::move(*puzzle));
+          },
+          Qt::QueuedConnection);
+    }});
+  }
+}
+
+} // namespace cygnus
@@ -0,0 +1,51 @@
+#ifndef PUZZLELOADER_H
+#define PUZZLELOADER_H
+
+#include "Puzzle.h"
+#include "SnapshotCache.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <functional>
+#include <memory>
+
+namespace cygnus {
+
+/// Loads puzzle files on a pool of background threads, one file per thread,
+/// so that opening several files takes about as long as the largest of them.
+/// Files go through a SnapshotCache, like MainWindow::loadFile().
+class PuzzleLoader : public QObject {
+  Q_OBJECT
+
+public:
+  /// Called on the thread of the loader with the file at \p path and its
+  /// puzzle, or nullptr if it isn't a valid puzzle.
+  using Callback =
+      std::function<void(const QString &path, std::unique_ptr<Puzzle>)>;
+
+  /// Snapshots of the files are kept in \p snapshotDirectory.
+  explicit PuzzleLoader(
+      QObject *parent = nullptr,
+      const QString &snapshotDirectory = SnapshotCache::defaultDirectory());
+  /// Cancels the files which haven't started, and waits for the rest.
+  ~PuzzleLoader() override;
+
+  /// Load every file in \p paths in the background, and call \p done with
+  /// each puzzle as soon as it is loaded, in the order they finish.
+  void load(const QStringList &paths, Callback done);
+
+  /// \return true if some files haven't been delivered yet.
+  inline bool busy() const { return pending_ > 0; }
+
+private:
+  SnapshotCache snapshots_;
+  /// Files being loaded.
+  int pending_{0};
+  QThreadPool pool_{};
+};
+
+} // namespace cygnus
+
+#endif
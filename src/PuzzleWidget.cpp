@@ -2,10 +2,15 @@
 
 #include "Colors.h"
 #include "FilledLabel.h"
+#include "Metrics.h"
 #include "Puzzle.h"
 
 namespace cygnus {
 
+/// Rough size of the private data Qt allocates for each widget or layout,
+/// which isn't visible through sizeof.
+static constexpr size_t kObjectPrivateBytes = 512;
+
 CellWidget::CellWidget(bool isBlack, uint8_t row, uint8_t col,
                        const Puzzle::CellData &cellData,
                        const Puzzle::Markup markup, QWidget *parent)
@@ -57,6 +62,14 @@ CellWidget::CellWidget(bool isBlack, uint8_t row, uint8_t col,
   setMouseTracking(true);
 }
 
+size_t CellWidget::memoryUsage() const {
+  // The cell, its two labels and its layout.
+  return sizeof(CellWidget) + sizeof(FilledLabel) + sizeof(QLabel) +
+         sizeof(QGridLayout) + 4 * kObjectPrivateBytes +
+         heapBytes(displayText_) + heapBytes(entryLabel_->text()) +
+         heapBytes(numLabel_->text());
+}
+
 void CellWidget::enterEvent(QEvent *event) {
   if (displayText_.size() > 3)
     QToolTip::showText(this->mapToGlobal(QPoint(0, 0)), displayText_);
@@ -135,6 +148,9 @@ void CellWidget::mousePressEvent(QMouseEvent *event) {
 }
 
 void CellWidget::paintEvent(QPaintEvent *pe) {
+  CYGNUS_TRACE_SPAN("CellWidget::paintEvent");
+  static Counter &cellsPainted = Metrics::counter("paint.cells");
+  cellsPainted.add();
   QWidget::paintEvent(pe);
 
   QPainter painter(this);
@@ -178,6 +194,7 @@ void CellWidget::paintEvent(QPaintEvent *pe) {
 PuzzleWidget::PuzzleWidget(const std::unique_ptr<Puzzle> &puzzle,
                            QWidget *parent)
     : QWidget(parent) {
+  CYGNUS_TRACE_SPAN("PuzzleWidget::PuzzleWidget");
   gridLayout_ = new QGridLayout{};
   resizer_ = new PuzzleResizer{this, gridLayout_};
   resizer_->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
@@ -186,32 +203,30 @@ PuzzleWidget::PuzzleWidget(const std::unique_ptr<Puzzle> &puzzle,
   hbox->addWidget(resizer_, 1);
   setLayout(hbox);
 
-  cells_.clear();
+  cells_ = Grid<CellWidget *>(puzzle->getHeight(), puzzle->getWidth());
   auto &grid = puzzle->getGrid();
   auto &markup = puzzle->getMarkup();
   auto &cellData = puzzle->getCellData();
   auto &rebusFill = puzzle->getRebusFill();
   for (uint8_t r = 0; r < puzzle->getHeight(); ++r) {
-    std::vector<CellWidget *> cellRow{};
-    cellRow.reserve(puzzle->getHeight());
     for (uint8_t c = 0; c < puzzle->getWidth(); ++c) {
       auto cell = new CellWidget(grid[r][c] == BLACK, r, c, cellData[r][c],
                                  markup[r][c]);
-      if (!rebusFill[r][c].isEmpty()) {
-        cell->setCell(rebusFill[r][c], QChar(grid[r][c]).isLower());
+      const QString &rebus = rebusFill.get(r, c);
+      if (!rebus.isEmpty()) {
+        cell->setCell(rebus, QChar(grid[r][c]).isLower());
       } else {
         cell->setCell(QString("%1").arg(grid[r][c]).toUpper(),
                       QChar(grid[r][c]).isLower());
       }
       cell->setContentsMargins(0, 0, 0, 0);
-      cellRow.push_back(cell);
+      cells_[r][c] = cell;
       gridLayout_->addWidget(cell, r, c, 1, 1);
 
       connect(cell, &CellWidget::clicked, this, &PuzzleWidget::cellClicked);
       connect(cell, &CellWidget::rightClicked, this,
               &PuzzleWidget::cellRightClicked);
     }
-    cells_.push_back(cellRow);
   }
 
   gridLayout_->setSpacing(0);
@@ -220,6 +235,16 @@ PuzzleWidget::PuzzleWidget(const std::unique_ptr<Puzzle> &puzzle,
   resizer_->setContentsMargins(0, 0, 0, 0);
 }
 
+size_t PuzzleWidget::memoryUsage() const {
+  size_t bytes = sizeof(PuzzleWidget) + sizeof(PuzzleResizer) +
+                 2 * sizeof(QGridLayout) + 4 * kObjectPrivateBytes +
+                 heapBytes(cells_);
+  for (const CellWidget *cell : cells_) {
+    bytes += cell->memoryUsage() + sizeof(QWidgetItem);
+  }
+  return bytes;
+}
+
 void PuzzleWidget::selectCursorPosition(uint8_t row, uint8_t col) {
   cells_[row][col]->selectCursor();
 }
@@ -241,4 +266,23 @@ void PuzzleWidget::setMarkup(uint8_t row, uint8_t col, Puzzle::Markup markup) {
   cells_[row][col]->setMarkup(markup);
 }
 
+void PuzzleWidget::applyChanges(const Puzzle::ChangeSet &changes) {
+  // Toggling updates repaints the whole grid, so only batch larger changes.
+  const bool batch = changes.size() > 1;
+  if (batch) {
+    setUpdatesEnabled(false);
+  }
+  for (const auto &change : changes) {
+    CellWidget *cell = cells_[change.row][change.col];
+    cell->setMarkup(change.markup);
+    cell->setCell(change.rebus.isEmpty()
+                      ? QString(QChar(change.cell)).toUpper()
+                      : change.rebus,
+                  QChar(change.cell).isLower());
+  }
+  if (batch) {
+    setUpdatesEnabled(true);
+  }
+}
+
 } // namespace cygnus
@@ -2,6 +2,7 @@
 #define PUZZLEWIDGET_H
 
 #include "Puzzle.h"
+#include "Trace.h"
 
 #include <QtWidgets>
 
@@ -28,6 +29,9 @@ public:
   inline uint8_t getRow() const { return row_; }
   inline uint8_t getCol() const { return col_; }
 
+  /// \return the estimated bytes used by the cell, its labels and layout.
+  size_t memoryUsage() const;
+
 protected:
   void paintEvent(QPaintEvent *pe) override;
 
@@ -79,6 +83,9 @@ public:
   explicit PuzzleWidget(const std::unique_ptr<Puzzle> &puzzle,
                         QWidget *parent = nullptr);
 
+  /// \return the estimated bytes used by the widget tree of the grid.
+  size_t memoryUsage() const;
+
 public slots:
   void selectCursorPosition(uint8_t row, uint8_t col);
   void selectPosition(uint8_t row, uint8_t col);
@@ -97,6 +104,10 @@ public slots:
   void setCell(uint8_t row, uint8_t col, const QString &text, bool pencil);
   void setMarkup(uint8_t row, uint8_t col, Puzzle::Markup markup);
 
+  /// Update every cell in \p changes, repainting the grid once if there is
+  /// more than one.
+  void applyChanges(const Puzzle::ChangeSet &changes);
+
 signals:
   void clicked(uint8_t row, uint8_t col);
   void rightClicked();
@@ -130,26 +141,25 @@ public:
 
   /// Resize the inner grid to accomodate square cells.
   void resizeEvent(QResizeEvent *event) override {
+    CYGNUS_TRACE_SPAN("PuzzleResizer::resizeEvent");
     int h = event->size().height();
     int w = event->size().width();
-    int rows = puzzle_->cells_.size();
-    int cols = puzzle_->cells_[0].size();
+    int rows = puzzle_->cells_.height();
+    int cols = puzzle_->cells_.width();
     int minSize = CellWidget::kMinimumSize;
     // Find the limiting dimension but clamp it to the minSize.
     int cellSize = std::max(minSize, std::min(h / rows, w / cols));
     // (width, height)
     QSize gridSize{cols * cellSize, rows * cellSize};
     grid_->setFixedSize(gridSize);
-    for (auto &row : puzzle_->cells_) {
-      for (auto &cell : row) {
-        cell->setFixedSize(cellSize, cellSize);
-      }
+    for (CellWidget *cell : puzzle_->cells_) {
+      cell->setFixedSize(cellSize, cellSize);
     }
   }
 
   QSize minimumSizeHint() const override {
-    int rows = puzzle_->cells_.size();
-    int cols = puzzle_->cells_[0].size();
+    int rows = puzzle_->cells_.height();
+    int cols = puzzle_->cells_.width();
     int cellSize = CellWidget::kMinimumSize + 2;
     return QSize(rows * cellSize, cols * cellSize);
   }
@@ -0,0 +1,51 @@
+#include "RebusFill.h"
+
+#include <algorithm>
+
+namespace cygnus {
+
+const QString &RebusFill::get(uint8_t row, uint8_t col) const {
+  const uint16_t cell = index(row, col);
+  auto it = lowerBound(cell);
+  if (it == entries_.end() || it->cell != cell) {
+    return pool_.at(0);
+  }
+  return pool_.at(it->id);
+}
+
+void RebusFill::set(uint8_t row, uint8_t col, const QString &text) {
+  const uint16_t cell = index(row, col);
+  auto it = entries_.begin() + (lowerBound(cell) - entries_.cbegin());
+  const bool found = it != entries_.end() && it->cell == cell;
+  if (!isRebus(text)) {
+    if (found) {
+      entries_.erase(it);
+    }
+    return;
+  }
+
+  const uint32_t id = pool_.intern(text);
+  if (found) {
+    it->id = id;
+  } else {
+    entries_.insert(it, Entry{cell, id});
+  }
+}
+
+size_t RebusFill::memoryUsage() const {
+  return heapBytes(entries_) + pool_.memoryUsage();
+}
+
+void RebusFill::clear() {
+  entries_.clear();
+  pool_.clear();
+}
+
+std::vector<RebusFill::Entry>::const_iterator
+RebusFill::lowerBound(uint16_t cell) const {
+  return std::lower_bound(
+      entries_.begin(), entries_.end(), cell,
+      [](const Entry &entry, uint16_t cell) { return entry.cell < cell; });
+}
+
+} // namespace cygnus
@@ -0,0 +1,68 @@
+#ifndef REBUSFILL_H
+#define REBUSFILL_H
+
+#include "StringPool.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace cygnus {
+
+/// Sparse storage for the rebus entries of a grid.
+/// Only entries which don't fit in a single grid letter (multiple characters,
+/// or digits) are stored, keyed by cell index and sorted, with their text
+/// interned in a StringPool. Most puzzles have no rebus entries at all, in
+/// which case this holds nothing.
+class RebusFill {
+public:
+  RebusFill() = default;
+  explicit RebusFill(uint8_t width) : width_(width) {}
+
+  /// \return true if \p text must be stored as a rebus entry rather than
+  /// only as a letter in the grid.
+  static inline bool isRebus(const QString &text) {
+    return text.size() > 1 || (text.size() == 1 && text.at(0).isDigit());
+  }
+
+  /// \return the rebus text at (\p row, \p col), empty if there is none.
+  const QString &get(uint8_t row, uint8_t col) const;
+
+  /// Set the rebus text at (\p row, \p col) to \p text.
+  /// Text which isn't a rebus entry removes the entry for the cell.
+  void set(uint8_t row, uint8_t col, const QString &text);
+
+  /// \return true if there are no rebus entries.
+  inline bool empty() const { return entries_.empty(); }
+
+  /// \return the number of rebus entries.
+  inline size_t size() const { return entries_.size(); }
+
+  /// \return the estimated bytes of heap used by the entries.
+  size_t memoryUsage() const;
+
+  void clear();
+
+private:
+  struct Entry {
+    uint16_t cell;
+    uint32_t id;
+  };
+
+  inline uint16_t index(uint8_t row, uint8_t col) const {
+    return static_cast<uint16_t>(row * width_ + col);
+  }
+
+  /// \return the first entry with a cell index not less than \p cell.
+  std::vector<Entry>::const_iterator lowerBound(uint16_t cell) const;
+
+  uint8_t width_{0};
+
+  /// Entries, sorted by cell index.
+  std::vector<Entry> entries_{};
+  StringPool pool_{};
+};
+
+} // namespace cygnus
+
+#endif
@@ -4,5 +4,6 @@ namespace cygnus {
 namespace Settings {
 static constexpr const char *clueSize = "display/clueSize";
 static constexpr const char *darkMode = "display/darkMode";
+static constexpr const char *pastClues = "display/pastClues";
 } // namespace Settings
 } // namespace cygnus
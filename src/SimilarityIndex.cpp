@@ -0,0 +1,141 @@
+#include "SimilarityIndex.h"
+
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace cygnus {
+
+namespace {
+
+/// Final mix of SplitMix64, which turns similar inputs into unrelated
+/// outputs.
+inline uint64_t mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+/// 64-bit FNV-1a of \p text.
+inline uint64_t hashText(const QByteArray &text) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+} // namespace
+
+constexpr size_t SimilarityIndex::kHashes;
+constexpr size_t SimilarityIndex::kRows;
+constexpr size_t SimilarityIndex::kBands;
+constexpr float SimilarityIndex::kThreshold;
+
+Signature SimilarityIndex::signature(const Puzzle &puzzle) {
+  std::vector<QByteArray> answers{};
+  answers.reserve(puzzle.getNumClues());
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    for (const Clue &clue : puzzle.getClues(dir)) {
+      answers.push_back(puzzle.getAnswer(clue).toUpper());
+    }
+  }
+  return signature(answers);
+}
+
+Signature SimilarityIndex::signature(const std::vector<QByteArray> &answers) {
+  if (answers.empty()) {
+    return Signature{};
+  }
+  Signature result(kHashes, std::numeric_limits<uint32_t>::max());
+  for (const QByteArray &answer : answers) {
+    // Hash function i is the text hash mixed with seed i.
+    const uint64_t hash = hashText(answer);
+    for (size_t i = 0; i < kHashes; ++i) {
+      const auto value =
+          static_cast<uint32_t>(mix(hash + (i + 1) * 0x9e3779b97f4a7c15));
+      result[i] = std::min(result[i], value);
+    }
+  }
+  return result;
+}
+
+float SimilarityIndex::similarity(const Signature &a, const Signature &b) {
+  if (a.size() != kHashes || b.size() != kHashes) {
+    return 0;
+  }
+  size_t equal = 0;
+  for (size_t i = 0; i < kHashes; ++i) {
+    equal += a[i] == b[i];
+  }
+  return static_cast<float>(equal) / kHashes;
+}
+
+void SimilarityIndex::clear() {
+  signatures_.clear();
+  for (auto &band : bands_) {
+    band.clear();
+  }
+}
+
+uint32_t SimilarityIndex::add(Signature signature) {
+  const auto item = static_cast<uint32_t>(signatures_.size());
+  if (signature.size() == kHashes) {
+    for (size_t band = 0; band < kBands; ++band) {
+      bands_[band][bandKey(signature, band)].push_back(item);
+    }
+  }
+  signatures_.push_back(std::move(signature));
+  return item;
+}
+
+std::vector<SimilarityIndex::Match>
+SimilarityIndex::query(const Signature &signature, float threshold,
+                       size_t limit) const {
+  CYGNUS_TRACE_SPAN("SimilarityIndex::query");
+  CYGNUS_METRICS_TIMER("similarity.query_ns");
+  std::vector<Match> matches{};
+  if (signature.size() != kHashes) {
+    return matches;
+  }
+
+  std::vector<uint32_t> candidates{};
+  for (size_t band = 0; band < kBands; ++band) {
+    auto it = bands_[band].find(bandKey(signature, band));
+    if (it != bands_[band].end()) {
+      candidates.insert(candidates.end(), it->begin(), it->end());
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+  static Counter &compared = Metrics::counter("similarity.candidates");
+  compared.add(static_cast<int64_t>(candidates.size()));
+
+  for (const uint32_t item : candidates) {
+    const float score = similarity(signature, signatures_[item]);
+    if (score >= threshold) {
+      matches.push_back(Match{item, score});
+    }
+  }
+  std::stable_sort(matches.begin(), matches.end(),
+                   [](const Match &a, const Match &b) {
+                     return a.similarity > b.similarity;
+                   });
+  if (matches.size() > limit) {
+    matches.resize(limit);
+  }
+  return matches;
+}
+
+uint64_t SimilarityIndex::bandKey(const Signature &signature, size_t band) {
+  uint64_t key = band;
+  for (size_t i = band * kRows; i < (band + 1) * kRows; ++i) {
+    key = mix(key ^ signature[i]);
+  }
+  return key;
+}
+
+} // namespace cygnus
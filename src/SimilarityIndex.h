@@ -0,0 +1,82 @@
+#ifndef SIMILARITYINDEX_H
+#define SIMILARITYINDEX_H
+
+#include "Puzzle.h"
+
+#include <QByteArray>
+#include <QHash>
+
+#include <array>
+#include <vector>
+
+namespace cygnus {
+
+/// MinHash signature of a set of answers: the smallest hash of any answer
+/// under each of SimilarityIndex::kHashes hash functions. The fraction of
+/// positions where two signatures agree estimates the Jaccard similarity of
+/// their sets. Empty for a puzzle without answers.
+using Signature = std::vector<uint32_t>;
+
+/// Finds puzzles which share many answers with a given one, such as reruns
+/// with a few changes or themed variants, without comparing it to every
+/// puzzle. Signatures are split into kBands bands of kRows hashes, and the
+/// puzzles whose signatures are identical in a band share a bucket
+/// (locality sensitive hashing). Only puzzles sharing a bucket with the query
+/// are compared, which finds those above roughly 20% similarity while
+/// skipping nearly all of the others.
+class SimilarityIndex {
+public:
+  static constexpr size_t kHashes = 64;
+  static constexpr size_t kRows = 2;
+  static constexpr size_t kBands = kHashes / kRows;
+  /// Default minimum similarity of a match, above which nearly every
+  /// similar puzzle shares a bucket with the query.
+  static constexpr float kThreshold = 0.2f;
+
+  /// An indexed puzzle, and its estimated similarity to the query.
+  struct Match {
+    uint32_t item;
+    float similarity;
+  };
+
+  SimilarityIndex() = default;
+
+  /// \return the signature of the answers of \p puzzle, read from its
+  /// solution along the clues numbered when it was loaded.
+  static Signature signature(const Puzzle &puzzle);
+
+  /// \return the signature of \p answers, which may contain duplicates.
+  static Signature signature(const std::vector<QByteArray> &answers);
+
+  /// \return the estimated Jaccard similarity of the sets of \p a and \p b,
+  /// from 0 to 1, or 0 if either is empty.
+  static float similarity(const Signature &a, const Signature &b);
+
+  /// Remove every puzzle.
+  void clear();
+
+  /// Add a puzzle with \p signature, skipped if it is empty.
+  /// \return the item identifying it in matches, which count up from 0.
+  uint32_t add(Signature signature);
+
+  /// \return the number of puzzles added, including skipped ones.
+  inline size_t size() const { return signatures_.size(); }
+
+  /// \return the puzzles whose similarity to \p signature is at least
+  /// \p threshold, most similar first, at most \p limit.
+  std::vector<Match> query(const Signature &signature,
+                           float threshold = kThreshold,
+                           size_t limit = 50) const;
+
+private:
+  /// \return the key of band \p band of \p signature.
+  static uint64_t bandKey(const Signature &signature, size_t band);
+
+  std::vector<Signature> signatures_{};
+  /// Items in each bucket of each band.
+  std::array<QHash<uint64_t, std::vector<uint32_t>>, kBands> bands_{};
+};
+
+} // namespace cygnus
+
+#endif
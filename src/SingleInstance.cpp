@@ -0,0 +1,130 @@
+#include "SingleInstance.h"
+
+#include "Trace.h"
+
+#include <QAbstractSocket>
+#include <QDataStream>
+#include <QDebug>
+#include <QFileInfo>
+#include <QLocalSocket>
+
+#include <cstring>
+
+namespace cygnus {
+
+namespace {
+
+/// Time to wait for the running instance to accept a connection. It only
+/// matters if that instance is hung, in which case the launch goes on as a
+/// new instance.
+const int kConnectTimeoutMs = 200;
+/// Time to wait for the running instance to acknowledge the files. It may be
+/// busy for a while, but it opens them regardless once they have been sent.
+const int kReplyTimeoutMs = 5000;
+
+/// Times to try listening, when other launches starting at the same time
+/// keep taking the socket first.
+const int kListenAttempts = 3;
+
+/// Sent back once the files have been received.
+const char kAcknowledgement = '\n';
+
+} // namespace
+
+SingleInstance::SingleInstance(QObject *parent) : QObject(parent) {
+  connect(&server_, &QLocalServer::newConnection, this, [this] {
+    while (QLocalSocket *socket = server_.nextPendingConnection()) {
+      connect(socket, &QLocalSocket::disconnected, socket,
+              &QObject::deleteLater);
+      connect(socket, &QLocalSocket::readyRead, this, [this, socket] {
+        QDataStream in{socket};
+        in.setVersion(QDataStream::Qt_5_12);
+        // The list may arrive in several reads.
+        in.startTransaction();
+        QStringList fileNames{};
+        in >> fileNames;
+        if (!in.commitTransaction()) {
+          return;
+        }
+        socket->putChar(kAcknowledgement);
+        socket->disconnectFromServer();
+        emit filesReceived(fileNames);
+      });
+    }
+  });
+}
+
+bool SingleInstance::enabled(int &argc, char *argv[]) {
+  bool enabled = true;
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--new-instance") == 0) {
+      enabled = false;
+    } else {
+      argv[out++] = argv[i];
+    }
+  }
+  argc = out;
+  argv[argc] = nullptr;
+  return enabled;
+}
+
+bool SingleInstance::forward(const QStringList &fileNames) {
+  CYGNUS_TRACE_SPAN("SingleInstance::forward");
+  QLocalSocket socket{};
+  socket.connectToServer(serverName());
+  if (!socket.waitForConnected(kConnectTimeoutMs)) {
+    return false;
+  }
+
+  // The running instance has its own working directory.
+  QStringList absolute{};
+  for (const QString &fileName : fileNames) {
+    absolute.push_back(QFileInfo{fileName}.absoluteFilePath());
+  }
+  QDataStream out{&socket};
+  out.setVersion(QDataStream::Qt_5_12);
+  out << absolute;
+
+  // From here on the files are the running instance's to open, since it may
+  // just be slow to reply. Going on as a new instance would open them twice.
+  char reply = 0;
+  socket.waitForBytesWritten(kReplyTimeoutMs);
+  if (!socket.waitForReadyRead(kReplyTimeoutMs) || !socket.getChar(&reply) ||
+      reply != kAcknowledgement) {
+    qWarning() << "The running instance didn't acknowledge" << absolute;
+  }
+  return true;
+}
+
+bool SingleInstance::listen(const QStringList &fileNames) {
+  // Only the user who started the instance may connect to it.
+  server_.setSocketOptions(QLocalServer::UserAccessOption);
+  for (int attempt = 0; attempt < kListenAttempts; ++attempt) {
+    if (server_.listen(serverName())) {
+      return true;
+    }
+    if (server_.serverError() != QAbstractSocket::AddressInUseError) {
+      break;
+    }
+    // Either another launch has started listening since forward() was
+    // called, or the socket was left behind by an instance which crashed.
+    if (forward(fileNames)) {
+      return false;
+    }
+    QLocalServer::removeServer(serverName());
+  }
+  qWarning() << "Unable to listen for other instances:"
+             << server_.errorString();
+  return true;
+}
+
+QString SingleInstance::serverName() {
+  QString user = QString::fromLocal8Bit(qgetenv("USER"));
+  if (user.isEmpty()) {
+    user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+  }
+  return "cygnus-crosswords-" + user;
+}
+
+} // namespace cygnus
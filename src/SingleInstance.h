@@ -0,0 +1,52 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QLocalServer>
+#include <QObject>
+#include <QStringList>
+
+namespace cygnus {
+
+/// Keeps a single instance of the application per user. The first instance
+/// listens on a local socket, and later launches hand it the files they were
+/// given and exit, instead of starting Qt and creating windows of their own.
+/// The macOS equivalent is QEvent::FileOpen, so this is only used elsewhere.
+class SingleInstance : public QObject {
+  Q_OBJECT
+
+public:
+  explicit SingleInstance(QObject *parent = nullptr);
+
+  /// Remove --new-instance from the arguments, which starts an instance of
+  /// its own regardless of any running one.
+  /// \return false if it was given.
+  static bool enabled(int &argc, char *argv[]);
+
+  /// Send \p fileNames to the running instance, if there is one. Needs a
+  /// QCoreApplication but no event loop, so that it can run before the
+  /// QApplication is created.
+  /// \return true if they were sent, in which case the running instance
+  /// opens them and this launch should exit.
+  static bool forward(const QStringList &fileNames);
+
+  /// Start receiving the files of later launches. If another launch started
+  /// listening first, \p fileNames are forwarded to it instead.
+  /// \return false if they were forwarded, in which case this launch should
+  /// exit.
+  bool listen(const QStringList &fileNames);
+
+signals:
+  /// Emitted when a later launch was given \p fileNames, which may be empty
+  /// if it was started without any.
+  void filesReceived(const QStringList &fileNames);
+
+private:
+  /// \return the name of the socket, which is different for each user.
+  static QString serverName();
+
+  QLocalServer server_{};
+};
+
+} // namespace cygnus
+
+#endif
@@ -0,0 +1,194 @@
+#include "SnapshotCache.h"
+
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+namespace cygnus {
+
+namespace {
+
+const char CACHE_MAGIC[8] = "CYGCACH";
+
+/// Increment whenever the layout of CacheHeader changes. Changes to the
+/// snapshot itself are detected by Puzzle::fromSnapshot().
+const uint32_t CACHE_FORMAT = 1;
+
+/// Start of a snapshot file, followed by the absolute path of the puzzle file
+/// in UTF-8 and then the snapshot, at an offset aligned to 8 bytes.
+struct CacheHeader {
+  char magic[8];
+  uint32_t format;
+  uint32_t pathSize;
+  /// Size, modification time in ms since the epoch and contentHash() of the
+  /// puzzle file when the snapshot was stored.
+  uint64_t fileSize;
+  int64_t modified;
+  uint64_t contentHash;
+  uint32_t snapshotOffset;
+  uint32_t snapshotSize;
+};
+
+} // namespace
+
+SnapshotCache::SnapshotCache(const QString &directory)
+    : directory_(directory) {}
+
+QString SnapshotCache::defaultDirectory() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/snapshots";
+}
+
+uint64_t SnapshotCache::contentHash(const QByteArray &contents) {
+  // 64-bit FNV-1a.
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const char c : contents) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+QString SnapshotCache::snapshotPath(const QString &path) const {
+  const QByteArray name = QCryptographicHash::hash(
+      QFileInfo{path}.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+  return directory_ + "/" + QString::fromLatin1(name.toHex()) + ".snap";
+}
+
+std::unique_ptr<Puzzle> SnapshotCache::load(const QString &path) const {
+  CYGNUS_TRACE_SPAN("SnapshotCache::load");
+  static Counter &hits = Metrics::counter("snapshot.hits");
+  static Counter &misses = Metrics::counter("snapshot.misses");
+  QByteArray contents{};
+  if (auto puzzle = loadSnapshot(path, contents)) {
+    hits.add();
+    return puzzle;
+  }
+  misses.add();
+
+  // The file was read already if only its modification time changed.
+  if (contents.isNull()) {
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+      return nullptr;
+    }
+    contents = file.readAll();
+  }
+  auto puzzle = Puzzle::loadFromFile(contents);
+  if (puzzle) {
+    store(path, *puzzle, contents);
+  }
+  return puzzle;
+}
+
+std::unique_ptr<Puzzle> SnapshotCache::loadSnapshot(const QString &path,
+                                                   QByteArray &contents) const {
+  const QFileInfo info{path};
+  // The mapping lasts as long as the file is open. The puzzle copies what it
+  // needs out of it, so the snapshot can be replaced while the puzzle is open,
+  // which Windows doesn't allow for a mapped file.
+  QFile file{snapshotPath(path)};
+  if (!info.exists() || !file.open(QIODevice::ReadOnly)) {
+    return nullptr;
+  }
+  const qint64 size = file.size();
+  if (size < static_cast<qint64>(sizeof(CacheHeader))) {
+    return nullptr;
+  }
+  const char *data = reinterpret_cast<const char *>(file.map(0, size));
+  if (!data) {
+    qDebug() << "Unable to map snapshot:" << file.fileName();
+    return nullptr;
+  }
+
+  CacheHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  const QByteArray absolutePath = info.absoluteFilePath().toUtf8();
+  if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.format != CACHE_FORMAT ||
+      header.pathSize != static_cast<uint32_t>(absolutePath.size()) ||
+      header.pathSize > size - sizeof(CacheHeader) ||
+      std::memcmp(data + sizeof(CacheHeader), absolutePath.constData(),
+                  header.pathSize) != 0 ||
+      header.snapshotOffset > size ||
+      header.snapshotSize > size - header.snapshotOffset) {
+    qDebug() << "Discarding invalid snapshot:" << file.fileName();
+    return nullptr;
+  }
+
+  if (header.fileSize != static_cast<uint64_t>(info.size())) {
+    return nullptr;
+  }
+  const bool touched =
+      header.modified != info.lastModified().toMSecsSinceEpoch();
+  if (touched) {
+    // The file was touched, but may not have changed.
+    QFile puzFile{path};
+    if (!puzFile.open(QIODevice::ReadOnly)) {
+      return nullptr;
+    }
+    contents = puzFile.readAll();
+    if (contentHash(contents) != header.contentHash) {
+      return nullptr;
+    }
+  }
+
+  const QByteArray snapshot = QByteArray::fromRawData(
+      data + header.snapshotOffset, static_cast<int>(header.snapshotSize));
+  auto puzzle = Puzzle::fromSnapshot(snapshot);
+  if (puzzle && touched) {
+    // Stored with the new time, so that the file isn't read and hashed again
+    // every time it is opened. The snapshot is unmapped first so that it can
+    // be replaced.
+    file.close();
+    store(path, *puzzle, contents);
+  }
+  return puzzle;
+}
+
+bool SnapshotCache::store(const QString &path, const Puzzle &puzzle,
+                          const QByteArray &contents) const {
+  CYGNUS_TRACE_SPAN("SnapshotCache::store");
+  const QFileInfo info{path};
+  const QByteArray absolutePath = info.absoluteFilePath().toUtf8();
+  const QByteArray snapshot = puzzle.snapshot();
+
+  CacheHeader header{};
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.format = CACHE_FORMAT;
+  header.pathSize = static_cast<uint32_t>(absolutePath.size());
+  header.fileSize = static_cast<uint64_t>(info.size());
+  header.modified = info.lastModified().toMSecsSinceEpoch();
+  header.contentHash = contentHash(contents);
+  header.snapshotOffset =
+      (sizeof(CacheHeader) + header.pathSize + 7) & ~uint32_t{7};
+  header.snapshotSize = static_cast<uint32_t>(snapshot.size());
+
+  QByteArray bytes(static_cast<int>(header.snapshotOffset), '\0');
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  std::memcpy(bytes.data() + sizeof(header), absolutePath.constData(),
+              header.pathSize);
+  bytes += snapshot;
+
+  // Written to a temporary file and renamed, so that a snapshot is never
+  // read half written.
+  QDir{}.mkpath(directory_);
+  QSaveFile file{snapshotPath(path)};
+  if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() ||
+      !file.commit()) {
+    qWarning() << "Unable to write snapshot:" << file.fileName();
+    return false;
+  }
+  return true;
+}
+
+} // namespace cygnus
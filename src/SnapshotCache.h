@@ -0,0 +1,59 @@
+#ifndef SNAPSHOTCACHE_H
+#define SNAPSHOTCACHE_H
+
+#include "Puzzle.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+
+namespace cygnus {
+
+/// Cache of decoded puzzles, so that reopening a puzzle maps its snapshot
+/// (see Puzzle::snapshot()) instead of parsing the file again.
+/// Each puzzle file has one snapshot, named after a hash of its absolute
+/// path. A snapshot is used only if the file still has the size and the
+/// modification time it was written for. If only the modification time
+/// changed, the file is read and its contents compared by hash instead, and
+/// the snapshot is stored again with the new time if they are the same.
+class SnapshotCache {
+public:
+  /// Keep snapshots in \p directory, which is created when the first
+  /// snapshot is stored.
+  explicit SnapshotCache(const QString &directory = defaultDirectory());
+
+  /// \return the snapshot directory in the user's cache directory.
+  static QString defaultDirectory();
+
+  /// \return the puzzle in the file at \p path, or nullptr if it can't be
+  /// read or isn't a valid puzzle.
+  /// The puzzle comes from its snapshot if it is up to date, otherwise the
+  /// file is parsed and a new snapshot is stored.
+  std::unique_ptr<Puzzle> load(const QString &path) const;
+
+  /// Store a snapshot of \p puzzle for the file at \p path, which must have
+  /// just been written with \p contents.
+  /// \return false if the snapshot couldn't be written.
+  bool store(const QString &path, const Puzzle &puzzle,
+             const QByteArray &contents) const;
+
+  /// \return the hash used to compare the contents of puzzle files.
+  static uint64_t contentHash(const QByteArray &contents);
+
+private:
+  /// \return the path of the snapshot for the puzzle file at \p path.
+  QString snapshotPath(const QString &path) const;
+
+  /// \return the puzzle from the snapshot for the file at \p path, or
+  /// nullptr if there is no snapshot or it is out of date.
+  /// If the file had to be read to tell, \p contents is set to it.
+  std::unique_ptr<Puzzle> loadSnapshot(const QString &path,
+                                       QByteArray &contents) const;
+
+  QString directory_;
+};
+
+} // namespace cygnus
+
+#endif
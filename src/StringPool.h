@@ -0,0 +1,63 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include "MemoryUsage.h"
+
+#include <QHash>
+#include <QString>
+
+#include <vector>
+
+namespace cygnus {
+
+/// Interns strings so that each distinct string is stored once and can be
+/// referred to by a small integer id.
+/// Id 0 is always the empty string.
+class StringPool {
+public:
+  /// \return the id of \p str, adding it to the pool if necessary.
+  uint32_t intern(const QString &str) {
+    if (str.isEmpty()) {
+      return 0;
+    }
+    auto it = ids_.constFind(str);
+    if (it != ids_.constEnd()) {
+      return *it;
+    }
+    uint32_t id = static_cast<uint32_t>(strings_.size());
+    strings_.push_back(str);
+    ids_.insert(str, id);
+    return id;
+  }
+
+  /// \return the string with id \p id.
+  inline const QString &at(uint32_t id) const { return strings_[id]; }
+
+  /// \return the number of strings in the pool, including the empty string.
+  inline size_t size() const { return strings_.size(); }
+
+  /// \return the estimated bytes of heap used by the pool.
+  size_t memoryUsage() const {
+    size_t bytes = heapBytes(strings_);
+    for (const QString &str : strings_) {
+      bytes += heapBytes(str);
+    }
+    // Each hash node holds a shallow copy of the string, its id and the hash.
+    bytes += ids_.size() * (sizeof(void *) + sizeof(QString) + 2 * 4);
+    bytes += ids_.capacity() * sizeof(void *);
+    return bytes;
+  }
+
+  void clear() {
+    strings_.resize(1);
+    ids_.clear();
+  }
+
+private:
+  std::vector<QString> strings_{QString{}};
+  QHash<QString, uint32_t> ids_{};
+};
+
+} // namespace cygnus
+
+#endif
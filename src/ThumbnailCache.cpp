@@ -0,0 +1,151 @@
+#include "ThumbnailCache.h"
+
+#include "Colors.h"
+#include "Metrics.h"
+#include "SnapshotCache.h"
+#include "Trace.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <functional>
+
+namespace cygnus {
+
+namespace {
+
+/// Memory kept for thumbnails, enough for the rows of a large library.
+const int kMemoryCost = 8 << 20;
+
+class Job : public QRunnable {
+public:
+  explicit Job(std::function<void()> run) : run_(std::move(run)) {}
+  void run() override { run_(); }
+
+private:
+  std::function<void()> run_;
+};
+
+} // namespace
+
+ThumbnailCache::ThumbnailCache(int size, const QString &directory,
+                               QObject *parent)
+    : QObject(parent), size_(size), directory_(directory),
+      images_(kMemoryCost) {}
+
+ThumbnailCache::~ThumbnailCache() {
+  pool_.clear();
+  pool_.waitForDone();
+}
+
+QString ThumbnailCache::defaultDirectory() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/thumbnails";
+}
+
+QString ThumbnailCache::thumbnailPath(uint64_t hash) const {
+  return QString("%1/%2-%3.png")
+      .arg(directory_)
+      .arg(hash, 16, 16, QChar('0'))
+      .arg(size_);
+}
+
+QImage ThumbnailCache::thumbnail(const LibraryEntry &entry) {
+  if (const QImage *image = images_.object(entry.hash)) {
+    return *image;
+  }
+  auto waiting = pending_.find(entry.hash);
+  if (waiting == pending_.end()) {
+    pending_.insert(entry.hash, {entry.path});
+    const QString path = entry.path;
+    const uint64_t hash = entry.hash;
+    pool_.start(new Job{[this, path, hash] { make(path, hash); }},
+                nextPriority_++);
+  } else if (!waiting->contains(entry.path)) {
+    waiting->push_back(entry.path);
+  }
+  return QImage{};
+}
+
+void ThumbnailCache::make(const QString &path, uint64_t hash) {
+  CYGNUS_TRACE_SPAN("ThumbnailCache::make");
+  static Counter &diskHits = Metrics::counter("thumbnail.disk_hits");
+  static Counter &renders = Metrics::counter("thumbnail.renders");
+  const QString file = thumbnailPath(hash);
+  QImage image{};
+  if (image.load(file, "PNG")) {
+    diskHits.add();
+  } else {
+    QFile puzFile{path};
+    if (puzFile.open(QIODevice::ReadOnly)) {
+      const QByteArray contents = puzFile.readAll();
+      image = render(contents, size_);
+      renders.add();
+      // The file may have changed since it was indexed, in which case the
+      // thumbnail isn't the one for hash. It is shown until the next scan,
+      // but not stored.
+      if (!image.isNull() && SnapshotCache::contentHash(contents) == hash) {
+        QDir{}.mkpath(directory_);
+        QSaveFile out{file};
+        if (!out.open(QIODevice::WriteOnly) || !image.save(&out, "PNG") ||
+            !out.commit()) {
+          qWarning() << "Unable to write thumbnail:" << file;
+        }
+      }
+    }
+  }
+  QMetaObject::invokeMethod(
+      this, [this, hash, image] { finish(hash, image); },
+      Qt::QueuedConnection);
+}
+
+void ThumbnailCache::finish(uint64_t hash, const QImage &image) {
+  const QStringList paths = pending_.take(hash);
+  // Files which couldn't be read are cached as null images, so that they are
+  // not read again on every repaint.
+  images_.insert(hash, new QImage{image},
+                 std::max(1, static_cast<int>(image.sizeInBytes())));
+  for (const QString &path : paths) {
+    emit ready(path);
+  }
+}
+
+QImage ThumbnailCache::render(const QByteArray &puzFile, int size) {
+  CYGNUS_METRICS_TIMER("thumbnail.render_ns");
+  const Grid<char> grid = Puzzle::viewPlayerGrid(puzFile);
+  if (grid.size() == 0) {
+    return QImage{};
+  }
+
+  // Whole pixels per cell, so that every cell is drawn the same size.
+  const int cell = std::max(1, size / std::max(grid.width(), grid.height()));
+  QImage image{grid.width() * cell, grid.height() * cell,
+               QImage::Format_RGB32};
+  const QRgb black = qRgb(0, 0, 0);
+  const QRgb white = qRgb(255, 255, 255);
+  const QRgb filled = Colors::SECONDARY_HIGHLIGHT.rgb();
+  for (int row = 0; row < grid.height(); ++row) {
+    for (int y = 0; y < cell; ++y) {
+      QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(row * cell + y));
+      for (int col = 0; col < grid.width(); ++col) {
+        const char c = grid[row][col];
+        const QRgb color = c == BLACK ? black : c == EMPTY ? white : filled;
+        std::fill_n(line + col * cell, cell, color);
+      }
+    }
+  }
+
+  // Grids with more cells than pixels are shrunk, one cell per pixel at most.
+  if (image.width() > size || image.height() > size) {
+    return image.scaled(size, size, Qt::KeepAspectRatio,
+                        Qt::FastTransformation);
+  }
+  return image;
+}
+
+} // namespace cygnus
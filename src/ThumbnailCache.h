@@ -0,0 +1,84 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include "Library.h"
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+namespace cygnus {
+
+/// Small images of the grids of library entries, for browsing the library.
+/// Thumbnails are drawn from the player grid of the file alone, without
+/// creating a Puzzle or any widget, on a pool of background threads.
+/// They are kept in memory and in a directory on disk, named after the
+/// content hash of the file and the size of the thumbnail, so that a file
+/// which hasn't changed is never read again.
+class ThumbnailCache : public QObject {
+  Q_OBJECT
+
+public:
+  /// Default size in pixels of the longer side of a thumbnail.
+  static constexpr int kDefaultSize = 48;
+
+  /// Make thumbnails at most \p size pixels wide and high, and keep them in
+  /// \p directory, which is created when the first thumbnail is stored.
+  explicit ThumbnailCache(int size = kDefaultSize,
+                          const QString &directory = defaultDirectory(),
+                          QObject *parent = nullptr);
+  /// Cancels the thumbnails which haven't started, and waits for the rest.
+  ~ThumbnailCache() override;
+
+  /// \return the thumbnail directory in the user's cache directory.
+  static QString defaultDirectory();
+
+  inline int size() const { return size_; }
+
+  /// \return the thumbnail of \p entry, or a null image if it isn't ready.
+  /// In that case it is made in the background, and ready() is emitted once
+  /// it is available. Later requests are served first, so that the rows
+  /// being looked at appear before the ones which were scrolled past.
+  QImage thumbnail(const LibraryEntry &entry);
+
+  /// \return a thumbnail of the player grid in \p puzFile, at most \p size
+  /// pixels wide and high, or a null image if \p puzFile isn't a puzzle.
+  static QImage render(const QByteArray &puzFile, int size);
+
+signals:
+  /// Emitted on the thread of the cache when the thumbnail of the file at
+  /// \p path is available.
+  void ready(const QString &path);
+
+private:
+  /// \return the file of the thumbnail for contents with \p hash.
+  QString thumbnailPath(uint64_t hash) const;
+
+  /// Load or make the thumbnail of the file at \p path, with \p hash.
+  /// Runs on the pool.
+  void make(const QString &path, uint64_t hash);
+
+  /// Keep \p image as the thumbnail for \p hash, and notify every path
+  /// waiting for it.
+  void finish(uint64_t hash, const QImage &image);
+
+  int size_;
+  QString directory_;
+  /// Thumbnails by content hash, costed in bytes.
+  QCache<quint64, QImage> images_;
+  /// Paths waiting for each thumbnail being made, by hash. Copies of a
+  /// puzzle share a thumbnail, and each of their rows is notified.
+  QHash<quint64, QStringList> pending_{};
+  /// Priority of the next request, increasing so that later requests go
+  /// first.
+  int nextPriority_{0};
+  QThreadPool pool_{};
+};
+
+} // namespace cygnus
+
+#endif
@@ -0,0 +1,201 @@
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cygnus {
+
+namespace {
+
+struct Event {
+  const char *name;
+  int64_t start;
+  int64_t end;
+};
+
+/// Spans recorded by a single thread. Only the owning thread writes to it, the
+/// buffer itself lives until the process exits so that finish() can still read
+/// the spans of threads which have already stopped. When its thread exits, the
+/// buffer is handed to the next thread which starts recording, after the spans
+/// already in it, so that pools which start fresh threads for every batch of
+/// work don't allocate a buffer for each of them.
+struct Buffer {
+  explicit Buffer(uint32_t tid, bool main)
+      : tid(tid), main(main), events(new Event[Tracer::kBufferSize]) {}
+
+  uint32_t tid;
+  bool main;
+  std::unique_ptr<Event[]> events;
+  /// Total number of spans recorded, the latest kBufferSize of which are kept.
+  std::atomic<size_t> count{0};
+};
+
+const auto epoch = std::chrono::steady_clock::now();
+
+std::mutex buffersMutex{};
+std::vector<std::unique_ptr<Buffer>> buffers{};
+/// Buffers of threads which have exited.
+std::vector<Buffer *> freeBuffers{};
+QString outputPath{};
+
+/// The buffer of the calling thread, returned to freeBuffers when it exits.
+struct ThreadBuffer {
+  Buffer *buffer{nullptr};
+
+  ~ThreadBuffer() {
+    // The main thread keeps its own buffer, so that it is labeled as such.
+    if (buffer && !buffer->main) {
+      std::lock_guard<std::mutex> lock{buffersMutex};
+      freeBuffers.push_back(buffer);
+    }
+  }
+};
+
+thread_local ThreadBuffer threadBuffer{};
+
+Buffer *createBuffer() {
+  const auto *app = QCoreApplication::instance();
+  bool main = app && QThread::currentThread() == app->thread();
+  std::lock_guard<std::mutex> lock{buffersMutex};
+  if (!main && !freeBuffers.empty()) {
+    Buffer *buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return buffer;
+  }
+  buffers.emplace_back(
+      new Buffer{static_cast<uint32_t>(buffers.size() + 1), main});
+  return buffers.back().get();
+}
+
+QByteArray micros(int64_t ns) {
+  return QByteArray::number(ns / 1000.0, 'f', 3);
+}
+
+void appendString(QByteArray &json, const char *str) {
+  json += '"';
+  for (; *str; ++str) {
+    if (*str == '"' || *str == '\\') {
+      json += '\\';
+    }
+    json += *str;
+  }
+  json += '"';
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::enabled_{false};
+
+void Tracer::start(const QString &path) {
+  {
+    std::lock_guard<std::mutex> lock{buffersMutex};
+    outputPath = path;
+    for (auto &buffer : buffers) {
+      buffer->count.store(0, std::memory_order_relaxed);
+    }
+  }
+  qDebug() << "Tracing to:" << path;
+  enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::init(int &argc, char *argv[]) {
+  QString path = QString::fromLocal8Bit(qgetenv("CYGNUS_TRACE"));
+
+  int out = 1;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (std::strncmp(arg, "--trace=", 8) == 0) {
+      path = QString::fromLocal8Bit(arg + 8);
+    } else if (std::strcmp(arg, "--trace") == 0 && i + 1 < argc) {
+      path = QString::fromLocal8Bit(argv[++i]);
+    } else {
+      argv[out++] = argv[i];
+    }
+  }
+  argc = out;
+  argv[argc] = nullptr;
+
+  if (!path.isEmpty()) {
+    start(path);
+  }
+}
+
+void Tracer::finish() {
+  if (!enabled()) {
+    return;
+  }
+  enabled_.store(false, std::memory_order_release);
+
+  QFile file{outputPath};
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Unable to write trace to:" << outputPath;
+    return;
+  }
+  file.write(toJson());
+}
+
+QByteArray Tracer::toJson() {
+  QByteArray json{"{\"displayTimeUnit\":\"ms\",\"traceEvents\":["};
+  bool first = true;
+  auto separate = [&]() {
+    if (!first) {
+      json += ",\n";
+    }
+    first = false;
+  };
+
+  std::lock_guard<std::mutex> lock{buffersMutex};
+  for (const auto &buffer : buffers) {
+    const QByteArray tid = QByteArray::number(static_cast<int>(buffer->tid));
+    separate();
+    json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+    json += tid;
+    json += ",\"args\":{\"name\":\"";
+    json += buffer->main ? QByteArray{"main"} : QByteArray{"thread "} + tid;
+    json += "\"}}";
+
+    size_t count = buffer->count.load(std::memory_order_acquire);
+    size_t begin = count > kBufferSize ? count - kBufferSize : 0;
+    for (size_t i = begin; i < count; ++i) {
+      const Event &event = buffer->events[i % kBufferSize];
+      separate();
+      json += "{\"name\":";
+      appendString(json, event.name);
+      json += ",\"ph\":\"X\",\"pid\":1,\"tid\":";
+      json += tid;
+      json += ",\"ts\":";
+      json += micros(event.start);
+      json += ",\"dur\":";
+      json += micros(event.end - event.start);
+      json += '}';
+    }
+  }
+  json += "]}\n";
+  return json;
+}
+
+int64_t Tracer::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void Tracer::record(const char *name, int64_t start, int64_t end) {
+  Buffer *buffer = threadBuffer.buffer;
+  if (!buffer) {
+    buffer = threadBuffer.buffer = createBuffer();
+  }
+  size_t count = buffer->count.load(std::memory_order_relaxed);
+  buffer->events[count % kBufferSize] = Event{name, start, end};
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+} // namespace cygnus
@@ -0,0 +1,82 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+namespace cygnus {
+
+/// Records scoped spans into per-thread ring buffers and exports them in the
+/// Chrome trace event format, for viewing in chrome://tracing or Perfetto.
+/// Tracing is off by default, and a disabled span costs a single relaxed load.
+class Tracer {
+public:
+  /// Number of spans kept per thread, older spans are overwritten. Threads
+  /// which run one after another share a buffer, and so a thread id in the
+  /// trace.
+  static constexpr size_t kBufferSize = 1 << 16;
+
+  /// \return true if spans are currently being recorded.
+  static inline bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// Start recording, to be written to \p path by finish().
+  static void start(const QString &path);
+
+  /// Enable tracing if the CYGNUS_TRACE environment variable names an output
+  /// file, or if \p argv contains --trace=<file> or --trace <file>.
+  /// The trace arguments are removed from \p argc and \p argv.
+  static void init(int &argc, char *argv[]);
+
+  /// Stop recording and write the trace to the file given to start().
+  /// Spans still open on other threads at this point are not included.
+  static void finish();
+
+  /// \return the recorded spans of every thread as Chrome trace JSON.
+  static QByteArray toJson();
+
+  /// \return the current time in nanoseconds, on the clock used for spans.
+  static int64_t now();
+
+  /// Add a span named \p name, which must be a string literal, to the buffer
+  /// of the calling thread.
+  static void record(const char *name, int64_t start, int64_t end);
+
+private:
+  static std::atomic<bool> enabled_;
+};
+
+/// Records the lifetime of the enclosing scope as a span, if tracing is
+/// enabled when it is constructed.
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name)
+      : name_(name), start_(Tracer::enabled() ? Tracer::now() : -1) {}
+
+  ~TraceSpan() {
+    if (start_ >= 0) {
+      Tracer::record(name_, start_, Tracer::now());
+    }
+  }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *name_;
+  int64_t start_;
+};
+
+} // namespace cygnus
+
+#define CYGNUS_TRACE_CONCAT_(a, b) a##b
+#define CYGNUS_TRACE_CONCAT(a, b) CYGNUS_TRACE_CONCAT_(a, b)
+
+/// Trace the rest of the current scope as a span called \p name.
+#define CYGNUS_TRACE_SPAN(name)                                                \
+  ::cygnus::TraceSpan CYGNUS_TRACE_CONCAT(traceSpan, __LINE__) { name }
+
+#endif
@@ -0,0 +1,91 @@
+#include "UndoStack.h"
+
+#include <QDebug>
+
+#include <cstdint>
+
+namespace cygnus {
+
+UndoStack::UndoStack(size_t capacity) : capacity_(capacity) {}
+
+void UndoStack::clear() {
+  records_.clear();
+  head_ = 0;
+  size_ = 0;
+  groupDepth_ = 0;
+  groupStartPending_ = false;
+  rebusPool_.clear();
+}
+
+void UndoStack::beginGroup() {
+  if (groupDepth_++ == 0) {
+    groupStartPending_ = true;
+  }
+}
+
+void UndoStack::endGroup() {
+  if (groupDepth_ > 0) {
+    --groupDepth_;
+  }
+}
+
+void UndoStack::push(uint8_t row, uint8_t col, char cell,
+                     Puzzle::Markup markup, const QString &rebus) {
+  uint32_t rebusId = rebusPool_.intern(rebus);
+  if (rebusId > UINT16_MAX) {
+    // Out of ids, fall back to storing the single letter in the grid.
+    qWarning() << "Undo rebus pool is full, dropping rebus text";
+    rebusId = 0;
+  }
+
+  Record record{};
+  record.row = row;
+  record.col = col;
+  record.cell = cell;
+  record.markup = markup;
+  record.rebus = static_cast<uint16_t>(rebusId);
+  if (groupDepth_ == 0 || groupStartPending_) {
+    record.flags |= kGroupStart;
+    groupStartPending_ = false;
+  }
+  append(record);
+}
+
+std::vector<UndoStack::Record> UndoStack::popGroup() {
+  std::vector<Record> result{};
+  while (size_ > 0) {
+    const Record record = at(size_ - 1);
+    --size_;
+    result.push_back(record);
+    if (record.flags & kGroupStart) {
+      break;
+    }
+  }
+  return result;
+}
+
+void UndoStack::append(const Record &record) {
+  if (size_ == capacity_) {
+    dropOldestGroup();
+  }
+  if (records_.size() < capacity_) {
+    // Still growing, so the records start at index 0.
+    if (size_ == records_.size()) {
+      records_.push_back(record);
+    } else {
+      records_[size_] = record;
+    }
+  } else {
+    records_[(head_ + size_) % capacity_] = record;
+  }
+  ++size_;
+}
+
+void UndoStack::dropOldestGroup() {
+  do {
+    head_ = (head_ + 1) % records_.size();
+    --size_;
+  } while (size_ > 0 && !(at(0).flags & kGroupStart));
+}
+
+} // namespace cygnus
@@ -0,0 +1,96 @@
+#ifndef UNDOSTACK_H
+#define UNDOSTACK_H
+
+#include "Puzzle.h"
+#include "StringPool.h"
+
+#include <vector>
+
+namespace cygnus {
+
+/// Bounded history of cell edits, used for both undo and redo.
+/// Each edit is stored as a packed 8-byte record in a ring buffer, with rebus
+/// text interned in a StringPool. Records are grouped so that an operation
+/// touching many cells, such as revealing the whole puzzle, is undone in a
+/// single step. When the buffer is full the oldest groups are discarded.
+class UndoStack {
+public:
+  /// State of a single cell, recorded before it was edited.
+  struct Record {
+    uint8_t row;
+    uint8_t col;
+    /// Contents of the grid, lowercase if the entry was penciled in.
+    char cell;
+    Puzzle::Markup markup;
+    /// Id of the rebus text in the string pool, 0 if there is none.
+    uint16_t rebus;
+    uint8_t flags;
+    uint8_t reserved;
+  };
+  static_assert(sizeof(Record) == 8, "Record must stay packed");
+
+  /// Default capacity, large enough to hold a reveal of the largest grid.
+  static constexpr size_t kDefaultCapacity = 1 << 17;
+
+  explicit UndoStack(size_t capacity = kDefaultCapacity);
+
+  inline bool empty() const { return size_ == 0; }
+
+  /// \return the number of records currently stored.
+  inline size_t size() const { return size_; }
+
+  /// \return the estimated bytes of heap used by the records and rebus text.
+  inline size_t memoryUsage() const {
+    return heapBytes(records_) + rebusPool_.memoryUsage();
+  }
+
+  void clear();
+
+  /// Start a group: every record pushed until the matching endGroup() is
+  /// undone together. Groups may be nested, only the outermost one counts.
+  void beginGroup();
+  void endGroup();
+
+  /// Record the state of the cell at (\p row, \p col).
+  /// Outside of a group, the record forms a group of its own.
+  void push(uint8_t row, uint8_t col, char cell, Puzzle::Markup markup,
+            const QString &rebus);
+
+  /// Remove the most recent group.
+  /// \return its records, most recent first.
+  std::vector<Record> popGroup();
+
+  /// \return the rebus text stored in \p record.
+  inline const QString &getRebus(const Record &record) const {
+    return rebusPool_.at(record.rebus);
+  }
+
+private:
+  static constexpr uint8_t kGroupStart = 0x1;
+
+  inline Record &at(size_t i) {
+    return records_[(head_ + i) % records_.size()];
+  }
+
+  void append(const Record &record);
+
+  /// Discard records from the front until the next group starts.
+  void dropOldestGroup();
+
+  size_t capacity_;
+
+  /// Ring buffer of records. Grows up to capacity_, and head_ is 0 until it
+  /// has reached its full size.
+  std::vector<Record> records_{};
+  size_t head_{0};
+  size_t size_{0};
+
+  uint32_t groupDepth_{0};
+  bool groupStartPending_{false};
+
+  StringPool rebusPool_{};
+};
+
+} // namespace cygnus
+
+#endif
@@ -0,0 +1,117 @@
+#include "WorkPool.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cygnus {
+
+namespace {
+
+/// Jobs [begin, end) which haven't been started by a thread yet.
+struct Range {
+  std::mutex mutex{};
+  size_t begin{0};
+  size_t end{0};
+};
+
+/// Take the next job from \p range.
+/// \return false if \p range is empty.
+bool take(Range &range, size_t &job) {
+  std::lock_guard<std::mutex> lock{range.mutex};
+  if (range.begin == range.end) {
+    return false;
+  }
+  job = range.begin++;
+  return true;
+}
+
+/// Move the upper half of the largest range other than \p self into \p self.
+/// \return false if there was no work left to steal.
+bool steal(Range *ranges, unsigned count, unsigned self) {
+  for (;;) {
+    unsigned victim = self;
+    size_t largest = 0;
+    for (unsigned i = 0; i < count; ++i) {
+      if (i == self) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock{ranges[i].mutex};
+      size_t remaining = ranges[i].end - ranges[i].begin;
+      if (remaining > largest) {
+        largest = remaining;
+        victim = i;
+      }
+    }
+    if (victim == self) {
+      return false;
+    }
+
+    size_t begin;
+    size_t end;
+    {
+      std::lock_guard<std::mutex> lock{ranges[victim].mutex};
+      Range &range = ranges[victim];
+      if (range.begin == range.end) {
+        // Finished in the meantime, look again.
+        continue;
+      }
+      begin = range.begin + (range.end - range.begin) / 2;
+      end = range.end;
+      range.end = begin;
+    }
+
+    std::lock_guard<std::mutex> lock{ranges[self].mutex};
+    ranges[self].begin = begin;
+    ranges[self].end = end;
+    return true;
+  }
+}
+
+} // namespace
+
+WorkPool::WorkPool(unsigned threads)
+    : threads_(threads) {
+  if (threads_ == 0) {
+    threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+void WorkPool::run(size_t count, const std::function<void(size_t)> &job) {
+  if (count == 0) {
+    return;
+  }
+  const unsigned threads =
+      static_cast<unsigned>(std::min<size_t>(threads_, count));
+
+  std::unique_ptr<Range[]> ranges{new Range[threads]};
+  for (unsigned i = 0; i < threads; ++i) {
+    ranges[i].begin = count * i / threads;
+    ranges[i].end = count * (i + 1) / threads;
+  }
+
+  auto worker = [&](unsigned self) {
+    size_t next;
+    for (;;) {
+      if (take(ranges[self], next)) {
+        job(next);
+      } else if (!steal(ranges.get(), threads, self)) {
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool{};
+  pool.reserve(threads - 1);
+  for (unsigned i = 1; i < threads; ++i) {
+    pool.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto &thread : pool) {
+    thread.join();
+  }
+}
+
+} // namespace cygnus
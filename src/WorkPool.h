@@ -0,0 +1,32 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <cstddef>
+#include <functional>
+
+namespace cygnus {
+
+/// Runs batches of independent jobs across a fixed number of threads.
+/// Each batch is split into one contiguous range of jobs per thread. A thread
+/// which finishes its range steals the upper half of the largest remaining
+/// range, so uneven jobs (such as files of very different sizes) still keep
+/// every thread busy until the end of the batch.
+class WorkPool {
+public:
+  /// Use \p threads threads, or one per core if it is 0.
+  explicit WorkPool(unsigned threads = 0);
+
+  inline unsigned threadCount() const { return threads_; }
+
+  /// Call \p job with every index in [0, \p count), and return once all of
+  /// them have finished. \p job is called concurrently from several threads,
+  /// including the calling thread.
+  void run(size_t count, const std::function<void(size_t)> &job);
+
+private:
+  unsigned threads_;
+};
+
+} // namespace cygnus
+
+#endif
@@ -0,0 +1,323 @@
+#include "Benchmark.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSysInfo>
+
+#include <numeric>
+#include <unordered_map>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace cygnus {
+namespace bench {
+
+/// Version of the JSON format, bumped when results stop being comparable.
+/// Version 1 kept memory results as "memory" with a "bytes" field, version 2
+/// keeps them and counts as "budgets" with a "value" field.
+static constexpr int kFormatVersion = 2;
+
+/// Written by escape(), never read.
+const void *volatile escapeSink = nullptr;
+
+void escape(const void *value) { escapeSink = value; }
+
+/// \return a human readable form of \p ns nanoseconds.
+static QString formatTime(double ns) {
+  if (ns < 1e3) {
+    return QString("%1 ns").arg(ns, 0, 'f', 1);
+  }
+  if (ns < 1e6) {
+    return QString("%1 us").arg(ns / 1e3, 0, 'f', 2);
+  }
+  if (ns < 1e9) {
+    return QString("%1 ms").arg(ns / 1e6, 0, 'f', 2);
+  }
+  return QString("%1 s").arg(ns / 1e9, 0, 'f', 2);
+}
+
+qint64 cpuTimeNs() {
+#ifdef Q_OS_WIN
+  FILETIME creation, exit, kernel, user;
+  GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+  auto toNs = [](const FILETIME &time) {
+    return ((qint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+  };
+  return toNs(kernel) + toNs(user);
+#else
+  timespec time{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return qint64(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+}
+
+bool Runner::enabled(const QString &name) const {
+  if (!options_.filter.isEmpty() && !name.contains(options_.filter)) {
+    return false;
+  }
+  if (options_.list) {
+    printf("%s\n", name.toUtf8().constData());
+    return false;
+  }
+  return true;
+}
+
+/// \return the \p q quantile of \p sorted.
+static double percentile(const std::vector<double> &sorted, double q) {
+  size_t idx = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+void Runner::record(const QString &name, uint64_t iterations,
+                    std::vector<double> samples) {
+  if (samples.empty()) {
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  Result result{};
+  result.name = name;
+  result.iterations = iterations;
+  result.min = samples.front();
+  result.median = percentile(samples, 0.5);
+  result.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                static_cast<double>(samples.size());
+  result.p90 = percentile(samples, 0.9);
+  result.p99 = percentile(samples, 0.99);
+  results_.push_back(result);
+
+  printf("%-40s %12s %12s  x%llu\n", name.toUtf8().constData(),
+         formatTime(result.median).toUtf8().constData(),
+         formatTime(result.min).toUtf8().constData(),
+         static_cast<unsigned long long>(iterations));
+  fflush(stdout);
+}
+
+/// \return a human readable form of \p bytes.
+static QString formatBytes(double bytes) {
+  if (bytes < 1024) {
+    return QString("%1 B").arg(bytes, 0, 'f', 0);
+  }
+  if (bytes < 1024 * 1024) {
+    return QString("%1 KiB").arg(bytes / 1024, 0, 'f', 1);
+  }
+  return QString("%1 MiB").arg(bytes / (1024 * 1024), 0, 'f', 2);
+}
+
+/// \return a human readable form of \p value, in the unit of \p result.
+static QString formatValue(const BudgetResult &result, double value) {
+  return result.bytes ? formatBytes(value) : QString::number(value, 'f', 0);
+}
+
+void Runner::recordMemory(const QString &name, uint64_t bytes,
+                          uint64_t budget) {
+  recordBudget(BudgetResult{name, bytes, budget, true});
+}
+
+void Runner::recordCount(const QString &name, uint64_t count,
+                         uint64_t budget) {
+  recordBudget(BudgetResult{name, count, budget, false});
+}
+
+void Runner::recordBudget(BudgetResult result) {
+  if (!enabled(result.name)) {
+    return;
+  }
+  printf("%-40s %12s %12s%s\n", result.name.toUtf8().constData(),
+         formatValue(result, result.value).toUtf8().constData(),
+         formatValue(result, result.budget).toUtf8().constData(),
+         result.value > result.budget ? "  OVER BUDGET" : "");
+  fflush(stdout);
+  budgets_.push_back(std::move(result));
+}
+
+int Runner::overBudget() const {
+  return static_cast<int>(std::count_if(
+      budgets_.begin(), budgets_.end(),
+      [](const BudgetResult &b) { return b.value > b.budget; }));
+}
+
+QJsonDocument Runner::toJson() const {
+  QJsonArray benchmarks{};
+  for (const Result &result : results_) {
+    QJsonObject obj{};
+    obj["name"] = result.name;
+    obj["iterations"] = static_cast<double>(result.iterations);
+    obj["min_ns"] = result.min;
+    obj["median_ns"] = result.median;
+    obj["mean_ns"] = result.mean;
+    obj["p90_ns"] = result.p90;
+    obj["p99_ns"] = result.p99;
+    benchmarks.append(obj);
+  }
+
+  QJsonArray budgets{};
+  for (const BudgetResult &result : budgets_) {
+    QJsonObject obj{};
+    obj["name"] = result.name;
+    obj["value"] = static_cast<double>(result.value);
+    obj["budget"] = static_cast<double>(result.budget);
+    obj["unit"] = result.bytes ? "bytes" : "count";
+    budgets.append(obj);
+  }
+
+  QJsonObject context{};
+  context["format"] = kFormatVersion;
+  context["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+  context["host"] = QSysInfo::machineHostName();
+  context["cpu"] = QSysInfo::currentCpuArchitecture();
+  context["os"] = QSysInfo::prettyProductName();
+  context["qt"] = QString(qVersion());
+#ifdef QT_NO_DEBUG
+  context["build"] = "release";
+#else
+  context["build"] = "debug";
+#endif
+
+  QJsonObject root{};
+  root["context"] = context;
+  root["benchmarks"] = benchmarks;
+  root["budgets"] = budgets;
+  return QJsonDocument{root};
+}
+
+int Runner::compare(const QJsonDocument &baseline, double threshold) const {
+  const QJsonObject root = baseline.object();
+  const int format = root["context"].toObject()["format"].toInt(1);
+  if (format > kFormatVersion) {
+    fprintf(stderr,
+            "Baseline is in format %d, newer than %d, and is compared as far "
+            "as it can be read\n",
+            format, kFormatVersion);
+  }
+
+  std::unordered_map<std::string, double> before{};
+  for (const auto &value : root["benchmarks"].toArray()) {
+    QJsonObject obj = value.toObject();
+    before[obj["name"].toString().toStdString()] =
+        obj["median_ns"].toDouble();
+  }
+
+  int regressions = 0;
+  printf("\n%-40s %12s %12s %8s\n", "benchmark", "baseline", "current",
+         "change");
+  for (const Result &result : results_) {
+    auto it = before.find(result.name.toStdString());
+    if (it == before.end() || it->second <= 0) {
+      printf("%-40s %12s %12s %8s\n", result.name.toUtf8().constData(), "-",
+             formatTime(result.median).toUtf8().constData(), "new");
+      continue;
+    }
+    const double ratio = result.median / it->second;
+    const char *status = "";
+    if (ratio > 1 + threshold) {
+      status = "  REGRESSION";
+      ++regressions;
+    } else if (ratio < 1 - threshold) {
+      status = "  improved";
+    }
+    printf("%-40s %12s %12s %+7.1f%%%s\n", result.name.toUtf8().constData(),
+           formatTime(it->second).toUtf8().constData(),
+           formatTime(result.median).toUtf8().constData(), (ratio - 1) * 100,
+           status);
+  }
+
+  // Version 1 had only memory results, under other names.
+  const bool legacy = format < 2;
+  std::unordered_map<std::string, double> beforeValues{};
+  for (const auto &value : root[legacy ? "memory" : "budgets"].toArray()) {
+    QJsonObject obj = value.toObject();
+    beforeValues[obj["name"].toString().toStdString()] =
+        obj[legacy ? "bytes" : "value"].toDouble();
+  }
+  for (const BudgetResult &result : budgets_) {
+    auto it = beforeValues.find(result.name.toStdString());
+    if (it == beforeValues.end() || it->second <= 0) {
+      printf("%-40s %12s %12s %8s\n", result.name.toUtf8().constData(), "-",
+             formatValue(result, result.value).toUtf8().constData(), "new");
+      continue;
+    }
+    const double ratio = result.value / it->second;
+    const char *status = "";
+    if (ratio > 1 + threshold) {
+      status = "  REGRESSION";
+      ++regressions;
+    } else if (ratio < 1 - threshold) {
+      status = "  improved";
+    }
+    printf("%-40s %12s %12s %+7.1f%%%s\n", result.name.toUtf8().constData(),
+           formatValue(result, it->second).toUtf8().constData(),
+           formatValue(result, result.value).toUtf8().constData(),
+           (ratio - 1) * 100, status);
+  }
+  printf("\n%d regression(s) over %.0f%%\n", regressions, threshold * 100);
+  return regressions;
+}
+
+void addOptions(QCommandLineParser &parser) {
+  parser.addHelpOption();
+  parser.addOptions({
+      {{"f", "filter"}, "Only run benchmarks containing text.", "text"},
+      {"list", "List benchmarks without running them."},
+      {"samples", "Samples per benchmark.", "n", "5"},
+      {"min-time", "Minimum time per sample.", "ms", "20"},
+      {"json", "Write results as JSON to file.", "file"},
+      {"baseline", "Compare results with a JSON file from --json.", "file"},
+      {"threshold", "Slowdown reported as a regression.", "percent", "10"},
+  });
+}
+
+Runner::Options runnerOptions(const QCommandLineParser &parser) {
+  Runner::Options options{};
+  options.filter = parser.value("filter");
+  options.list = parser.isSet("list");
+  options.samples = std::max(1, parser.value("samples").toInt());
+  options.minSampleNs = parser.value("min-time").toLongLong() * 1000000;
+  return options;
+}
+
+int finish(const Runner &runner, const QCommandLineParser &parser) {
+  if (parser.isSet("list")) {
+    return 0;
+  }
+
+  int result = 0;
+  if (runner.overBudget() > 0) {
+    fprintf(stderr, "%d result(s) over their memory budget\n",
+            runner.overBudget());
+    result = 1;
+  }
+
+  if (parser.isSet("json")) {
+    QFile file{parser.value("json")};
+    if (!file.open(QIODevice::WriteOnly)) {
+      qCritical() << "Unable to write" << file.fileName();
+      return 2;
+    }
+    file.write(runner.toJson().toJson());
+  }
+
+  if (parser.isSet("baseline")) {
+    QFile file{parser.value("baseline")};
+    if (!file.open(QIODevice::ReadOnly)) {
+      qCritical() << "Unable to read" << file.fileName();
+      return 2;
+    }
+    QJsonDocument baseline = QJsonDocument::fromJson(file.readAll());
+    double threshold = parser.value("threshold").toDouble() / 100;
+    if (runner.compare(baseline, threshold) > 0) {
+      result = 1;
+    }
+  }
+
+  return result;
+}
+
+} // namespace bench
+} // namespace cygnus
@@ -0,0 +1,159 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QString>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace cygnus {
+namespace bench {
+
+/// Defined out of line, so the compiler must assume it reads \p value.
+void escape(const void *value);
+
+/// Prevent the compiler from optimizing away the computation of \p value.
+template <typename T> inline void keep(const T &value) { escape(&value); }
+
+/// \return the CPU time used by the process so far, in nanoseconds.
+qint64 cpuTimeNs();
+
+/// Timing of a single benchmark, in nanoseconds per operation.
+struct Result {
+  QString name;
+  /// Operations per sample.
+  uint64_t iterations;
+  double min;
+  double median;
+  double mean;
+  double p90;
+  double p99;
+};
+
+/// A measurement checked against a fixed budget, such as the memory used by
+/// a data structure or the number of allocations made by an operation.
+struct BudgetResult {
+  QString name;
+  uint64_t value;
+  uint64_t budget;
+  /// Whether value and budget are in bytes, rather than a plain count.
+  bool bytes;
+};
+
+/// Runs benchmarks and collects their results.
+/// Each benchmark is calibrated so that one sample takes at least
+/// minSampleNs, then timed over several samples. The median is the number
+/// used for comparisons, as it is the least sensitive to noise.
+class Runner {
+public:
+  struct Options {
+    /// Only run benchmarks whose name contains this.
+    QString filter{};
+    int samples{5};
+    qint64 minSampleNs{20 * 1000 * 1000};
+    /// Print names instead of running.
+    bool list{false};
+  };
+
+  explicit Runner(Options options) : options_(std::move(options)) {}
+
+  /// Measure \p op, which performs a single operation per call.
+  template <typename F> void run(const QString &name, F &&op) {
+    runBatched(name, 1, op);
+  }
+
+  /// Measure \p op, which performs \p ops operations per call.
+  /// Used for operations too cheap to time one call at a time.
+  template <typename F>
+  void runBatched(const QString &name, uint64_t ops, F &&op) {
+    if (!enabled(name)) {
+      return;
+    }
+
+    // Double the batch size until a batch takes long enough to time.
+    uint64_t iterations = 1;
+    for (;;) {
+      qint64 elapsed = time(op, iterations);
+      if (elapsed >= options_.minSampleNs) {
+        break;
+      }
+      iterations *= elapsed * 4 < options_.minSampleNs ? 4 : 2;
+    }
+
+    std::vector<double> samples{};
+    for (int i = 0; i < options_.samples; ++i) {
+      samples.push_back(double(time(op, iterations)) / (iterations * ops));
+    }
+    record(name, iterations * ops, std::move(samples));
+  }
+
+  /// \return true if the benchmark \p name should be run.
+  /// When listing benchmarks, prints \p name instead.
+  bool enabled(const QString &name) const;
+
+  /// Add a result for \p name measured elsewhere, from \p samples of
+  /// \p iterations operations each, in nanoseconds per operation.
+  void record(const QString &name, uint64_t iterations,
+              std::vector<double> samples);
+
+  /// Add a memory measurement of \p bytes for \p name, which is reported as
+  /// over budget if it exceeds \p budget.
+  void recordMemory(const QString &name, uint64_t bytes, uint64_t budget);
+
+  /// Add a count of \p count for \p name, such as a number of allocations,
+  /// which is reported as over budget if it exceeds \p budget.
+  void recordCount(const QString &name, uint64_t count, uint64_t budget);
+
+  inline const std::vector<Result> &results() const { return results_; }
+
+  /// \return the number of memory and count results which exceeded their
+  /// budget.
+  int overBudget() const;
+
+  /// \return the results in the JSON format read by compare().
+  QJsonDocument toJson() const;
+
+  /// Print a comparison of the results with \p baseline, a document
+  /// produced by toJson(), in this format or an older one.
+  /// \param threshold fractional slowdown of the median, or growth in memory
+  /// or counts, which is reported as a regression.
+  /// \return the number of regressions.
+  int compare(const QJsonDocument &baseline, double threshold) const;
+
+private:
+  template <typename F> static qint64 time(F &op, uint64_t iterations) {
+    QElapsedTimer timer{};
+    timer.start();
+    for (uint64_t i = 0; i < iterations; ++i) {
+      op();
+    }
+    return timer.nsecsElapsed();
+  }
+
+  Options options_;
+  std::vector<Result> results_{};
+  void recordBudget(BudgetResult result);
+
+  std::vector<BudgetResult> budgets_{};
+};
+
+/// Add the options shared by the benchmark executables to \p parser.
+void addOptions(QCommandLineParser &parser);
+
+/// \return the runner options given to a parser set up by addOptions().
+Runner::Options runnerOptions(const QCommandLineParser &parser);
+
+/// Write the results to JSON and compare them with a baseline, if requested
+/// on the command line.
+/// \return the exit code for the benchmark executable: 1 if there were
+/// regressions or results over budget, 2 if the files couldn't be accessed.
+int finish(const Runner &runner, const QCommandLineParser &parser);
+
+} // namespace bench
+} // namespace cygnus
+
+#endif
@@ -0,0 +1,334 @@
+#include "Benchmark.h"
+#include "ClueDatabase.h"
+#include "ClueIndex.h"
+#include "GridStatistics.h"
+#include "Library.h"
+#include "Metrics.h"
+#include "Puzzle.h"
+#include "PuzzleGenerator.h"
+#include "SimilarityIndex.h"
+#include "UndoStack.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <functional>
+
+namespace cygnus {
+namespace bench {
+namespace {
+
+/// Sizes which every benchmark is run at: the common daily and Sunday
+/// sizes, a large variety puzzle and the largest grid the format allows.
+const uint8_t kSizes[] = {15, 21, 50, 255};
+
+/// Memory budgets, with headroom over the current layouts so that only real
+/// regressions exceed them.
+/// Grids: the cell data and three single byte grids, in one block.
+constexpr uint64_t kGridBytesPerCell = 16;
+/// Undo records are 8 bytes, doubled for the vector's growth.
+constexpr uint64_t kUndoBytesPerRecord = 16;
+constexpr uint64_t kFixedBytes = 4096;
+
+/// Allocations through operator new to load a puzzle of any size: the
+/// Puzzle, its block of cells, the two clue lists and the rebus string pool.
+/// Debug output allocates as well, unless it is compiled out.
+#ifdef QT_NO_DEBUG_OUTPUT
+constexpr uint64_t kLoadAllocations = 8;
+#else
+constexpr uint64_t kLoadAllocations = 32;
+#endif
+
+/// Files in the library benchmark, enough for a scan to use every core.
+constexpr size_t kLibraryFiles = 2000;
+/// Times the index is loaded, as loading it once takes only milliseconds.
+constexpr size_t kLibraryLoads = 5;
+
+/// \return a valid, fully solved \p size x \p size puzzle without extensions,
+/// so that checks scan every cell.
+QByteArray makePuzzle(uint8_t size) {
+  PuzzleGenerator::Options options{};
+  options.width = size;
+  options.height = size;
+  options.fillDensity = 1.0;
+  options.extensions = 0;
+  return PuzzleGenerator::generate(options, 1);
+}
+
+void runSuite(Runner &runner, uint8_t size) {
+  const QByteArray file = makePuzzle(size);
+  const auto puzzle = Puzzle::loadFromFile(file);
+  if (!puzzle) {
+    qFatal("Unable to load the %dx%d benchmark puzzle", size, size);
+  }
+  const QString suffix = QString("/%1x%1").arg(size);
+  const QByteArray text = file.mid(0x34 + 2 * size * size);
+  const uint16_t numClues = puzzle->getNumClues();
+  const auto &solution = puzzle->getSolution();
+  const auto &grid = puzzle->getGrid();
+  const auto type = Puzzle::PuzzleType::NORMAL;
+  const auto state = Puzzle::SolutionState::UNLOCKED;
+
+  // Micro benchmarks.
+  runner.run("validatePuzzle" + suffix,
+             [&] { keep(Puzzle::validatePuzzle(file)); });
+  runner.run("checksum/bytes" + suffix, [&] {
+    keep(Puzzle::checksum(file.cbegin(), file.cend()));
+  });
+  runner.run("checksum/grid" + suffix,
+             [&] { keep(Puzzle::checksum(solution)); });
+  runner.run("textChecksum" + suffix,
+             [&] { keep(Puzzle::textChecksum(numClues, text)); });
+  runner.run("magicChecksum" + suffix, [&] {
+    keep(Puzzle::magicChecksum(size, size, numClues, type, state, solution,
+                               grid, text));
+  });
+  runner.run("globalChecksum" + suffix, [&] {
+    keep(Puzzle::globalChecksum(size, size, numClues, type, state, solution,
+                                grid, text));
+  });
+  runner.run("allCorrect" + suffix, [&] { keep(puzzle->allCorrect()); });
+  runner.run("fingerprint" + suffix,
+             [&] { keep(Puzzle::fingerprint(file)); });
+  runner.run("similarity/signature" + suffix,
+             [&] { keep(SimilarityIndex::signature(*puzzle)); });
+  runner.run("gridStatistics" + suffix,
+             [&] { keep(GridStatistics::compute(*puzzle)); });
+
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    const auto &clues = puzzle->getClues(dir);
+    const QString name = dir == Direction::ACROSS ? "across" : "down";
+    runner.runBatched("getClueIdxByNum/" + name + suffix, clues.size(), [&] {
+      for (const auto &clue : clues) {
+        keep(puzzle->getClueIdxByNum(dir, clue.num));
+      }
+    });
+    runner.runBatched("getFirstBlank/" + name + suffix, clues.size(), [&] {
+      for (const auto &clue : clues) {
+        keep(puzzle->getFirstBlank(clue));
+      }
+    });
+  }
+
+  // Macro benchmarks.
+  runner.run("loadFromFile" + suffix,
+             [&] { keep(Puzzle::loadFromFile(file)); });
+  runner.run("serialize" + suffix, [&] { keep(puzzle->serialize()); });
+  const QByteArray snapshot = puzzle->snapshot();
+  runner.run("snapshot" + suffix, [&] { keep(puzzle->snapshot()); });
+  runner.run("fromSnapshot" + suffix,
+             [&] { keep(Puzzle::fromSnapshot(snapshot)); });
+  runner.run("roundTrip" + suffix, [&] {
+    auto loaded = Puzzle::loadFromFile(file);
+    keep(loaded->allCorrect());
+    keep(loaded->serialize());
+  });
+
+  // Memory.
+  const MemoryUsage usage = puzzle->memoryUsage();
+  const uint64_t cells = uint64_t(size) * size;
+  const uint64_t gridBudget = kGridBytesPerCell * cells;
+  runner.recordMemory("memory/puzzle.grids" + suffix,
+                      usage.bytes("puzzle.grids"), gridBudget);
+  runner.recordMemory("memory/puzzle" + suffix, usage.total(),
+                      gridBudget + 2 * file.size() + kFixedBytes);
+
+  // Allocations, which must not grow with the size of the puzzle.
+  if (Metrics::countsAllocations()) {
+    const uint64_t allocations = Metrics::threadAllocations();
+    keep(Puzzle::loadFromFile(file));
+    runner.recordCount("allocations/loadFromFile" + suffix,
+                       Metrics::threadAllocations() - allocations,
+                       kLoadAllocations);
+  }
+
+  // Undo history after revealing the whole grid, one record per cell.
+  UndoStack undo{};
+  undo.beginGroup();
+  for (uint8_t row = 0; row < size; ++row) {
+    for (uint8_t col = 0; col < size; ++col) {
+      undo.push(row, col, grid[row][col], Puzzle::DefaultTag, QString{});
+    }
+  }
+  undo.endGroup();
+  runner.recordMemory("memory/undo" + suffix, undo.memoryUsage(),
+                      kUndoBytesPerRecord * cells + kFixedBytes);
+}
+
+/// Write \p count generated puzzles named 0.puz, 1.puz... to \p dir.
+/// \return their paths.
+QStringList writePuzzles(const QString &dir, size_t count) {
+  QDir{}.mkpath(dir);
+  PuzzleGenerator::Options options{};
+  options.fillDensity = 0.5;
+  QStringList paths{};
+  for (size_t i = 0; i < count; ++i) {
+    QFile file{QString("%1/%2.puz").arg(dir).arg(i)};
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(PuzzleGenerator::generate(options, i)) < 0) {
+      qFatal("Unable to write %s", qPrintable(file.fileName()));
+    }
+    paths.push_back(file.fileName());
+  }
+  return paths;
+}
+
+/// Time a cold scan of a library of generated puzzles, which reads every file,
+/// and a warm start, which only reads the index.
+void runLibrarySuite(Runner &runner) {
+  const bool scan = runner.enabled("library/scan");
+  const bool load = runner.enabled("library/loadIndex");
+  if (!scan && !load) {
+    return;
+  }
+
+  QTemporaryDir dir{};
+  const QString puzzles = dir.filePath("puzzles");
+  writePuzzles(puzzles, kLibraryFiles);
+  const QString index = dir.filePath("library.index");
+
+  {
+    Library library{index};
+    QEventLoop loop{};
+    QObject::connect(&library, &Library::scanningChanged, &loop,
+                     [&](bool scanning) {
+                       if (!scanning) {
+                         loop.quit();
+                       }
+                     });
+    QElapsedTimer timer{};
+    timer.start();
+    library.addDirectory(puzzles);
+    loop.exec();
+    const double ns = static_cast<double>(timer.nsecsElapsed());
+    if (library.entries().size() != kLibraryFiles) {
+      qFatal("Library scan found %zu files", library.entries().size());
+    }
+    if (scan) {
+      runner.record("library/scan", kLibraryFiles, {ns / kLibraryFiles});
+    }
+  }
+
+  if (load) {
+    std::vector<double> samples{};
+    for (size_t i = 0; i < kLibraryLoads; ++i) {
+      QElapsedTimer timer{};
+      timer.start();
+      Library library{index};
+      keep(library.entries().size());
+      samples.push_back(static_cast<double>(timer.nsecsElapsed()) /
+                        kLibraryFiles);
+    }
+    runner.record("library/loadIndex", kLibraryFiles, std::move(samples));
+  }
+}
+
+/// Time building a clue index and a clue database of the library
+/// benchmark's puzzles, queries of each kind against them, and a search for
+/// puzzles similar to one of them.
+void runCorpusSuite(Runner &runner) {
+  const QStringList names{"clueIndex/build",        "clueIndex/search/word",
+                          "clueIndex/search/prefix", "clueIndex/search/answer",
+                          "clueDatabase/build",     "clueDatabase/lookup",
+                          "similarity/query"};
+  if (std::none_of(names.begin(), names.end(),
+                   [&](const QString &name) { return runner.enabled(name); })) {
+    return;
+  }
+
+  QTemporaryDir dir{};
+  const QStringList paths = writePuzzles(dir.filePath("puzzles"),
+                                         kLibraryFiles);
+  auto timeBuild = [&](const QString &name,
+                       const std::function<bool()> &build) {
+    QElapsedTimer timer{};
+    timer.start();
+    if (!build()) {
+      qFatal("Unable to run %s", qPrintable(name));
+    }
+    if (runner.enabled(name)) {
+      runner.record(name, kLibraryFiles,
+                    {static_cast<double>(timer.nsecsElapsed()) /
+                     kLibraryFiles});
+    }
+  };
+
+  const QString indexPath = dir.filePath("clues.index");
+  const QString databasePath = dir.filePath("clues.db");
+  timeBuild("clueIndex/build",
+            [&] { return ClueIndex::build(paths, indexPath); });
+  timeBuild("clueDatabase/build",
+            [&] { return ClueDatabase::build(paths, databasePath); });
+  ClueIndex index{};
+  ClueDatabase database{};
+  if (!index.open(indexPath) || !database.open(databasePath)) {
+    qFatal("Unable to open the clue index or database");
+  }
+
+  // Queries built from the first clue of the first puzzle, so that each of
+  // them has hits.
+  QFile file{paths.front()};
+  file.open(QIODevice::ReadOnly);
+  const auto puzzle = Puzzle::loadFromFile(file.readAll());
+  const Clue &clue = puzzle->getClues(Direction::ACROSS).front();
+  const QString word = puzzle->getClueText(clue).split(' ').front();
+  const QByteArray answer = puzzle->getAnswer(clue);
+  // The answer, with every other letter replaced by a wildcard.
+  QByteArray pattern = answer;
+  for (int i = 1; i < pattern.size(); i += 2) {
+    pattern[i] = '?';
+  }
+  runner.run("clueIndex/search/word", [&] { keep(index.search(word)); });
+  runner.run("clueIndex/search/prefix",
+             [&] { keep(index.search(word.left(2) + "*")); });
+  const QString answerQuery = "answer:" + QString::fromLatin1(pattern);
+  runner.run("clueIndex/search/answer",
+             [&] { keep(index.search(answerQuery)); });
+  runner.run("clueDatabase/lookup", [&] { keep(database.lookup(answer)); });
+
+  if (runner.enabled("similarity/query")) {
+    SimilarityIndex similarity{};
+    for (const QString &path : paths) {
+      QFile in{path};
+      in.open(QIODevice::ReadOnly);
+      const auto loaded = Puzzle::loadFromFile(in.readAll());
+      similarity.add(loaded ? SimilarityIndex::signature(*loaded)
+                            : Signature{});
+    }
+    const Signature signature = SimilarityIndex::signature(*puzzle);
+    runner.run("similarity/query",
+               [&] { keep(similarity.query(signature)); });
+  }
+}
+
+} // namespace
+} // namespace bench
+} // namespace cygnus
+
+int main(int argc, char *argv[]) {
+  using namespace cygnus::bench;
+
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("cygnus-bench");
+  QLoggingCategory::setFilterRules("default.debug=false");
+
+  QCommandLineParser parser{};
+  parser.setApplicationDescription(
+      "Benchmarks for parsing, serializing and checking puzzles.");
+  addOptions(parser);
+  parser.process(app);
+
+  Runner runner{runnerOptions(parser)};
+  for (uint8_t size : kSizes) {
+    runSuite(runner, size);
+  }
+  runLibrarySuite(runner);
+  runCorpusSuite(runner);
+  return finish(runner, parser);
+}
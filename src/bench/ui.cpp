@@ -0,0 +1,453 @@
+#include "Benchmark.h"
+#include "FilledLabel.h"
+#include "MainWindow.h"
+#include "Metrics.h"
+#include "PuzzleGenerator.h"
+#include "PuzzleLoader.h"
+#include "ThumbnailCache.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QInputDialog>
+#include <QListWidget>
+#include <QLoggingCategory>
+#include <QMessageBox>
+#include <QTemporaryDir>
+
+#include <random>
+
+namespace cygnus {
+namespace bench {
+namespace {
+
+/// Memory budgets, with headroom over the current estimates.
+/// Each cell is three widgets and a layout.
+constexpr uint64_t kWidgetBytesPerCell = 4096;
+/// The puzzle and clue lists, per cell of the grid.
+constexpr uint64_t kWindowBytesPerCell = 256;
+/// The window itself and the undo history built up by the session.
+constexpr uint64_t kWindowFixedBytes = 1 << 20;
+
+/// The heap allocations made while building a window and loading a puzzle
+/// into it are budgeted against a baseline measured in the same run, since
+/// the allocations Qt makes for a widget depend on its version and style:
+/// the window with no puzzle, and plain widgets built like a cell and a clue
+/// list item, measured by measureBaseline(). A grid has at most one clue per
+/// cell, so the budget is the empty window, plus a cell and a clue item per
+/// cell, with a quarter of headroom. Anything the window adds per cell beyond
+/// those, such as extra children or style data, exceeds it.
+/// The baseline is reported as allocations/baseline/* with every run.
+constexpr uint64_t kWindowAllocationHeadroomPercent = 125;
+/// Cells built for the baseline, enough that the cost of their container is
+/// lost in the average.
+constexpr uint64_t kBaselineCells = 225;
+
+/// Allocations of the parts a window is made of, see
+/// kWindowAllocationHeadroomPercent.
+struct AllocationBaseline {
+  /// A shown window with no puzzle, its menus and actions.
+  uint64_t window;
+  /// A widget with a grid layout, a label and a filled label, in a grid.
+  uint64_t cell;
+  /// An item of a clue list.
+  uint64_t clue;
+
+  /// \return the budget for a window showing a puzzle of \p cells cells.
+  inline uint64_t budget(uint64_t cells) const {
+    return (window + (cell + clue) * cells) *
+           kWindowAllocationHeadroomPercent / 100;
+  }
+};
+
+/// A single input to replay: either a key press, or an action which is
+/// normally triggered through a shortcut.
+struct Step {
+  int key;
+  Qt::KeyboardModifiers modifiers;
+  QAction *action;
+};
+
+using Script = std::vector<Step>;
+
+/// Weighted choice of the next step in a script.
+struct Choice {
+  uint32_t weight;
+  int key;
+  Qt::KeyboardModifiers modifiers;
+  /// Undo or redo instead of a key.
+  int history;
+};
+
+/// Deterministic scripts of key presses.
+class ScriptBuilder {
+public:
+  ScriptBuilder(QAction *undo, QAction *redo, uint32_t seed)
+      : undo_(undo), redo_(redo), engine_(seed) {}
+
+  Script build(const std::vector<Choice> &choices, size_t length) {
+    uint32_t total = 0;
+    for (const Choice &choice : choices) {
+      total += choice.weight;
+    }
+    Script script{};
+    script.reserve(length);
+    while (script.size() < length) {
+      uint32_t pick = below(total);
+      for (const Choice &choice : choices) {
+        if (pick < choice.weight) {
+          script.push_back(step(choice));
+          break;
+        }
+        pick -= choice.weight;
+      }
+    }
+    return script;
+  }
+
+private:
+  inline uint32_t below(uint32_t n) {
+    return static_cast<uint32_t>((uint64_t{engine_()} * n) >> 32);
+  }
+
+  Step step(const Choice &choice) {
+    if (choice.history != 0) {
+      return Step{0, Qt::NoModifier, choice.history < 0 ? undo_ : redo_};
+    }
+    // Qt::Key_A stands for any letter.
+    int key = choice.key == Qt::Key_A ? Qt::Key_A + below(26) : choice.key;
+    return Step{key, choice.modifiers, nullptr};
+  }
+
+  QAction *undo_;
+  QAction *redo_;
+  std::mt19937 engine_;
+};
+
+/// Closes dialogs opened while replaying, as a user would.
+/// Rebus entry dialogs are filled in, message boxes are dismissed.
+class DialogDriver : public QObject {
+public:
+  bool eventFilter(QObject *obj, QEvent *event) override {
+    if (event->type() != QEvent::Show) {
+      return false;
+    }
+    if (auto *input = qobject_cast<QInputDialog *>(obj)) {
+      QTimer::singleShot(0, input, [input] {
+        input->setTextValue("REBUS");
+        input->accept();
+      });
+    } else if (auto *box = qobject_cast<QMessageBox *>(obj)) {
+      QTimer::singleShot(0, box, [box] { box->accept(); });
+    }
+    return false;
+  }
+};
+
+/// \return the action of \p window triggered by \p shortcut.
+QAction *findAction(MainWindow &window, QKeySequence::StandardKey shortcut) {
+  const QKeySequence sequence{shortcut};
+  for (QAction *action : window.findChildren<QAction *>()) {
+    if (action->shortcuts().contains(sequence)) {
+      return action;
+    }
+  }
+  qFatal("No action for shortcut %s", qPrintable(sequence.toString()));
+  return nullptr;
+}
+
+/// Replay \p script and record the latency of each step, from delivering
+/// the event until the window has updated and painted.
+/// The per-frame coalescing of view updates is bypassed by flushing after
+/// every step, so each step pays the full cost of its view update.
+void replay(Runner &runner, MainWindow &window, const QString &name,
+            const Script &script) {
+  if (!runner.enabled(name)) {
+    return;
+  }
+
+  std::vector<double> latencies{};
+  latencies.reserve(script.size());
+  const qint64 cpuStart = cpuTimeNs();
+  for (const Step &step : script) {
+    QElapsedTimer timer{};
+    timer.start();
+    if (step.action) {
+      step.action->trigger();
+    } else {
+      QWidget *target = window.focusWidget() ? window.focusWidget() : &window;
+      QKeyEvent press{QEvent::KeyPress, step.key, step.modifiers};
+      QApplication::sendEvent(target, &press);
+      QKeyEvent release{QEvent::KeyRelease, step.key, step.modifiers};
+      QApplication::sendEvent(target, &release);
+    }
+    window.flushView();
+    QCoreApplication::sendPostedEvents();
+    QCoreApplication::processEvents();
+    latencies.push_back(static_cast<double>(timer.nsecsElapsed()));
+  }
+  const double cpu =
+      static_cast<double>(cpuTimeNs() - cpuStart) / script.size();
+
+  runner.record(name, script.size(), std::move(latencies));
+  runner.record(name + "/cpu", script.size(), {cpu});
+}
+
+/// \return the time from creating a window until it has painted the puzzle
+/// at \p path, which is parsed in the background while the window is built,
+/// as it is when the application starts with a file. Snapshots are kept in
+/// \p snapshots.
+double startupTime(const QString &path, const QString &snapshots) {
+  QElapsedTimer timer{};
+  timer.start();
+  PuzzleLoader loader{nullptr, snapshots};
+  std::unique_ptr<Puzzle> puzzle{};
+  loader.load({path},
+              [&puzzle](const QString &, std::unique_ptr<Puzzle> loaded) {
+                puzzle = std::move(loaded);
+              });
+  MainWindow window{nullptr, snapshots};
+  window.resize(1280, 900);
+  window.show();
+  while (loader.busy()) {
+    QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+  }
+  window.setPuzzle(path, std::move(puzzle));
+  if (!window.isLoaded()) {
+    qFatal("Unable to load %s", qPrintable(path));
+  }
+  window.finishLoading();
+  window.repaint();
+  return static_cast<double>(timer.nsecsElapsed());
+}
+
+/// Time startup with the file at \p path, both cold, when the file is parsed
+/// and its snapshot stored, and warm, when the snapshot is mapped instead.
+void startup(Runner &runner, const QString &path, const QString &snapshots,
+             const QString &suffix) {
+  const QString cold = "ui/startup/cold" + suffix;
+  const QString warm = "ui/startup/warm" + suffix;
+  if (!runner.enabled(cold) && !runner.enabled(warm)) {
+    return;
+  }
+
+  const size_t samples = 5;
+  std::vector<double> coldTimes{};
+  std::vector<double> warmTimes{};
+  for (size_t i = 0; i < samples; ++i) {
+    QDir{snapshots}.removeRecursively();
+    coldTimes.push_back(startupTime(path, snapshots));
+    warmTimes.push_back(startupTime(path, snapshots));
+  }
+  if (runner.enabled(cold)) {
+    runner.record(cold, samples, std::move(coldTimes));
+  }
+  if (runner.enabled(warm)) {
+    runner.record(warm, samples, std::move(warmTimes));
+  }
+}
+
+/// \return the allocations made by the parts of a window, measured the way
+/// runSuite() measures a whole one, with snapshots kept in \p snapshots.
+AllocationBaseline measureBaseline(const QString &snapshots) {
+  AllocationBaseline baseline{};
+  uint64_t allocations = Metrics::threadAllocations();
+  {
+    MainWindow window{nullptr, snapshots};
+    window.resize(1280, 900);
+    window.show();
+    QCoreApplication::processEvents();
+    baseline.window = Metrics::threadAllocations() - allocations;
+  }
+
+  QWidget grid{};
+  grid.resize(900, 900);
+  auto *gridLayout = new QGridLayout{&grid};
+  grid.show();
+  QCoreApplication::processEvents();
+  allocations = Metrics::threadAllocations();
+  for (uint64_t i = 0; i < kBaselineCells; ++i) {
+    auto *cell = new QWidget{};
+    auto *layout = new QGridLayout{cell};
+    auto *number = new QLabel{QString::number(i), cell};
+    number->move(0, 0);
+    layout->addWidget(new FilledLabel{cell}, 1, 1, 4, 4);
+    gridLayout->addWidget(cell, static_cast<int>(i / 15),
+                          static_cast<int>(i % 15));
+  }
+  QCoreApplication::processEvents();
+  baseline.cell = (Metrics::threadAllocations() - allocations) / kBaselineCells;
+
+  QListWidget list{};
+  list.show();
+  QCoreApplication::processEvents();
+  allocations = Metrics::threadAllocations();
+  for (uint64_t i = 0; i < kBaselineCells; ++i) {
+    list.addItem(QString("%1. Clue text of an average length").arg(i));
+  }
+  QCoreApplication::processEvents();
+  baseline.clue = (Metrics::threadAllocations() - allocations) / kBaselineCells;
+  return baseline;
+}
+
+void runSuite(Runner &runner, const QTemporaryDir &dir, uint8_t size,
+              size_t events) {
+  PuzzleGenerator::Options options{};
+  options.width = size;
+  options.height = size;
+  options.fillDensity = 0.3;
+  options.extensions = PuzzleGenerator::GEXT | PuzzleGenerator::LTIM;
+  const QString path = dir.filePath(QString("ui-%1.puz").arg(size));
+  const QByteArray contents = PuzzleGenerator::generate(options, size);
+  QFile file{path};
+  if (!file.open(QIODevice::WriteOnly) || file.write(contents) < 0) {
+    qFatal("Unable to write %s", qPrintable(path));
+  }
+  file.close();
+
+  // Snapshots are kept with the puzzles, rather than in the user's cache.
+  const QString snapshots = dir.filePath("snapshots");
+  const QString suffix = QString("/%1x%1").arg(size);
+  startup(runner, path, snapshots, suffix);
+
+  AllocationBaseline baseline{};
+  if (Metrics::countsAllocations()) {
+    baseline = measureBaseline(snapshots);
+  }
+  const uint64_t allocations = Metrics::threadAllocations();
+  MainWindow window{nullptr, snapshots};
+  window.resize(1280, 900);
+  window.show();
+  window.setFileName(path);
+  window.loadFile();
+  if (!window.isLoaded()) {
+    qFatal("Unable to load %s", qPrintable(path));
+  }
+  window.finishLoading();
+  QCoreApplication::processEvents();
+  const uint64_t cells = uint64_t(size) * size;
+  if (Metrics::countsAllocations()) {
+    runner.recordCount("allocations/window" + suffix,
+                       Metrics::threadAllocations() - allocations,
+                       baseline.budget(cells));
+    // Reported so that a change in the baseline shows up in comparisons.
+    runner.recordCount("allocations/baseline/window" + suffix,
+                       baseline.window, baseline.window);
+    runner.recordCount("allocations/baseline/cell" + suffix, baseline.cell,
+                       baseline.cell);
+    runner.recordCount("allocations/baseline/clue" + suffix, baseline.clue,
+                       baseline.clue);
+  }
+
+  ScriptBuilder builder{findAction(window, QKeySequence::Undo),
+                        findAction(window, QKeySequence::Redo), size};
+  const Qt::KeyboardModifiers none = Qt::NoModifier;
+  const Qt::KeyboardModifiers shift = Qt::ShiftModifier;
+
+  runner.run("thumbnail/render" + suffix, [&] {
+    keep(ThumbnailCache::render(contents, ThumbnailCache::kDefaultSize));
+  });
+
+  // Letters, with some penciled in.
+  replay(runner, window, "ui/typing" + suffix,
+         builder.build({{9, Qt::Key_A, none, 0}, {1, Qt::Key_A, shift, 0}},
+                       events));
+
+  replay(runner, window, "ui/navigation" + suffix,
+         builder.build({{4, Qt::Key_Right, none, 0},
+                        {4, Qt::Key_Down, none, 0},
+                        {3, Qt::Key_Left, none, 0},
+                        {3, Qt::Key_Up, none, 0},
+                        {2, Qt::Key_Tab, none, 0},
+                        {1, Qt::Key_Backtab, shift, 0},
+                        {1, Qt::Key_Space, none, 0},
+                        {1, Qt::Key_Home, none, 0},
+                        {1, Qt::Key_End, none, 0}},
+                       events));
+
+  replay(runner, window, "ui/editing" + suffix,
+         builder.build({{5, Qt::Key_A, none, 0},
+                        {3, Qt::Key_Backspace, none, 0},
+                        {2, Qt::Key_Delete, none, 0}},
+                       events));
+
+  replay(runner, window, "ui/history" + suffix,
+         builder.build({{4, Qt::Key_A, none, 0},
+                        {1, Qt::Key_Right, none, 0},
+                        {3, 0, none, -1},
+                        {2, 0, none, 1}},
+                       events));
+
+  // Rebus entry goes through a dialog, so it is far slower than the rest.
+  replay(runner, window, "ui/rebus" + suffix,
+         builder.build({{1, Qt::Key_Insert, none, 0},
+                        {3, Qt::Key_Right, none, 0},
+                        {1, Qt::Key_Down, none, 0}},
+                       std::max<size_t>(events / 20, 1)));
+
+  replay(runner, window, "ui/mixed" + suffix,
+         builder.build({{30, Qt::Key_A, none, 0},
+                        {2, Qt::Key_A, shift, 0},
+                        {8, Qt::Key_Right, none, 0},
+                        {6, Qt::Key_Down, none, 0},
+                        {3, Qt::Key_Left, none, 0},
+                        {3, Qt::Key_Up, none, 0},
+                        {4, Qt::Key_Tab, none, 0},
+                        {1, Qt::Key_Backtab, shift, 0},
+                        {2, Qt::Key_Space, none, 0},
+                        {6, Qt::Key_Backspace, none, 0},
+                        {2, Qt::Key_Delete, none, 0},
+                        {2, 0, none, -1},
+                        {1, 0, none, 1}},
+                       events));
+
+  // Memory at the end of the session, including the history it built up.
+  const MemoryUsage usage = window.memoryUsage();
+  const uint64_t gridBudget = kWidgetBytesPerCell * cells;
+  runner.recordMemory("memory/widgets.grid" + suffix,
+                      usage.bytes("widgets.grid"), gridBudget);
+  runner.recordMemory("memory/window" + suffix, usage.total(),
+                      gridBudget + kWindowBytesPerCell * cells +
+                          kWindowFixedBytes);
+}
+
+} // namespace
+} // namespace bench
+} // namespace cygnus
+
+int main(int argc, char *argv[]) {
+  using namespace cygnus::bench;
+
+  // Run without a display unless another platform was asked for.
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app(argc, argv);
+  QCoreApplication::setApplicationName("cygnus-bench-ui");
+  QLoggingCategory::setFilterRules("default.debug=false");
+
+  QCommandLineParser parser{};
+  parser.setApplicationDescription(
+      "Replays scripted key presses through the main window and measures "
+      "the latency of each one.");
+  addOptions(parser);
+  parser.addOptions({
+      {"events", "Key presses per script.", "n", "10000"},
+      {"sizes", "Comma separated grid sizes.", "list", "15,21,50"},
+  });
+  parser.process(app);
+
+  DialogDriver driver{};
+  app.installEventFilter(&driver);
+
+  QTemporaryDir dir{};
+  if (!dir.isValid()) {
+    qFatal("Unable to create a temporary directory");
+  }
+
+  Runner runner{runnerOptions(parser)};
+  const size_t events = std::max(1u, parser.value("events").toUInt());
+  for (const QString &size : parser.value("sizes").split(',')) {
+    runSuite(runner, dir, static_cast<uint8_t>(size.toUInt()), events);
+  }
+  return finish(runner, parser);
+}
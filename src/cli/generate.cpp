@@ -0,0 +1,151 @@
+#include "PuzzleGenerator.h"
+#include "WorkPool.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+using namespace cygnus;
+
+namespace {
+
+/// Parse "WxH" or "N" for a square grid.
+bool parseSize(const QString &text, uint8_t &width, uint8_t &height) {
+  QStringList parts = text.split('x');
+  if (parts.size() > 2) {
+    return false;
+  }
+  bool okWidth;
+  bool okHeight;
+  uint32_t w = parts.front().toUInt(&okWidth);
+  uint32_t h = parts.back().toUInt(&okHeight);
+  if (!okWidth || !okHeight || w < 1 || h < 1 || w > 255 || h > 255) {
+    return false;
+  }
+  width = static_cast<uint8_t>(w);
+  height = static_cast<uint8_t>(h);
+  return true;
+}
+
+bool parseExtensions(const QString &text, uint8_t &extensions) {
+  extensions = 0;
+  for (const QString &name : text.split(',')) {
+    if (name == "GEXT") {
+      extensions |= PuzzleGenerator::GEXT;
+    } else if (name == "LTIM") {
+      extensions |= PuzzleGenerator::LTIM;
+    } else if (name == "RUSR") {
+      extensions |= PuzzleGenerator::RUSR;
+    } else if (name != "none") {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("cygnus-gen");
+
+  QCommandLineParser parser{};
+  parser.setApplicationDescription(
+      "Generates a deterministic corpus of synthetic .puz files.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("dir", "Directory to write the puzzles to.");
+  QCommandLineOption countOption{{"n", "count"}, "Number of puzzles.", "n",
+                                 "1"};
+  QCommandLineOption seedOption{"seed", "Seed of the first puzzle.", "seed",
+                                "1"};
+  QCommandLineOption sizeOption{"size", "Grid size, N or WxH.", "size", "15"};
+  QCommandLineOption blackOption{"black-density", "Fraction of black squares.",
+                                 "fraction", "0.16"};
+  QCommandLineOption clueOption{"clue-length", "Average clue length.",
+                                "chars", "30"};
+  QCommandLineOption fillOption{"fill", "Fraction of squares filled in.",
+                                "fraction", "0.5"};
+  QCommandLineOption rebusOption{"rebus-density",
+                                 "Fraction of filled squares with a rebus.",
+                                 "fraction", "0"};
+  QCommandLineOption extensionsOption{
+      "extensions", "Extensions to write: GEXT,LTIM,RUSR or none.", "list",
+      "GEXT,LTIM"};
+  QCommandLineOption corruptOption{
+      "corrupt",
+      "Damage every file: " + PuzzleGenerator::corruptionNames().join(", "),
+      "kind", "none"};
+  QCommandLineOption jobsOption{{"j", "jobs"},
+                                "Number of threads, default one per core.",
+                                "n", "0"};
+  parser.addOptions({countOption, seedOption, sizeOption, blackOption,
+                     clueOption, fillOption, rebusOption, extensionsOption,
+                     corruptOption, jobsOption});
+  parser.process(app);
+
+  const QStringList args = parser.positionalArguments();
+  if (args.size() != 1) {
+    parser.showHelp(2);
+  }
+
+  PuzzleGenerator::Options options{};
+  options.blackDensity = parser.value(blackOption).toDouble();
+  options.clueLength = parser.value(clueOption).toUInt();
+  options.fillDensity = parser.value(fillOption).toDouble();
+  options.rebusDensity = parser.value(rebusOption).toDouble();
+  if (!parseSize(parser.value(sizeOption), options.width, options.height)) {
+    fprintf(stderr, "Invalid size: %s\n",
+            qPrintable(parser.value(sizeOption)));
+    return 2;
+  }
+  if (!parseExtensions(parser.value(extensionsOption), options.extensions)) {
+    fprintf(stderr, "Invalid extensions: %s\n",
+            qPrintable(parser.value(extensionsOption)));
+    return 2;
+  }
+  if (!PuzzleGenerator::parseCorruption(parser.value(corruptOption),
+                                        options.corruption)) {
+    fprintf(stderr, "Invalid corruption: %s\n",
+            qPrintable(parser.value(corruptOption)));
+    return 2;
+  }
+
+  const QDir dir{args.front()};
+  if (!QDir{}.mkpath(dir.path())) {
+    fprintf(stderr, "Unable to create %s\n", qPrintable(dir.path()));
+    return 2;
+  }
+
+  const uint32_t count = parser.value(countOption).toUInt();
+  const uint64_t seed = parser.value(seedOption).toULongLong();
+  const int digits = QString::number(std::max(count, 1u) - 1).size();
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint32_t> failed{0};
+
+  WorkPool pool{parser.value(jobsOption).toUInt()};
+  QElapsedTimer timer{};
+  timer.start();
+  pool.run(count, [&](size_t i) {
+    QByteArray data = PuzzleGenerator::generate(options, seed + i);
+    QString name = QString("synthetic-%1.puz").arg(i, digits, 10, QChar('0'));
+    QFile file{dir.filePath(name)};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+      fprintf(stderr, "Unable to write %s\n", qPrintable(file.fileName()));
+      ++failed;
+      return;
+    }
+    bytes += data.size();
+  });
+  const qint64 elapsed = std::max<qint64>(timer.elapsed(), 1);
+
+  fprintf(stderr, "Generated %u puzzles, %.1f MB in %lld ms\n",
+          count - failed.load(), bytes / (1024.0 * 1024.0),
+          static_cast<long long>(elapsed));
+  return failed == 0 ? 0 : 1;
+}
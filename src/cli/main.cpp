@@ -0,0 +1,751 @@
+#include "ClueDatabase.h"
+#include "ClueIndex.h"
+#include "GridStatistics.h"
+#include "Puzzle.h"
+#include "SimilarityIndex.h"
+#include "Trace.h"
+#include "WorkPool.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace cygnus {
+namespace {
+
+/// Outcome of running a command on a single file.
+struct FileResult {
+  bool ok{true};
+  /// Printed to stdout, in the order the files were given.
+  QByteArray output{};
+  /// Printed to stderr along with the file name if the command failed.
+  QString error{};
+};
+
+/// Options shared by all commands.
+struct Options {
+  bool fix{false};
+  /// Where normalize writes each file, if not in place.
+  QHash<QString, QString> outputPaths{};
+};
+
+using Command = std::function<FileResult(const QString &path,
+                                         const QByteArray &data,
+                                         const Options &options)>;
+
+FileResult failure(const QString &error) {
+  FileResult result{};
+  result.ok = false;
+  result.error = error;
+  return result;
+}
+
+bool writeFile(const QString &path, const QByteArray &data) {
+  QFile file{path};
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  return file.write(data) == data.size();
+}
+
+FileResult validate(const QString &, const QByteArray &data, const Options &) {
+  if (!Puzzle::loadFromFile(data)) {
+    return failure("invalid puzzle");
+  }
+  return FileResult{};
+}
+
+FileResult checksum(const QString &path, const QByteArray &data,
+                    const Options &options) {
+  QByteArray repaired = data;
+  if (!Puzzle::repairChecksums(repaired)) {
+    return failure("truncated puzzle");
+  }
+  if (repaired == data) {
+    return FileResult{};
+  }
+  if (!options.fix) {
+    return failure("checksum mismatch");
+  }
+  if (!writeFile(path, repaired)) {
+    return failure("unable to write");
+  }
+  FileResult result{};
+  result.output = QString("%1: checksums repaired\n").arg(path).toUtf8();
+  return result;
+}
+
+FileResult normalize(const QString &path, const QByteArray &data,
+                     const Options &options) {
+  auto puzzle = Puzzle::loadFromFile(data);
+  if (!puzzle) {
+    return failure("invalid puzzle");
+  }
+  const QString outPath = options.outputPaths.value(path, path);
+  if (!writeFile(outPath, puzzle->serialize())) {
+    return failure(QString("unable to write %1").arg(outPath));
+  }
+  return FileResult{};
+}
+
+FileResult dump(const QString &path, const QByteArray &data, const Options &) {
+  auto puzzle = Puzzle::loadFromFile(data);
+  if (!puzzle) {
+    return failure("invalid puzzle");
+  }
+
+  QString out{};
+  out += QString("%1\n").arg(path);
+  out += QString("  Title:     %1\n").arg(puzzle->getTitle());
+  out += QString("  Author:    %1\n").arg(puzzle->getAuthor());
+  out += QString("  Copyright: %1\n").arg(puzzle->getCopyright());
+  out += QString("  Size:      %1x%2\n")
+             .arg(puzzle->getWidth())
+             .arg(puzzle->getHeight());
+  const auto &solution = puzzle->getSolution();
+  for (uint8_t r = 0; r < solution.height(); ++r) {
+    out += "    ";
+    out += QString::fromLatin1(solution[r], solution.width());
+    out += '\n';
+  }
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    out += dir == Direction::ACROSS ? "  Across:\n" : "  Down:\n";
+    for (const auto &clue : puzzle->getClues(dir)) {
+      out += QString("    %1. %2\n").arg(clue.num).arg(
+          puzzle->getClueText(clue));
+    }
+  }
+  if (puzzle->hasNote()) {
+    out += QString("  Note: %1\n").arg(puzzle->getNote());
+  }
+
+  FileResult result{};
+  result.output = out.toUtf8();
+  return result;
+}
+
+FileResult memory(const QString &path, const QByteArray &data,
+                  const Options &) {
+  auto puzzle = Puzzle::loadFromFile(data);
+  if (!puzzle) {
+    return failure("invalid puzzle");
+  }
+  QString out = QString("%1\n").arg(path);
+  out += puzzle->memoryUsage().toString("  ");
+
+  FileResult result{};
+  result.output = out.toUtf8();
+  return result;
+}
+
+/// \return every .puz file in \p paths, searching directories recursively.
+/// If \p relative is given, it is set to the path of each file relative to
+/// the directory it was found in, or its name if it was given itself.
+QStringList collectFiles(const QStringList &paths,
+                         QStringList *relative = nullptr) {
+  QStringList files{};
+  for (const QString &path : paths) {
+    if (!QFileInfo{path}.isDir()) {
+      files.push_back(path);
+      if (relative) {
+        relative->push_back(QFileInfo{path}.fileName());
+      }
+      continue;
+    }
+    QStringList found{};
+    QDirIterator it{path, {"*.puz"}, QDir::Files,
+                    QDirIterator::Subdirectories};
+    while (it.hasNext()) {
+      found.push_back(it.next());
+    }
+    found.sort();
+    files += found;
+    if (relative) {
+      const QDir root{path};
+      for (const QString &file : found) {
+        relative->push_back(root.relativeFilePath(file));
+      }
+    }
+  }
+  return files;
+}
+
+/// Map each of \p files to its path in \p relative under \p outputDir,
+/// creating the directories they are written to.
+/// \return false, after printing why, if two files would be written to the
+/// same path or a directory can't be created.
+bool mapOutputPaths(const QStringList &files, const QStringList &relative,
+                    const QString &outputDir,
+                    QHash<QString, QString> &outputPaths) {
+  const QDir dir{outputDir};
+  QHash<QString, QString> sources{};
+  for (int i = 0; i < files.size(); ++i) {
+    const QString outPath = QDir::cleanPath(dir.filePath(relative[i]));
+    const auto source = sources.constFind(outPath);
+    if (source != sources.constEnd()) {
+      fprintf(stderr, "%s and %s would both be written to %s\n",
+              qPrintable(*source), qPrintable(files[i]),
+              qPrintable(outPath));
+      return false;
+    }
+    sources.insert(outPath, files[i]);
+    outputPaths.insert(files[i], outPath);
+    const QString parent = QFileInfo{outPath}.path();
+    if (!QDir{}.mkpath(parent)) {
+      fprintf(stderr, "Unable to create %s\n", qPrintable(parent));
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Build the clue index of \p files in \p indexPath.
+int buildIndex(const QStringList &files, const QString &indexPath,
+               unsigned threads) {
+  QElapsedTimer timer{};
+  timer.start();
+  ClueIndex index{};
+  if (!ClueIndex::build(files, indexPath, threads) || !index.open(indexPath)) {
+    return 1;
+  }
+  fprintf(stderr, "index: %u of %d files, %u clues in %lld ms\n",
+          index.fileCount(), files.size(), index.clueCount(),
+          static_cast<long long>(timer.elapsed()));
+  return 0;
+}
+
+/// Print the clues in \p indexPath matching \p query.
+int search(const QString &indexPath, const QString &query, size_t limit) {
+  ClueIndex index{};
+  if (!index.open(indexPath)) {
+    fprintf(stderr, "Unable to open %s\n", qPrintable(indexPath));
+    return 2;
+  }
+  QElapsedTimer timer{};
+  timer.start();
+  const auto hits = index.search(query, limit);
+  const qint64 elapsed = timer.nsecsElapsed();
+
+  QString out{};
+  for (const auto &hit : hits) {
+    out += QString("%1: %2%3. %4 (%5)\n")
+               .arg(hit.path)
+               .arg(hit.num)
+               .arg(hit.dir == Direction::ACROSS ? 'A' : 'D')
+               .arg(hit.clue)
+               .arg(hit.answer);
+  }
+  fputs(out.toUtf8().constData(), stdout);
+  fflush(stdout);
+  fprintf(stderr, "search: %zu hits in %.2f ms\n", hits.size(),
+          elapsed / 1e6);
+  return hits.empty() ? 1 : 0;
+}
+
+/// Build the clue database of \p files in \p path.
+int buildDatabase(const QStringList &files, const QString &path,
+                  unsigned threads) {
+  QElapsedTimer timer{};
+  timer.start();
+  ClueDatabase database{};
+  if (!ClueDatabase::build(files, path, threads) || !database.open(path)) {
+    return 1;
+  }
+  fprintf(stderr, "cluedb: %d files, %u answers, %u clues in %lld ms\n",
+          files.size(), database.answerCount(), database.clueCount(),
+          static_cast<long long>(timer.elapsed()));
+  return 0;
+}
+
+/// Print the clues of each of \p answers in the database at \p path.
+int printClues(const QString &path, const QStringList &answers, size_t limit) {
+  ClueDatabase database{};
+  if (!database.open(path)) {
+    fprintf(stderr, "Unable to open %s\n", qPrintable(path));
+    return 2;
+  }
+  bool found = false;
+  QString out{};
+  for (const QString &answer : answers) {
+    const auto entries = database.lookup(answer.toUtf8(), limit);
+    found = found || !entries.empty();
+    out += QString("%1:\n").arg(answer.toUpper());
+    for (const auto &entry : entries) {
+      out += QString("  %1 (%2)\n").arg(entry.clue).arg(entry.count);
+    }
+  }
+  fputs(out.toUtf8().constData(), stdout);
+  fflush(stdout);
+  return found ? 0 : 1;
+}
+
+/// Print the groups of \p files which are copies of the same puzzle, by
+/// Puzzle::fingerprint(), fingerprinting them on \p threads threads.
+int findDuplicates(const QStringList &files, unsigned threads) {
+  std::vector<QByteArray> fingerprints(files.size());
+  WorkPool pool{threads};
+  QElapsedTimer timer{};
+  timer.start();
+  pool.run(files.size(), [&](size_t i) {
+    QFile file{files[i]};
+    if (file.open(QIODevice::ReadOnly)) {
+      fingerprints[i] = Puzzle::fingerprint(file.readAll());
+    }
+  });
+
+  // Files with each fingerprint, and the fingerprints in the order their
+  // first file was given.
+  QHash<QByteArray, std::vector<int>> groups{};
+  std::vector<QByteArray> order{};
+  size_t invalid = 0;
+  for (int i = 0; i < files.size(); ++i) {
+    if (fingerprints[i].isEmpty()) {
+      ++invalid;
+      fprintf(stderr, "%s: invalid puzzle\n", qPrintable(files[i]));
+      continue;
+    }
+    auto &group = groups[fingerprints[i]];
+    if (group.empty()) {
+      order.push_back(fingerprints[i]);
+    }
+    group.push_back(i);
+  }
+  const qint64 elapsed = timer.elapsed();
+
+  size_t duplicates = 0;
+  size_t groupCount = 0;
+  QString out{};
+  for (const QByteArray &fingerprint : order) {
+    const auto &group = groups[fingerprint];
+    if (group.size() < 2) {
+      continue;
+    }
+    ++groupCount;
+    duplicates += group.size() - 1;
+    out += QString("%1: %2 files\n")
+               .arg(QString::fromLatin1(fingerprint.toHex()))
+               .arg(group.size());
+    for (const int i : group) {
+      out += QString("  %1\n").arg(files[i]);
+    }
+  }
+  fputs(out.toUtf8().constData(), stdout);
+  fflush(stdout);
+  fprintf(stderr,
+          "dedupe: %d files, %zu invalid, %zu duplicates in %zu groups in "
+          "%lld ms (%u threads)\n",
+          files.size(), invalid, duplicates, groupCount,
+          static_cast<long long>(elapsed), pool.threadCount());
+  return invalid == 0 ? 0 : 1;
+}
+
+/// Print the puzzles in \p files which share the most answers with the one
+/// at \p path, signing every file on \p threads threads.
+int findSimilar(const QString &path, const QStringList &files, size_t limit,
+                unsigned threads) {
+  auto sign = [](const QString &file) {
+    QFile in{file};
+    if (!in.open(QIODevice::ReadOnly)) {
+      return Signature{};
+    }
+    const auto puzzle = Puzzle::loadFromFile(in.readAll());
+    return puzzle ? SimilarityIndex::signature(*puzzle) : Signature{};
+  };
+  const Signature target = sign(path);
+  if (target.empty()) {
+    fprintf(stderr, "%s: invalid puzzle\n", qPrintable(path));
+    return 2;
+  }
+
+  QElapsedTimer timer{};
+  timer.start();
+  std::vector<Signature> signatures(files.size());
+  WorkPool pool{threads};
+  pool.run(files.size(), [&](size_t i) { signatures[i] = sign(files[i]); });
+  SimilarityIndex index{};
+  for (auto &signature : signatures) {
+    index.add(std::move(signature));
+  }
+  const qint64 built = timer.elapsed();
+  timer.restart();
+  auto matches = index.query(target, SimilarityIndex::kThreshold, limit + 1);
+  const qint64 queried = timer.nsecsElapsed();
+  // The puzzle itself, if it is among the files.
+  const QString self = QFileInfo{path}.absoluteFilePath();
+  matches.erase(std::remove_if(matches.begin(), matches.end(),
+                               [&](const SimilarityIndex::Match &match) {
+                                 return QFileInfo{files[match.item]}
+                                            .absoluteFilePath() == self;
+                               }),
+                matches.end());
+  if (matches.size() > limit) {
+    matches.resize(limit);
+  }
+
+  QString out{};
+  for (const auto &match : matches) {
+    out += QString("%1% %2\n")
+               .arg(qRound(match.similarity * 100), 3)
+               .arg(files[match.item]);
+  }
+  fputs(out.toUtf8().constData(), stdout);
+  fflush(stdout);
+  fprintf(stderr,
+          "similar: %d files signed in %lld ms, %zu matches in %.2f ms\n",
+          files.size(), static_cast<long long>(built), matches.size(),
+          queried / 1e6);
+  return matches.empty() ? 1 : 0;
+}
+
+/// \return \p text as a CSV field, quoted if needed.
+QByteArray csvField(const QString &text) {
+  QByteArray field = text.toUtf8();
+  if (field.contains(',') || field.contains('"') || field.contains('\n')) {
+    field.replace('"', "\"\"");
+    field = '"' + field + '"';
+  }
+  return field;
+}
+
+/// \return \p text as a JSON string.
+QByteArray jsonString(const QString &text) {
+  QByteArray out{"\""};
+  for (const char c : text.toUtf8()) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<uint8_t>(c) < 0x20) {
+      out += QString("\\u%1").arg(int(c), 4, 16, QChar('0')).toLatin1();
+    } else {
+      out += c;
+    }
+  }
+  return out + '"';
+}
+
+/// Names of the statistics, in the order they are printed.
+const char *const kStatisticNames[] = {
+    "puzzles",    "cells",    "black_ratio", "words",  "average_word_length",
+    "rotational", "mirrored", "rebus",       "circled"};
+
+/// \return the values of \p stats in the order of kStatisticNames, followed
+/// by the count of each letter.
+std::vector<QByteArray> statisticValues(const GridStatistics &stats) {
+  auto count = [](uint64_t n) { return QByteArray::number(qulonglong(n)); };
+  std::vector<QByteArray> values{
+      count(stats.puzzles),
+      count(stats.cells),
+      QByteArray::number(stats.blackRatio(), 'f', 4),
+      count(stats.words),
+      QByteArray::number(stats.averageWordLength(), 'f', 3),
+      count(stats.rotational),
+      count(stats.mirrored),
+      count(stats.rebusCells),
+      count(stats.circledCells)};
+  for (const uint64_t letter : stats.letters) {
+    values.push_back(count(letter));
+  }
+  return values;
+}
+
+/// \return \p stats of the file at \p path as a line of CSV, or a JSON
+/// object if \p json is true.
+QByteArray formatStatistics(const QString &path, const GridStatistics &stats,
+                            bool json) {
+  const std::vector<QByteArray> values = statisticValues(stats);
+  const size_t named = std::extent<decltype(kStatisticNames)>::value;
+  QByteArray out{};
+  if (!json) {
+    out += csvField(path);
+    for (const QByteArray &value : values) {
+      out += ',' + value;
+    }
+    return out + '\n';
+  }
+  out += "{\"path\": " + jsonString(path);
+  for (size_t i = 0; i < named; ++i) {
+    out += QByteArray{", \""} + kStatisticNames[i] + "\": " + values[i];
+  }
+  out += ", \"letters\": {";
+  for (size_t i = named; i < values.size(); ++i) {
+    out += QByteArray{i == named ? "\"" : ", \""} +
+           char('A' + (i - named)) + "\": " + values[i];
+  }
+  return out + "}}";
+}
+
+/// Print the grid statistics of each of \p files and their sum as CSV, or
+/// JSON if \p json is true, analyzing them on \p threads threads.
+int analyze(const QStringList &files, bool json, unsigned threads) {
+  std::vector<GridStatistics> stats(files.size());
+  std::vector<QByteArray> rows(files.size());
+  std::atomic<uint64_t> bytes{0};
+  WorkPool pool{threads};
+  QElapsedTimer timer{};
+  timer.start();
+  // Rows are formatted on the workers too, so that the main thread only
+  // writes them out.
+  pool.run(files.size(), [&](size_t i) {
+    QFile file{files[i]};
+    if (!file.open(QIODevice::ReadOnly)) {
+      return;
+    }
+    const QByteArray data = file.readAll();
+    bytes += data.size();
+    if (const auto puzzle = Puzzle::loadFromFile(data)) {
+      stats[i] = GridStatistics::compute(*puzzle);
+      rows[i] = formatStatistics(files[i], stats[i], json);
+    }
+  });
+
+  GridStatistics total{};
+  size_t invalid = 0;
+  QByteArray header{};
+  if (json) {
+    header = "{\"puzzles\": [\n";
+  } else {
+    header = "path";
+    for (const char *name : kStatisticNames) {
+      header += QByteArray{","} + name;
+    }
+    for (char letter = 'A'; letter <= 'Z'; ++letter) {
+      header += QByteArray{","} + letter;
+    }
+    header += '\n';
+  }
+  fwrite(header.constData(), 1, header.size(), stdout);
+  bool first = true;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (stats[i].puzzles == 0) {
+      ++invalid;
+      fprintf(stderr, "%s: invalid puzzle\n", qPrintable(files[i]));
+      continue;
+    }
+    total += stats[i];
+    if (json && !first) {
+      fputs(",\n", stdout);
+    }
+    first = false;
+    fwrite(rows[i].constData(), 1, rows[i].size(), stdout);
+  }
+  // The sum of every puzzle, where the symmetry columns count puzzles.
+  const QByteArray footer =
+      json ? "\n], \"total\": " + formatStatistics("total", total, true) +
+                 "}\n"
+           : formatStatistics("total", total, false);
+  fwrite(footer.constData(), 1, footer.size(), stdout);
+  fflush(stdout);
+
+  const double seconds = std::max<qint64>(timer.elapsed(), 1) / 1000.0;
+  const double megabytes = bytes / (1024.0 * 1024.0);
+  fprintf(stderr,
+          "stats: %d files, %zu invalid, %.1f MB in %.0f ms "
+          "(%.0f files/s, %.1f MB/s, %u threads)\n",
+          files.size(), invalid, megabytes, seconds * 1000,
+          files.size() / seconds, megabytes / seconds, pool.threadCount());
+  return invalid == 0 ? 0 : 1;
+}
+
+} // namespace
+} // namespace cygnus
+
+int main(int argc, char *argv[]) {
+  using namespace cygnus;
+
+  Tracer::init(argc, argv);
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("cygnus-cli");
+
+  QCommandLineParser parser{};
+  parser.setApplicationDescription(
+      "Batch processing of .puz files.\n\n"
+      "Commands:\n"
+      "  validate   Check that each puzzle can be loaded.\n"
+      "  checksum   Check the stored checksums, repair them with --fix.\n"
+      "  normalize  Rewrite each puzzle in canonical form.\n"
+      "  dump       Print the metadata, solution and clues of each puzzle.\n"
+      "  memory     Print the estimated memory used by each puzzle.\n"
+      "  index      Build the clue index of the puzzles, see --index.\n"
+      "  search     Search the clue index, for example \"search osl*\" or\n"
+      "             \"search answer:o?oe\".\n"
+      "  cluedb     Build the database of the clues given to each answer in\n"
+      "             the puzzles, see --database.\n"
+      "  clues      Print the clues given to answers in the clue database.\n"
+      "  dedupe     Print the groups of puzzles with the same solution and\n"
+      "             clues, whatever their progress, timer or file name.\n"
+      "  similar    Print the puzzles sharing the most answers with the first\n"
+      "             one, for example \"similar a.puz library/\".\n"
+      "  stats      Print grid statistics of each puzzle and their total, as\n"
+      "             CSV or JSON, see --format.\n\n"
+      "Pass --trace <file> or set CYGNUS_TRACE to record a Chrome trace.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("command", "Command to run.");
+  parser.addPositionalArgument("paths", "Files or directories to process.",
+                               "paths...");
+  QCommandLineOption jobsOption{{"j", "jobs"},
+                                "Number of threads, default one per core.",
+                                "n", "0"};
+  QCommandLineOption fixOption{"fix", "Repair incorrect checksums in place."};
+  QCommandLineOption outputOption{
+      {"o", "output"},
+      "Write normalized files to dir instead of in place, keeping their "
+      "paths relative to the directories given.",
+      "dir"};
+  QCommandLineOption verboseOption{{"v", "verbose"}, "Print parser logs."};
+  QCommandLineOption indexOption{"index", "Clue index to build or search.",
+                                 "file", ClueIndex::defaultPath()};
+  QCommandLineOption databaseOption{"database",
+                                    "Clue database to build or read.", "file",
+                                    ClueDatabase::defaultPath()};
+  QCommandLineOption limitOption{
+      "limit", "Maximum number of search results, clues or similar puzzles.",
+      "n", "100"};
+  QCommandLineOption formatOption{
+      "format", "Output of stats: csv or json.", "format", "csv"};
+  parser.addOptions({jobsOption, fixOption, outputOption, verboseOption,
+                     indexOption, databaseOption, limitOption, formatOption});
+  parser.process(app);
+
+  QStringList args = parser.positionalArguments();
+  if (args.size() < 2) {
+    parser.showHelp(2);
+  }
+
+  const QString name = args.takeFirst();
+  if (!parser.isSet(verboseOption)) {
+    QLoggingCategory::setFilterRules("default.debug=false");
+  }
+  if (name == "index") {
+    const int status = buildIndex(collectFiles(args), parser.value(indexOption),
+                                  parser.value(jobsOption).toUInt());
+    Tracer::finish();
+    return status;
+  }
+  if (name == "search") {
+    return search(parser.value(indexOption), args.join(' '),
+                  parser.value(limitOption).toUInt());
+  }
+  if (name == "cluedb") {
+    const int status =
+        buildDatabase(collectFiles(args), parser.value(databaseOption),
+                      parser.value(jobsOption).toUInt());
+    Tracer::finish();
+    return status;
+  }
+  if (name == "clues") {
+    return printClues(parser.value(databaseOption), args,
+                      parser.value(limitOption).toUInt());
+  }
+
+  if (name == "dedupe") {
+    const int status =
+        findDuplicates(collectFiles(args), parser.value(jobsOption).toUInt());
+    Tracer::finish();
+    return status;
+  }
+
+  if (name == "similar") {
+    const QString path = args.takeFirst();
+    const int status = findSimilar(path, collectFiles(args),
+                                   parser.value(limitOption).toUInt(),
+                                   parser.value(jobsOption).toUInt());
+    Tracer::finish();
+    return status;
+  }
+
+  if (name == "stats") {
+    const QString format = parser.value(formatOption);
+    if (format != "csv" && format != "json") {
+      fprintf(stderr, "Unknown format: %s\n", qPrintable(format));
+      return 2;
+    }
+    const int status = analyze(collectFiles(args), format == "json",
+                               parser.value(jobsOption).toUInt());
+    Tracer::finish();
+    return status;
+  }
+
+  Command command{};
+  if (name == "validate") {
+    command = validate;
+  } else if (name == "checksum") {
+    command = checksum;
+  } else if (name == "normalize") {
+    command = normalize;
+  } else if (name == "dump") {
+    command = dump;
+  } else if (name == "memory") {
+    command = memory;
+  } else {
+    fprintf(stderr, "Unknown command: %s\n", qPrintable(name));
+    return 2;
+  }
+
+  Options options{};
+  options.fix = parser.isSet(fixOption);
+  QStringList relative{};
+  const QStringList files = collectFiles(args, &relative);
+  // Files are written under the output directory with the same layout as
+  // under the directory they were found in, so that x.puz in two
+  // subdirectories doesn't collide.
+  const QString outputDir = parser.value(outputOption);
+  if (!outputDir.isEmpty() &&
+      !mapOutputPaths(files, relative, outputDir, options.outputPaths)) {
+    return 2;
+  }
+  std::vector<FileResult> results(files.size());
+  std::atomic<uint64_t> bytes{0};
+
+  WorkPool pool{parser.value(jobsOption).toUInt()};
+  QElapsedTimer timer{};
+  timer.start();
+  pool.run(files.size(), [&](size_t i) {
+    QFile file{files[i]};
+    if (!file.open(QIODevice::ReadOnly)) {
+      results[i] = failure("unable to open");
+      return;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+    bytes += data.size();
+    results[i] = command(files[i], data, options);
+  });
+  const qint64 elapsed = std::max<qint64>(timer.elapsed(), 1);
+
+  size_t failed = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const FileResult &result = results[i];
+    fwrite(result.output.constData(), 1, result.output.size(), stdout);
+    if (!result.ok) {
+      ++failed;
+      fprintf(stderr, "%s: %s\n", qPrintable(files[i]),
+              qPrintable(result.error));
+    }
+  }
+  fflush(stdout);
+
+  const double seconds = elapsed / 1000.0;
+  const double megabytes = bytes / (1024.0 * 1024.0);
+  fprintf(stderr,
+          "%s: %d files, %zu failed, %.1f MB in %lld ms "
+          "(%.0f files/s, %.1f MB/s, %u threads)\n",
+          qPrintable(name), files.size(), failed, megabytes,
+          static_cast<long long>(elapsed), files.size() / seconds,
+          megabytes / seconds, pool.threadCount());
+
+  Tracer::finish();
+  return failed == 0 ? 0 : 1;
+}
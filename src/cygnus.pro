@@ -1,22 +1,77 @@
 TARGET = cygnus
-QT += widgets
+QT += network widgets
 
 SOURCES += main.cpp
 
+SOURCES += AllocationCounter.cpp
+
+HEADERS += ClueDatabase.h
+SOURCES += ClueDatabase.cpp
+
+HEADERS += ClueIndex.h
+SOURCES += ClueIndex.cpp
+
+HEADERS += Grid.h
+
+HEADERS += GridStatistics.h
+SOURCES += GridStatistics.cpp
+
+HEADERS += Library.h
+SOURCES += Library.cpp
+
 HEADERS += MainWindow.h
 SOURCES += MainWindow.cpp
 
+HEADERS += MappedFile.h
+
+HEADERS += MemoryUsage.h
+
+HEADERS += Metrics.h
+SOURCES += Metrics.cpp
+
 HEADERS += Puzzle.h
 SOURCES += Puzzle.cpp
 
+HEADERS += PuzzleLoader.h
+SOURCES += PuzzleLoader.cpp
+
+HEADERS += RebusFill.h
+SOURCES += RebusFill.cpp
+
+HEADERS += SimilarityIndex.h
+SOURCES += SimilarityIndex.cpp
+
+HEADERS += SnapshotCache.h
+SOURCES += SnapshotCache.cpp
+
+HEADERS += StringPool.h
+
+HEADERS += Trace.h
+SOURCES += Trace.cpp
+
+HEADERS += UndoStack.h
+SOURCES += UndoStack.cpp
+
+HEADERS += WorkPool.h
+SOURCES += WorkPool.cpp
+
 HEADERS += PuzzleWidget.h
 SOURCES += PuzzleWidget.cpp
 
 HEADERS += ClueWidget.h
 SOURCES += ClueWidget.cpp
 
+HEADERS += LibraryDialog.h
+SOURCES += LibraryDialog.cpp
+
+HEADERS += ThumbnailCache.h
+SOURCES += ThumbnailCache.cpp
+
 HEADERS += TimerWidget.h
 SOURCES += TimerWidget.cpp
 
 HEADERS += FilledLabel.h
 SOURCES += FilledLabel.cpp
+
+HEADERS += SingleInstance.h
+SOURCES += SingleInstance.cpp
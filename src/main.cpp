@@ -1,66 +1,89 @@
 #include "MainWindow.h"
+#include "Metrics.h"
+#include "PuzzleLoader.h"
 #include "Settings.h"
+#include "SingleInstance.h"
+#include "Trace.h"
 
 #include <QApplication>
 
+#include <algorithm>
 #include <memory>
 
 namespace cygnus {
 
 class MainApp : public QApplication {
   std::vector<std::unique_ptr<MainWindow>> windows_{};
-
-#ifdef Q_OS_MACOS
-  MainWindow *firstWindow_{};
-  QString fileName_;
+  /// Parses the files opened from the command line, the Finder or by
+  /// dropping them on a window, several at a time.
+  PuzzleLoader loader_{};
+#ifndef Q_OS_MACOS
+  SingleInstance instance_{};
 #endif
+  bool forwarded_{false};
 
 public:
-  MainApp(int argc, char *argv[]) : QApplication(argc, argv) {
+  /// If \p singleInstance, files given to later launches are opened by this
+  /// one, or this launch hands its files to an instance which is already
+  /// running and forwarded() is true.
+  MainApp(int &argc, char *argv[], bool singleInstance)
+      : QApplication(argc, argv) {
 
 #ifdef Q_OS_MACOS
+    // The system sends files to the running application as FileOpen events.
+    Q_UNUSED(singleInstance);
     setAttribute(Qt::AA_UseHighDpiPixmaps);
-    firstWindow_ = createWindow();
+    auto *window = createWindow();
     QApplication::processEvents();
-    if (!firstWindow_->isLoaded()) {
-      firstWindow_->open();
+    // Files opened from the Finder arrive as events while processing events.
+    if (!window->isLoaded() && !loader_.busy()) {
+      window->open();
     }
 #else
-    setStyle(QStyleFactory::create("Fusion"));
-    auto *window = createWindow();
-    QApplication::processEvents();
-
-    QString fileName{};
+    const QStringList startupFiles = arguments().mid(1);
+    if (singleInstance) {
+      if (!instance_.listen(startupFiles)) {
+        forwarded_ = true;
+        return;
+      }
+      connect(&instance_, &SingleInstance::filesReceived, this,
+              [this](const QStringList &fileNames) {
+                if (fileNames.isEmpty()) {
+                  createWindow()->open();
+                } else {
+                  openFiles(fileNames);
+                }
+              });
+    }
 
-    if (argc > 1 && argv[1]) {
-      fileName = argv[1];
+    // Start parsing the files before building the window, so that the two
+    // overlap. Their puzzles are shown once the event loop starts.
+    if (!startupFiles.isEmpty()) {
+      openFiles(startupFiles);
     }
 
-    if (!fileName.isEmpty()) {
-      window->setFileName(fileName);
-      window->loadFile();
+    setStyle(QStyleFactory::create("Fusion"));
+    if (startupFiles.isEmpty()) {
+      createWindow()->open();
     } else {
-      window->open();
+      addWindow();
     }
 #endif
   }
 
+  /// \return true if the files of this launch were handed to another
+  /// instance, which started at about the same time.
+  inline bool forwarded() const { return forwarded_; }
+
 protected:
 #ifdef Q_OS_MACOS
   bool event(QEvent *event) override {
     switch (event->type()) {
     case QEvent::FileOpen: {
       QFileOpenEvent *fileOpenEvent = static_cast<QFileOpenEvent *>(event);
-      if (fileOpenEvent) {
-        fileName_ = fileOpenEvent->file();
-        if (!fileName_.isEmpty()) {
-          MainWindow *window = firstWindow_ && !firstWindow_->isLoaded()
-                                   ? firstWindow_
-                                   : window = createWindow();
-          window->setFileName(fileName_);
-          window->loadFile();
-          return true;
-        }
+      if (fileOpenEvent && !fileOpenEvent->file().isEmpty()) {
+        openFiles(QStringList{fileOpenEvent->file()});
+        return true;
       }
     }
     default:
@@ -72,10 +95,43 @@ protected:
 
 private:
   MainWindow *createWindow() {
-    windows_.emplace_back(std::unique_ptr<MainWindow>(new MainWindow()));
-    windows_.back()->showMaximized();
+    MainWindow *window = addWindow();
     QApplication::processEvents();
-    return windows_.back().get();
+    return window;
+  }
+
+  /// Create and show a window, without processing events so that no other
+  /// puzzle can be given to it in the meantime.
+  MainWindow *addWindow() {
+    windows_.emplace_back(std::unique_ptr<MainWindow>(new MainWindow()));
+    MainWindow *window = windows_.back().get();
+    connect(window, &MainWindow::openRequested, this, &MainApp::openFiles);
+    window->showMaximized();
+    return window;
+  }
+
+  /// Parse \p fileNames in parallel, and show each puzzle as soon as it is
+  /// ready, in a window which has no puzzle yet or in a new one.
+  void openFiles(const QStringList &fileNames) {
+    loader_.load(fileNames, [this](const QString &fileName,
+                                   std::unique_ptr<Puzzle> puzzle) {
+      auto empty = std::find_if(
+          windows_.begin(), windows_.end(),
+          [](const std::unique_ptr<MainWindow> &window) {
+            return !window->isLoaded();
+          });
+      MainWindow *window = nullptr;
+      if (empty != windows_.end()) {
+        window = empty->get();
+      } else if (puzzle || windows_.empty()) {
+        window = addWindow();
+      } else {
+        window = windows_.front().get();
+      }
+      window->setPuzzle(fileName, std::move(puzzle));
+      window->raise();
+      window->activateWindow();
+    });
   }
 };
 
@@ -84,6 +140,27 @@ private:
 int main(int argc, char *argv[]) {
   QCoreApplication::setOrganizationName("Cygnus Crosswords");
 
-  cygnus::MainApp a(argc, argv);
-  return a.exec();
+  cygnus::Metrics::init(argc, argv);
+  cygnus::Tracer::init(argc, argv);
+  const bool singleInstance = cygnus::SingleInstance::enabled(argc, argv);
+#ifndef Q_OS_MACOS
+  if (singleInstance) {
+    // Handing the files to a running instance only takes a core
+    // application, which starts far faster than the QApplication.
+    QCoreApplication app(argc, argv);
+    if (cygnus::SingleInstance::forward(app.arguments().mid(1))) {
+      cygnus::Tracer::finish();
+      return 0;
+    }
+  }
+#endif
+  cygnus::MainApp a(argc, argv, singleInstance);
+  if (a.forwarded()) {
+    cygnus::Tracer::finish();
+    return 0;
+  }
+  int result = a.exec();
+  cygnus::Tracer::finish();
+  cygnus::Metrics::finish();
+  return result;
 }